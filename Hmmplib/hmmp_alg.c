@@ -21,134 +21,254 @@
 #include "hmmp_datatypes.h"
 #include "hmmp_memop.h"
 #include "hmmp_dataproc.h"
+#include <stdlib.h>
 #include <math.h>
 #include <omp.h>
-int hmmp_forward_alg (	hmmp_Model model, hmmp_Sequence seq, dbl_matrix *o_alfa,
-						dbl_array *o_alfa_scale )
+
+// Number of states whose emission nominators are summed at once over the index.
+#define HMMP_REEST_BLOCK 64
+
+/* Emission probabilities are read as emission[state*state_stride + symbol*symbol_stride],
+*  so the same code runs on the model's row-major matrix ( M, 1 ) and on its transposed
+*  copy ( 1, N ) where the probabilities of one symbol are contiguous.
+*  The forward variables of the time steps [t_begin, t_end) are stored in o_alfa, row 0
+*  holding t_begin. 'alfa_prev' holds the variables of t_begin-1, unused if t_begin is 0.
+*  The scaling factors are indexed by the time step, o_alfa_scale can be NULL. */
+static int hmmp_forward_core ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission,
+							   int state_stride, int symbol_stride, int t_begin, int t_end,
+							   dbl_matrix *alfa_prev, dbl_matrix *o_alfa,
+							   dbl_array *o_alfa_scale )
 {
-	int i, j, t;
-	double part_sum;
-	dbl_matrix *transit_indx_ptr, *alfa_indx_ptr;
+	size_t i, j, N = model.num_states;
+	int t;
+	double part_sum, scale;
+	dbl_matrix *transit_indx_ptr, *alfa_indx_ptr, *emit_indx_ptr;
+	hmmp_Rle_Cursor cursor;
 
-	if(!o_alfa_scale || !o_alfa )
+	if( !o_alfa || !emission || ( t_begin > 0 && !alfa_prev ) )
 		return E_PARAMETER;
-	//initialization
-	for ( i = 0 ; i < model.num_states ; ++i ){
-		o_alfa[i] = model.initial[i] * model.emission[i*model.num_symbols+seq.sequence[0]]; //variant 2
-	}
-	o_alfa_scale[0] = hmmp_normalize_arr(o_alfa,model.num_states);
-
-	alfa_indx_ptr = o_alfa;
-	//induction
-	for ( t = 1 ; t < seq.length ; ++t ){
-		transit_indx_ptr = model.transition;
-		for ( i = 0 ; i < model.num_states ; ++i ){
-			part_sum = 0.0;
-			for ( j = 0; j < model.num_states ; ++j ){
-				part_sum += alfa_indx_ptr[j] * transit_indx_ptr[j*model.num_states];
+	if ( t_begin < t_end && hmmp_rle_seek ( &cursor, seq, t_begin ) )
+		return E_ARGUMENT;
+	alfa_indx_ptr = alfa_prev;
+	for ( t = t_begin ; t < t_end ; ++t ){
+		emit_indx_ptr = emission + (size_t)HMMP_NEXT_SYMBOL ( seq, t, cursor )*symbol_stride;
+		if ( t == 0 ){
+			//initialization
+			for ( i = 0 ; i < N ; ++i ){
+				o_alfa[i] = model.initial[i] * emit_indx_ptr[i*state_stride]; //variant 2
 			}
-			alfa_indx_ptr[model.num_states+i]=part_sum * model.emission[i*model.num_symbols+seq.sequence[t]];
-			++transit_indx_ptr;
 		}
-		alfa_indx_ptr += model.num_states;	// indexing value to the next time step
-		o_alfa_scale[t] = hmmp_normalize_arr(alfa_indx_ptr,model.num_states);
+		else {
+			//induction
+			transit_indx_ptr = model.transition;
+			for ( i = 0 ; i < N ; ++i ){
+				part_sum = 0.0;
+				for ( j = 0; j < N ; ++j ){
+					part_sum += alfa_indx_ptr[j] * transit_indx_ptr[j*model.num_states];
+				}
+				o_alfa[(size_t)(t-t_begin)*model.num_states+i]=part_sum * emit_indx_ptr[i*state_stride];
+				++transit_indx_ptr;
+			}
+		}
+		alfa_indx_ptr = o_alfa + (size_t)(t-t_begin)*model.num_states;	// indexing value to the next time step
+		scale = hmmp_normalize_arr(alfa_indx_ptr,model.num_states);
+		if ( o_alfa_scale )
+			o_alfa_scale[t] = scale;
 	}
 	return 0;
 }
 
-int hmmp_backward_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *o_beta,
-					    dbl_array *o_beta_scale )
+int hmmp_forward_alg (	hmmp_Model model, hmmp_Sequence seq, dbl_matrix *o_alfa,
+						dbl_array *o_alfa_scale )
 {
-	int i, j, t; //  i = 0,1,...,model.num_states-1,model.num_states(num_states) ; t = 0,1,...,seq.length-1( seq.length - sequence seq.sequence length )
-	double part_sum;
-	dbl_array *beta_helper, *indx_helper;
+	if ( !o_alfa_scale )
+		return E_PARAMETER;
+	return hmmp_forward_core ( model, seq, model.emission, model.num_symbols, 1,
+							   0, seq.length, 0, o_alfa, o_alfa_scale );
+}
+
+int hmmp_forward_emission_t_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission_t,
+								  dbl_matrix *o_alfa, dbl_array *o_alfa_scale )
+{
+	if ( !o_alfa_scale )
+		return E_PARAMETER;
+	return hmmp_forward_core ( model, seq, emission_t, 1, model.num_states,
+							   0, seq.length, 0, o_alfa, o_alfa_scale );
+}
+
+/* Emission probabilities are read as in hmmp_forward_core(). The backward variables of
+*  the time steps [t_begin, t_end) are stored in o_beta, row 0 holding t_begin.
+*  'beta_next' holds the variables of t_end, unused if t_end is the sequence length.
+*  The scaling factors are indexed by the time step, o_beta_scale can be NULL. */
+static int hmmp_backward_core ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission,
+								int state_stride, int symbol_stride, int t_begin, int t_end,
+								dbl_matrix *beta_next, dbl_matrix *o_beta,
+								dbl_array *o_beta_scale )
+{
+	size_t i, j, N = model.num_states; //  i = 0,1,...,model.num_states-1,model.num_states(num_states)
+	int t; // t = 0,1,...,seq.length-1( seq.length - sequence seq.sequence length )
+	double part_sum, scale;
+	dbl_array *beta_helper, *indx_helper, *emit_indx_ptr, *beta_t;
 
-	if( !o_beta || !o_beta_scale )
+	if( !o_beta || !emission || ( t_end < seq.length && !beta_next ) )
 		return E_PARAMETER;
+	// the symbols are read backwards, coded runs can only be read forwards
+	if ( HMMP_SEQUENCE_TYPE ( seq ) == HMMP_SYMBOLS_RLE )
+		return E_ARGUMENT;
 	beta_helper = hmmp_create_dbl_array(model.num_states);
 	if ( !beta_helper )
 		return E_ALLOCATION;
 
-	//initialization
-	//scaling factors at last time step
-	o_beta_scale[seq.length-1]=1;
-
 	//using address arithmetic to do less operations
-	indx_helper = o_beta +  ( seq.length - 1 ) * model.num_states ;
-	for ( i = 0 ; i < model.num_states ; ++i ){
-		indx_helper[i] = 1;
-	}
-	//induction
-	for ( t = seq.length - 2 ; t >= 0 ; --t ){
-		for ( i = 0 ; i < model.num_states ; ++i )
-			//indx_helper[i] represents beta values at the next time step.
-			beta_helper[i] = indx_helper[i] * 
-							 model.emission[i*model.num_symbols+seq.sequence[t+1]];
-		for ( i = 0 ; i < model.num_states ; ++i ){
-			part_sum = 0.0;
-			for ( j = 0; j < model.num_states ; ++j ){
-				part_sum += model.transition[i*model.num_states + j] * beta_helper[j]; 
-				// transision prob from each previus to current state indexed j->i
+	indx_helper = beta_next;
+	for ( t = t_end - 1 ; t >= t_begin ; --t ){
+		beta_t = o_beta + (size_t)(t-t_begin)*model.num_states;
+		if ( t == seq.length - 1 ){
+			//initialization
+			//scaling factors at last time step
+			for ( i = 0 ; i < N ; ++i ){
+				beta_t[i] = 1;
+			}
+			scale = 1;
+		}
+		else {
+			//induction
+			emit_indx_ptr = emission + (size_t)HMMP_SYMBOL ( seq, t+1 )*symbol_stride;
+			for ( i = 0 ; i < N ; ++i )
+				//indx_helper[i] represents beta values at the next time step.
+				beta_helper[i] = indx_helper[i] * emit_indx_ptr[i*state_stride];
+			for ( i = 0 ; i < N ; ++i ){
+				part_sum = 0.0;
+				for ( j = 0; j < N ; ++j ){
+					part_sum += model.transition[i*model.num_states + j] * beta_helper[j]; 
+					// transision prob from each previus to current state indexed j->i
+				}
+				beta_t[i] = part_sum;
 			}
-			o_beta[t*model.num_states + i] = part_sum;
+			scale = hmmp_normalize_arr(beta_t,model.num_states);
 		}
-		o_beta_scale[t]=hmmp_normalize_arr(o_beta+t*model.num_states,model.num_states);
-		indx_helper-=model.num_states;
+		if ( o_beta_scale )
+			o_beta_scale[t] = scale;
+		indx_helper = beta_t;
 	}
 	hmmp_delete_dbl_array(beta_helper);
 	return E_SUCCESS;
 }
+
+int hmmp_backward_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *o_beta,
+					    dbl_array *o_beta_scale )
+{
+	if ( !o_beta_scale )
+		return E_PARAMETER;
+	return hmmp_backward_core ( model, seq, model.emission, model.num_symbols, 1,
+								0, seq.length, 0, o_beta, o_beta_scale );
+}
+
+int hmmp_backward_emission_t_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission_t,
+								   dbl_matrix *o_beta, dbl_array *o_beta_scale )
+{
+	if ( !o_beta_scale )
+		return E_PARAMETER;
+	return hmmp_backward_core ( model, seq, emission_t, 1, model.num_states,
+								0, seq.length, 0, o_beta, o_beta_scale );
+}
+
+int hmmp_forward_window_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission_t,
+							  int t_begin, int t_end, dbl_matrix *alfa_prev,
+							  dbl_matrix *o_alfa, dbl_array *o_alfa_scale )
+{
+	if ( t_begin < 0 || t_end > seq.length || t_begin > t_end )
+		return E_ARGUMENT;
+	return hmmp_forward_core ( model, seq, emission_t, 1, model.num_states,
+							   t_begin, t_end, alfa_prev, o_alfa, o_alfa_scale );
+}
+
+int hmmp_backward_window_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission_t,
+							   int t_begin, int t_end, dbl_matrix *beta_next,
+							   dbl_matrix *o_beta, dbl_array *o_beta_scale )
+{
+	if ( t_begin < 0 || t_end > seq.length || t_begin > t_end )
+		return E_ARGUMENT;
+	return hmmp_backward_core ( model, seq, emission_t, 1, model.num_states,
+								t_begin, t_end, beta_next, o_beta, o_beta_scale );
+}
 //int hmm_viterbi_alg(hmmp_Model model, int_array *obs, int obs_len, int *backtrack, 
 //					double *mu, int* bestpath, double *prob_bp )
 int hmmp_backward_rescale( dbl_matrix *beta, int num_states, int seq_len,
 						   dbl_array *scale_alfa, dbl_array *scale_beta )
 {
 	double rescale = 1.0;
-	int t, i;
+	size_t i, N = num_states;
+	int t;
 	if(!beta || !scale_alfa || !scale_beta )
 		return E_PARAMETER;
 	for ( t = seq_len-1 ; t >= 0 ; --t){
 		rescale *= scale_alfa[t]/scale_beta[t];
-		for ( i = 0 ; i < num_states ; ++i ){
-			beta[t*num_states+i] *= rescale;
+		for ( i = 0 ; i < N ; ++i ){
+			beta[(size_t)t*num_states+i] *= rescale;
 		}
 	}
 	return E_SUCCESS;
 }
 
+/* One induction step of the Viterbi algorithm from 'mu_old' to 'o_mu'. The backtracking
+*  pointers are stored in 'o_backtrack' unless it is NULL. 'io_backtrack_i' carries the
+*  last chosen state between steps. */
+static void hmmp_viterbi_step ( hmmp_Model log_model, int symbol, dbl_matrix *mu_old,
+								dbl_matrix *o_mu, int_array *o_backtrack, int *io_backtrack_i )
+{
+	size_t i, j, N = log_model.num_states;
+	int backtrack_i = *io_backtrack_i;
+	double mu_max, swap_val;
+	for ( i = 0 ; i < N ; ++i ){
+		mu_max = -HMMP_DBL_MAX;
+		swap_val = 0;
+		for ( j = 0; j < N ; ++j ){
+			swap_val = mu_old[j] + log_model.transition[j*log_model.num_states+i];;
+			if ( mu_max < swap_val ){
+				mu_max = swap_val;
+				backtrack_i = j;
+			}
+		}
+		o_mu[i] = mu_max + log_model.emission[i*log_model.num_symbols+symbol];
+		if ( o_backtrack )
+			o_backtrack[i] = backtrack_i;
+	}
+	*io_backtrack_i = backtrack_i;
+}
+
 int hmmp_viterbi_alg( hmmp_Model log_model,	hmmp_Sequence seq, int_array *backtrack, 
 					 dbl_matrix *mu,	hmmp_Sequence *o_state_seq, double *o_logP )
 {
-	int i, j, t;
-	int backtrack_i = 0;
-	double mu_max, swap_val;
+	size_t i, N = log_model.num_states;
+	int t;
+	int backtrack_i = 0, symbol;
+	double mu_max;
 	dbl_matrix *mu_old, *swap_ptr;
+	hmmp_Rle_Cursor cursor;
 
 	if ( !backtrack || !mu || !o_state_seq || !o_logP )
 		return E_PARAMETER;
+	// the empty state sequence emits the empty sequence with probability 1
+	if ( seq.length < 1 ){
+		*o_logP = 0.0;
+		return E_SUCCESS;
+	}
+	// the states are written as int
+	if ( !o_state_seq->sequence )
+		return E_ARGUMENT;
 	// Initialization
-	for ( i = 0 ; i < log_model.num_states ; ++i )
-		mu[i] = log_model.initial[i] + log_model.emission[i*log_model.num_symbols+seq.sequence[0]];
+	hmmp_rle_seek ( &cursor, seq, 0 );
+	symbol = HMMP_NEXT_SYMBOL ( seq, 0, cursor );
+	for ( i = 0 ; i < N ; ++i )
+		mu[i] = log_model.initial[i] + log_model.emission[i*log_model.num_symbols+symbol];
 
 	mu_old = mu;
 	mu += log_model.num_states;
 	//Induction
 	for ( t = 1 ; t < seq.length ; ++t ){
-
-
-		for ( i = 0 ; i < log_model.num_states ; ++i ){
-			mu_max = -HMMP_DBL_MAX;
-			swap_val = 0;
-			for ( j = 0; j < log_model.num_states ; ++j ){
-				swap_val = mu_old[j] + log_model.transition[j*log_model.num_states+i];;
-				if ( mu_max < swap_val ){
-					mu_max = swap_val;
-					backtrack_i = j;
-				}
-			}
-			mu[i] = mu_max + log_model.emission[i*log_model.num_symbols+seq.sequence[t]];
-			backtrack[t*log_model.num_states + i] = backtrack_i;
-		}
+		hmmp_viterbi_step ( log_model, HMMP_NEXT_SYMBOL ( seq, t, cursor ), mu_old, mu,
+							backtrack + (size_t)t*log_model.num_states, &backtrack_i );
 		swap_ptr = mu;
 		mu = mu_old;
 		mu_old = swap_ptr;
@@ -156,7 +276,7 @@ int hmmp_viterbi_alg( hmmp_Model log_model,	hmmp_Sequence seq, int_array *backtr
 	}
 	//Termination
 	mu_max = -HMMP_DBL_MAX;
-	for ( i = 0 ; i < log_model.num_states ; ++i ){
+	for ( i = 0 ; i < N ; ++i ){
 		if ( mu_max < mu_old[i] ){
 			mu_max = mu_old[i];
 			backtrack_i = i;
@@ -165,7 +285,7 @@ int hmmp_viterbi_alg( hmmp_Model log_model,	hmmp_Sequence seq, int_array *backtr
 	//Backtracking best path
 	o_state_seq->sequence[seq.length-1] = backtrack_i;
 	for ( t = seq.length-1 ; t > 0 ; --t ){
-		backtrack_i = backtrack[t*log_model.num_states + backtrack_i];
+		backtrack_i = backtrack[(size_t)t*log_model.num_states + backtrack_i];
 		o_state_seq->sequence[t-1] = backtrack_i;	
 	}
 	o_state_seq->sequence[0] = backtrack_i;
@@ -174,18 +294,162 @@ int hmmp_viterbi_alg( hmmp_Model log_model,	hmmp_Sequence seq, int_array *backtr
 	return E_SUCCESS;
 }
 
+int hmmp_viterbi_checkpoint_alg ( hmmp_Model log_model, hmmp_Sequence seq, int interval,
+								  dbl_matrix *checkpoints, int_array *backtrack,
+								  dbl_matrix *mu, hmmp_Sequence *o_state_seq, double *o_logP )
+{
+	size_t i, N;
+	int s, t, t_begin, t_end, num_segments;
+	int backtrack_i = 0, state, symbol;
+	double mu_max;
+	dbl_matrix *mu_old, *mu_new, *swap_ptr, *ckpt;
+	hmmp_Rle_Cursor cursor, *ckpt_cursors = 0;
+
+	if ( !checkpoints || !backtrack || !mu || !o_state_seq || !o_logP )
+		return E_PARAMETER;
+	if ( interval < 1 )
+		return E_ARGUMENT;
+	if ( seq.length < 1 ){
+		*o_logP = 0.0;
+		return E_SUCCESS;
+	}
+	if ( !o_state_seq->sequence )
+		return E_ARGUMENT;
+	N = log_model.num_states;
+	num_segments = ( seq.length - 1 ) / interval + 1;
+	// the second pass restarts the runs at each segment from a copy of the cursor
+	if ( HMMP_SEQUENCE_TYPE ( seq ) == HMMP_SYMBOLS_RLE &&
+		 !(ckpt_cursors = (hmmp_Rle_Cursor*) malloc ( num_segments * sizeof ( hmmp_Rle_Cursor ) )) )
+		return E_ALLOCATION;
+	// First pass: mu of every time step, keeping only mu of the step before each segment.
+	// The checkpoint of segment s holds N values of mu and the carried backtrack state.
+	hmmp_rle_seek ( &cursor, seq, 0 );
+	symbol = HMMP_NEXT_SYMBOL ( seq, 0, cursor );
+	for ( i = 0 ; i < N ; ++i )
+		mu[i] = log_model.initial[i] + log_model.emission[i*log_model.num_symbols+symbol];
+	mu_old = mu;
+	mu_new = mu + N;
+	for ( t = 1 ; t < seq.length ; ++t ){
+		if ( t % interval == 0 ){
+			ckpt = checkpoints + (size_t)( t / interval ) * ( N + 1 );
+			for ( i = 0 ; i < N ; ++i )
+				ckpt[i] = mu_old[i];
+			ckpt[N] = backtrack_i;
+			if ( ckpt_cursors )
+				ckpt_cursors[t / interval] = cursor;
+		}
+		hmmp_viterbi_step ( log_model, HMMP_NEXT_SYMBOL ( seq, t, cursor ), mu_old, mu_new, 0,
+							&backtrack_i );
+		swap_ptr = mu_new;
+		mu_new = mu_old;
+		mu_old = swap_ptr;
+	}
+	//Termination
+	mu_max = -HMMP_DBL_MAX;
+	for ( i = 0 ; i < N ; ++i ){
+		if ( mu_max < mu_old[i] ){
+			mu_max = mu_old[i];
+			backtrack_i = i;
+		}
+	}
+	// Second pass: from the last segment to the first, recompute the backtracking pointers
+	// of the segment from its checkpoint and follow the best path through it
+	state = backtrack_i;
+	o_state_seq->sequence[seq.length-1] = state;
+	for ( s = num_segments - 1 ; s >= 0 ; --s ){
+		t_begin = s * interval;
+		t_end = t_begin + interval < seq.length ? t_begin + interval : seq.length;
+		if ( s == 0 ){
+			hmmp_rle_seek ( &cursor, seq, 0 );
+			symbol = HMMP_NEXT_SYMBOL ( seq, 0, cursor );
+			for ( i = 0 ; i < N ; ++i )
+				mu[i] = log_model.initial[i] + log_model.emission[i*log_model.num_symbols+symbol];
+			backtrack_i = 0;
+		}
+		else {
+			ckpt = checkpoints + (size_t)s * ( N + 1 );
+			for ( i = 0 ; i < N ; ++i )
+				mu[i] = ckpt[i];
+			backtrack_i = (int) ckpt[N];
+			if ( ckpt_cursors )
+				cursor = ckpt_cursors[s];
+		}
+		mu_old = mu;
+		mu_new = mu + N;
+		for ( t = t_begin > 0 ? t_begin : 1 ; t < t_end ; ++t ){
+			hmmp_viterbi_step ( log_model, HMMP_NEXT_SYMBOL ( seq, t, cursor ), mu_old, mu_new,
+								backtrack + (size_t)( t - t_begin ) * N, &backtrack_i );
+			swap_ptr = mu_new;
+			mu_new = mu_old;
+			mu_old = swap_ptr;
+		}
+		for ( t = t_end - 1 ; t > 0 && t >= t_begin ; --t ){
+			state = backtrack[(size_t)( t - t_begin ) * N + state];
+			o_state_seq->sequence[t-1] = state;
+		}
+	}
+	if ( ckpt_cursors ) free ( ckpt_cursors );
+	*o_logP = mu_max;
+	return E_SUCCESS;
+}
+
+int hmmp_forward_likelihood_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *alfa,
+								  double *o_logP )
+{
+	size_t i, j, N = model.num_states;
+	int t;
+	double part_sum, scale, logP = 0.0;
+	dbl_matrix *alfa_old, *alfa_new, *swap_ptr, *emit_indx_ptr;
+	hmmp_Rle_Cursor cursor;
+
+	if ( !alfa || !o_logP )
+		return E_PARAMETER;
+	alfa_old = alfa + model.num_states;
+	alfa_new = alfa;
+	hmmp_rle_seek ( &cursor, seq, 0 );
+	// same operations as hmmp_forward_alg() and hmmp_log_of_divisors(), keeping only the
+	// variables of the last time step
+	for ( t = 0 ; t < seq.length ; ++t ){
+		emit_indx_ptr = model.emission + HMMP_NEXT_SYMBOL ( seq, t, cursor );
+		if ( t == 0 ){
+			for ( i = 0 ; i < N ; ++i )
+				alfa_new[i] = model.initial[i] * emit_indx_ptr[i*model.num_symbols];
+		}
+		else {
+			for ( i = 0 ; i < N ; ++i ){
+				part_sum = 0.0;
+				for ( j = 0; j < N ; ++j )
+					part_sum += alfa_old[j] * model.transition[j*model.num_states+i];
+				alfa_new[i] = part_sum * emit_indx_ptr[i*model.num_symbols];
+			}
+		}
+		scale = hmmp_normalize_arr ( alfa_new, model.num_states );
+		if ( scale < HMMP_PRECISION && scale > -HMMP_PRECISION ){
+			*o_logP = HMMP_DBL_MAX;
+			return E_SUCCESS;
+		}
+		logP -= log ( scale );
+		swap_ptr = alfa_new;
+		alfa_new = alfa_old;
+		alfa_old = swap_ptr;
+	}
+	*o_logP = logP;
+	return E_SUCCESS;
+}
+
 int hmmp_bwa_gamma_alg ( dbl_matrix *o_gamma, dbl_matrix *alfa, dbl_matrix *beta, 
 						dbl_array *alfa_scale, int num_states, int seq_length )
 {
-	int i, t;
+	size_t i, N = num_states;
+	int t;
 	dbl_matrix *pa, *pb;
 	if ( !o_gamma || !alfa || !beta || !alfa_scale )
 		return E_PARAMETER;
 #pragma omp for private(t,i,pa,pb) schedule(static)
 	for ( t = 0 ; t < seq_length ; ++t ){
-		pa = alfa + t*num_states;
-		pb = beta + t*num_states;
-		for ( i = 0 ; i < num_states ; ++i)
+		pa = alfa + (size_t)t*num_states;
+		pb = beta + (size_t)t*num_states;
+		for ( i = 0 ; i < N ; ++i)
 			o_gamma[i*seq_length+t] = pa[i] * pb[i] / alfa_scale[t];
 	}
 	return E_SUCCESS;
@@ -193,12 +457,15 @@ int hmmp_bwa_gamma_alg ( dbl_matrix *o_gamma, dbl_matrix *alfa, dbl_matrix *beta
 int hmmp_bwa_xi_alg ( dbl_matrix *o_xi, dbl_matrix *alfa, dbl_matrix *beta, 
 					 hmmp_Model model, hmmp_Sequence seq )
 {
-	int i, j, t, NtT, N;
+	size_t i, j, NtT, N;
+	int t;
 	dbl_matrix *pa, *pb;
 	double emit;
 
 	if ( !o_xi || !alfa || !beta )
 		return E_PARAMETER;
+	if ( HMMP_SEQUENCE_TYPE ( seq ) == HMMP_SYMBOLS_RLE )
+		return E_ARGUMENT;
 	--seq.length;
 	N = model.num_states;
 	NtT = N*seq.length;
@@ -207,7 +474,7 @@ int hmmp_bwa_xi_alg ( dbl_matrix *o_xi, dbl_matrix *alfa, dbl_matrix *beta,
 		pa = alfa + t*N;
 		pb = beta + (t+1)*N;
 		for ( j = 0 ; j < N ; ++j ){
-			emit = model.emission[j*model.num_symbols+seq.sequence[t+1]];
+			emit = model.emission[j*model.num_symbols+HMMP_SYMBOL ( seq, t+1 )];
 			for ( i = 0 ; i < N ; ++i )
 				o_xi[i*NtT+j*seq.length+t]=pa[i]*model.transition[i*N+j]*emit*pb[j];
 		}
@@ -220,25 +487,38 @@ int hmmp_bwa_reest_alg ( hmmp_Model model,		hmmp_Sequence seq,
 						 dbl_matrix *o_a_num,	dbl_matrix *o_b_num,
 						 dbl_array *o_a_denom,	dbl_array *o_b_denom	)
 {
-	int i, j ,t;
+	return hmmp_bwa_reest_weighted_alg ( model, seq, xi, gamma, 1.0,
+										 o_a_num, o_b_num, o_a_denom, o_b_denom );
+}
+
+int hmmp_bwa_reest_weighted_alg ( hmmp_Model model,		hmmp_Sequence seq,
+								  dbl_matrix *xi,		dbl_matrix *gamma,
+								  double weight,
+								  dbl_matrix *o_a_num,	dbl_matrix *o_b_num,
+								  dbl_array *o_a_denom,	dbl_array *o_b_denom	)
+{
+	size_t i, j, N = model.num_states;
+	int t;
 	double part_sum;
 	dbl_matrix *xiindx, *gammaindx;
 	--seq.length;
 
 	if ( !xi || !gamma || !o_a_num || !o_b_num || !o_a_denom || !o_b_denom )
 		return E_PARAMETER;
+	if ( HMMP_SEQUENCE_TYPE ( seq ) == HMMP_SYMBOLS_RLE )
+		return E_ARGUMENT;
 #pragma omp for private(i,j,t,xiindx) schedule(static)
-	for ( i = 0 ; i < model.num_states; ++i ){
-		for ( j = 0 ; j < model.num_states ; ++j ){
+	for ( i = 0 ; i < N ; ++i ){
+		for ( j = 0 ; j < N ; ++j ){
 			// j loop for a ( transition ) numerators ksi(t)[i]->[j];
 			xiindx = xi + i*model.num_states*seq.length + j*seq.length;
 			for ( t = 0 ; t < seq.length ; ++t ){
-				o_a_num[i*model.num_states + j] += xiindx[t];
+				o_a_num[i*model.num_states + j] += weight * xiindx[t];
 			}
 		}
 	}
 #pragma omp for private(i,j,t,gammaindx, part_sum) schedule(static)
-	for ( i = 0 ; i < model.num_states; ++i ){
+	for ( i = 0 ; i < N ; ++i ){
 		gammaindx = gamma + i*(seq.length+1);
 		part_sum = 0.0;
 		for ( t = 0 ; t < seq.length ; ++t ){
@@ -246,13 +526,147 @@ int hmmp_bwa_reest_alg ( hmmp_Model model,		hmmp_Sequence seq,
 			part_sum += gammaindx[t];
 			// adding gamma(t)[i] to b_ik when k depends on O(t)
 			
-			o_b_num[i*model.num_symbols + seq.sequence[t]] += gammaindx[t];
+			o_b_num[i*model.num_symbols + HMMP_SYMBOL ( seq, t )] += weight * gammaindx[t];
 		}
 		// denominator for: a_ij over t=1:T-1 | b_ik summation over t=1:T
-		o_a_denom[i] += part_sum;
-		o_b_denom[i] += part_sum + gammaindx[t];
-		o_b_num[i*model.num_symbols + seq.sequence[t]] += gammaindx[t];
+		o_a_denom[i] += weight * part_sum;
+		o_b_denom[i] += weight * ( part_sum + gammaindx[t] );
+		o_b_num[i*model.num_symbols + HMMP_SYMBOL ( seq, t )] += weight * gammaindx[t];
+
+	}
+	return E_SUCCESS;
+}
+
+/* Common part of the fused re-estimation kernels. Emission probabilities are read as in
+*  hmmp_forward_core(). With a symbol index the emission nominators are summed per symbol
+*  over its time steps, otherwise they are added at each time step. Only the time steps
+*  [t_begin, t_end) are processed, row 0 of 'alfa' and 'beta' holding t_begin. 'beta' also
+*  holds the row of t_end if it is not the sequence length. The index needs the whole
+*  sequence. */
+static int hmmp_bwa_fused_reest_core ( hmmp_Model model,	hmmp_Sequence seq,
+									   hmmp_Symbol_Index *index, dbl_matrix *emission,
+									   int state_stride,	int symbol_stride,
+									   int t_begin,			int t_end,
+									   dbl_matrix *alfa,		dbl_matrix *beta,
+									   dbl_array *alfa_scale,	double weight,
+									   dbl_matrix *o_a_num,		dbl_matrix *o_b_num,
+									   dbl_array *o_a_denom,	dbl_array *o_b_denom,
+									   dbl_array *o_pi )
+{
+	size_t i, j, k, N, M, first, last, block, block_end;
+	int t, num_threads, thread_id;
+	int_array *pos, *pos_end;
+	double gamma, scale, part_sum[HMMP_REEST_BLOCK];
+	dbl_matrix *pa, *pb, *pb_next, *transit_indx, *emit_indx;
 
+	if ( !alfa || !beta || !alfa_scale || !o_a_num || !o_b_num ||
+		 !o_a_denom || !o_b_denom || !o_pi || !emission )
+		return E_PARAMETER;
+	if ( HMMP_SEQUENCE_TYPE ( seq ) == HMMP_SYMBOLS_RLE )
+		return E_ARGUMENT;
+	N = model.num_states;
+	M = model.num_symbols;
+	// each thread owns a block of states ( rows of the outputs ), so it can walk the
+	// time steps in order and add to its rows without synchronization
+	num_threads = omp_get_num_threads();
+	thread_id = omp_get_thread_num();
+	first = N * thread_id / num_threads;
+	last = N * ( thread_id + 1 ) / num_threads;
+	for ( t = t_begin ; t < t_end ; ++t ){
+		pa = alfa + (t-t_begin)*N;
+		pb = beta + (t-t_begin)*N;
+		for ( i = first ; i < last ; ++i ){
+			// gamma(t)[i] as in hmmp_bwa_gamma_alg()
+			gamma = weight * ( pa[i] * pb[i] / alfa_scale[t] );
+			if ( !index )
+				o_b_num[i*M + HMMP_SYMBOL ( seq, t )] += gamma;
+			o_b_denom[i] += gamma;
+			if ( t < seq.length - 1 )
+				o_a_denom[i] += gamma;
+		}
+		if ( t == 0 )
+			for ( i = first ; i < last ; ++i )
+				o_pi[i] += weight * ( pa[i] * pb[i] / alfa_scale[0] );
+		if ( t == seq.length - 1 )
+			break;
+		// xi(t)[i][j] as in hmmp_bwa_xi_alg()
+		pb_next = beta + (t+1-t_begin)*N;
+		emit_indx = emission + (size_t)HMMP_SYMBOL ( seq, t+1 )*symbol_stride;
+		for ( i = first ; i < last ; ++i ){
+			transit_indx = model.transition + i*N;
+			for ( j = 0 ; j < N ; ++j )
+				o_a_num[i*N + j] += weight * ( pa[i] * transit_indx[j] *
+											   emit_indx[j*state_stride] * pb_next[j] );
+		}
+	}
+	if ( index ){
+		// segmented reduction: the time steps of each symbol are contiguous in the index.
+		// The time steps are the outer loop, so alfa and beta are read once per block of
+		// states, each time step a contiguous row of the block.
+		for ( block = first ; block < last ; block += HMMP_REEST_BLOCK ){
+			block_end = block + HMMP_REEST_BLOCK < last ? block + HMMP_REEST_BLOCK : last;
+			for ( k = 0 ; k < M ; ++k ){
+				pos = index->positions + index->offsets[k];
+				pos_end = index->positions + index->offsets[k+1];
+				if ( pos == pos_end )
+					continue;
+				for ( i = block ; i < block_end ; ++i )
+					part_sum[i-block] = 0.0;
+				for ( ; pos < pos_end ; ++pos ){
+					pa = alfa + (size_t)*pos*N;
+					pb = beta + (size_t)*pos*N;
+					scale = 1.0 / alfa_scale[*pos];
+					for ( i = block ; i < block_end ; ++i )
+						part_sum[i-block] += pa[i] * pb[i] * scale;
+				}
+				for ( i = block ; i < block_end ; ++i )
+					o_b_num[i*M + k] += weight * part_sum[i-block];
+			}
+		}
 	}
+#pragma omp barrier
 	return E_SUCCESS;
-}
\ No newline at end of file
+}
+
+int hmmp_bwa_fused_reest_alg ( hmmp_Model model,		hmmp_Sequence seq,
+							   dbl_matrix *alfa,		dbl_matrix *beta,
+							   dbl_array *alfa_scale,	double weight,
+							   dbl_matrix *o_a_num,		dbl_matrix *o_b_num,
+							   dbl_array *o_a_denom,	dbl_array *o_b_denom,
+							   dbl_array *o_pi )
+{
+	return hmmp_bwa_fused_reest_core ( model, seq, 0, model.emission, model.num_symbols, 1,
+									   0, seq.length, alfa, beta, alfa_scale, weight,
+									   o_a_num, o_b_num, o_a_denom, o_b_denom, o_pi );
+}
+
+int hmmp_bwa_fused_reest_index_alg ( hmmp_Model model,		hmmp_Sequence seq,
+									 hmmp_Symbol_Index *index,	dbl_matrix *emission_t,
+									 dbl_matrix *alfa,		dbl_matrix *beta,
+									 dbl_array *alfa_scale,	double weight,
+									 dbl_matrix *o_a_num,	dbl_matrix *o_b_num,
+									 dbl_array *o_a_denom,	dbl_array *o_b_denom,
+									 dbl_array *o_pi )
+{
+	if ( !index || index->length != seq.length || index->num_symbols != model.num_symbols )
+		return E_PARAMETER;
+	return hmmp_bwa_fused_reest_core ( model, seq, index, emission_t, 1, model.num_states,
+									   0, seq.length, alfa, beta, alfa_scale, weight,
+									   o_a_num, o_b_num, o_a_denom, o_b_denom, o_pi );
+}
+
+int hmmp_bwa_fused_reest_window_alg ( hmmp_Model model,		hmmp_Sequence seq,
+									  dbl_matrix *emission_t,
+									  int t_begin,				int t_end,
+									  dbl_matrix *alfa,		dbl_matrix *beta,
+									  dbl_array *alfa_scale,	double weight,
+									  dbl_matrix *o_a_num,		dbl_matrix *o_b_num,
+									  dbl_array *o_a_denom,	dbl_array *o_b_denom,
+									  dbl_array *o_pi )
+{
+	if ( t_begin < 0 || t_end > seq.length || t_begin > t_end )
+		return E_ARGUMENT;
+	return hmmp_bwa_fused_reest_core ( model, seq, 0, emission_t, 1, model.num_states,
+									   t_begin, t_end, alfa, beta, alfa_scale, weight,
+									   o_a_num, o_b_num, o_a_denom, o_b_denom, o_pi );
+}
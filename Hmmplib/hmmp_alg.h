@@ -55,6 +55,28 @@
 */
 int hmmp_forward_alg (	hmmp_Model model, hmmp_Sequence seq, dbl_matrix *o_alfa,
 						dbl_array *o_alfa_scale );
+
+///Execute the forward algorithm with a transposed emission matrix.
+/**
+*	**This function does not include memory allocation!!!**
+*
+*	Same as hmmp_forward_alg(), but the emission probabilities are read from an
+*	M x N ( number of symbols x number of states ) copy of the emission matrix,
+*	emission_t[k*N + j] = model.emission[j*M + k]. The probabilities of the observed symbol
+*	at each time step are then contiguous in memory, which avoids the stride M access
+*	for large alphabets. The copy can be created once per model with
+*	hmmp_transpose_matrix_copy() and reused for all sequences.
+*
+*	@param[in] model	The model to execute algorithm on
+*	@param[in] seq		The sequence to execute algorithm on
+*	@param[in] emission_t The transposed emission matrix of the model
+*	@param[out] o_alfa	Address of pre-allocated matrix to store the resulting variables
+*	@param[out] o_alfa_scale Adress of pre-allocated array to store the scaling factors 
+*							 used at each step of the computation
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_forward_emission_t_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission_t,
+								  dbl_matrix *o_alfa, dbl_array *o_alfa_scale );
 ///Execute the backward algorithm on a model and a sequence.
 /**
 *	**This function does not include memory allocation!!!**
@@ -77,6 +99,91 @@ int hmmp_forward_alg (	hmmp_Model model, hmmp_Sequence seq, dbl_matrix *o_alfa,
 int hmmp_backward_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *o_beta,
 					    dbl_array *o_beta_scale );
 
+///Execute the backward algorithm with a transposed emission matrix.
+/**
+*	**This function does not include memory allocation!!!**
+*
+*	Same as hmmp_backward_alg(), but the emission probabilities are read from the
+*	transposed emission matrix as in hmmp_forward_emission_t_alg().
+*
+*	@param[in] model	The model to execute algorithm on
+*	@param[in] seq		The sequence to execute algorithm on
+*	@param[in] emission_t The transposed emission matrix of the model
+*	@param[out] o_beta	Address of pre-allocated matrix to store the resulting variables
+*	@param[out] o_beta_scale Adress of pre-allocated array to store the scaling factors 
+*							 used at each step of the computation
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_backward_emission_t_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission_t,
+								   dbl_matrix *o_beta, dbl_array *o_beta_scale );
+
+///Execute the forward algorithm on a window of time steps.
+/**
+*	**This function does not include memory allocation!!!**
+*
+*	Same as hmmp_forward_emission_t_alg(), but only the forward variables of the time steps
+*	t_begin ... t_end-1 are computed. They are stored in a ( t_end - t_begin ) x N matrix,
+*	row 0 holding time step t_begin. The computation continues from the variables of
+*	time step t_begin-1, so a long sequence can be processed in segments kept in a small
+*	buffer. The results are identical to the whole pass.
+*
+*	@param[in] model		The model to execute algorithm on
+*	@param[in] seq			The sequence to execute algorithm on
+*	@param[in] emission_t	The transposed emission matrix of the model
+*	@param[in] t_begin		First time step of the window
+*	@param[in] t_end		Time step following the window
+*	@param[in] alfa_prev	The N forward variables of time step t_begin-1, 
+*							not used if t_begin is 0
+*	@param[out] o_alfa		Address of pre-allocated matrix to store the resulting variables
+*	@param[out] o_alfa_scale Address of the array of scaling factors, indexed by the time 
+*							 step ( o_alfa_scale[t_begin] ... ). Zero 0 ( NULL ) to skip them.
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_forward_window_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission_t,
+							  int t_begin, int t_end, dbl_matrix *alfa_prev,
+							  dbl_matrix *o_alfa, dbl_array *o_alfa_scale );
+
+///Execute the backward algorithm on a window of time steps.
+/**
+*	**This function does not include memory allocation!!!**
+*
+*	Same as hmmp_backward_emission_t_alg(), but only the backward variables of the time
+*	steps t_begin ... t_end-1 are computed, continuing from the variables of time step
+*	t_end. The layout is the same as in hmmp_forward_window_alg().
+*
+*	@param[in] model		The model to execute algorithm on
+*	@param[in] seq			The sequence to execute algorithm on
+*	@param[in] emission_t	The transposed emission matrix of the model
+*	@param[in] t_begin		First time step of the window
+*	@param[in] t_end		Time step following the window
+*	@param[in] beta_next	The N backward variables of time step t_end, 
+*							not used if t_end is the sequence length
+*	@param[out] o_beta		Address of pre-allocated matrix to store the resulting variables
+*	@param[out] o_beta_scale Address of the array of scaling factors, indexed by the time 
+*							 step. Zero 0 ( NULL ) to skip them.
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_backward_window_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *emission_t,
+							   int t_begin, int t_end, dbl_matrix *beta_next,
+							   dbl_matrix *o_beta, dbl_array *o_beta_scale );
+
+///Execute the forward algorithm keeping only the probability of the sequence.
+/**
+*	**This function does not include memory allocation!!!**
+*
+*	Same result as hmmp_forward_alg() followed by hmmp_log_of_divisors() on the scaling
+*	factors, but only the forward variables of the last time step are kept. The working
+*	memory is 2 x N regardless of the sequence length.
+*
+*	@param[in] model	The model to execute algorithm on
+*	@param[in] seq		The sequence to execute algorithm on
+*	@param[in] alfa		Address of a pre-allocated 2 x N matrix used for the computation
+*	@param[out] o_logP	The logarithmic probability of the model given the sequence
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_forward_likelihood_alg ( hmmp_Model model, hmmp_Sequence seq, dbl_matrix *alfa,
+								  double *o_logP );
+
 ///Execute the backward rescaling algorithm.
 /**
 *	This algorithm is meant to be used after the results from the backward and the forward
@@ -121,6 +228,32 @@ int hmmp_backward_rescale( dbl_matrix *beta, int num_states, int seq_len,
 int hmmp_viterbi_alg( hmmp_Model model,	hmmp_Sequence seq, int_array *backtrack, 
 					 dbl_matrix *mu,	hmmp_Sequence *o_state_seq, double *o_logP );
 
+///Vitebri's algorithm with checkpoints instead of the whole backtracking matrix.
+/**
+*	**This function does not include memory allocation!!!**
+*
+*	Same result as hmmp_viterbi_alg(). The sequence is split in segments of 'interval'
+*	time steps. The first pass keeps only the inner variables at the start of each 
+*	segment, the second pass recomputes the backtracking of one segment at a time from
+*	the last segment to the first. This costs one more pass over the sequence, but the
+*	working memory drops from N * T to N * ( T / interval + interval ). The smallest
+*	memory is reached for an interval close to the square root of T.
+*
+*	@param[in] model		The model used for decoding
+*	@param[in] seq			The sequence to be decoded
+*	@param[in] interval		Number of time steps in one segment
+*	@param[in] checkpoints	Checkpoints, a ( ( T - 1 ) / interval + 1 ) x ( N + 1 ) matrix
+*	@param[in] backtrack	Integer backtracking of one segment, an interval x N matrix
+*	@param[in] mu			Inner probability variables in a 2 * N matrix
+*	@param[out] o_state_seq The resulting state sequence with highest probability
+*	@param[out] o_logP		The logarithmic probability of the resulting state sequence
+*							given the observed sequence of symbols
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_viterbi_checkpoint_alg ( hmmp_Model model, hmmp_Sequence seq, int interval,
+								  dbl_matrix *checkpoints, int_array *backtrack,
+								  dbl_matrix *mu, hmmp_Sequence *o_state_seq, double *o_logP );
+
 ///Part of the Baum-Welch algorithm: Finding the forward-backward variable ( gamma )
 /**
 *	**This function does not include memory allocation!!!**
@@ -198,4 +331,139 @@ int hmmp_bwa_reest_alg ( hmmp_Model model,		hmmp_Sequence seq,
 						 dbl_matrix *xi,		dbl_matrix *gamma,
 						 dbl_matrix *o_a_num,	dbl_matrix *o_b_num,
 						 dbl_array *o_a_denom,	dbl_array *o_b_denom	);
+
+///Part of the Baum-Welch algorithm: Re-estimating the model parameters of a weighted sequence
+/**
+*	**This function does not include memory allocation!!!**
+*	All output variables must be allocated before using this function.
+*
+*	Same as hmmp_bwa_reest_alg(), but all the contributions of the sequence to the
+*	nominators and denominators are multiplied by 'weight'. A sequence with weight 'w'
+*	contributes as much as 'w' copies of it, so identical sequences can be processed once.
+*
+*	@param[in] model	The current working model
+*	@param[in] seq		The observed sequence
+*	@param[in] xi		The previously obtained xi variables
+*	@param[in] gamma	The previously obtained forward-backward ( gamma ) variables
+*	@param[in] weight	The weight of the sequence
+*	@param[out] o_a_num	Outputs the nominators of the new transition matrix
+*	@param[out] o_b_num Outputs the nominators for the new emission matrix
+*	@param[out] o_a_denom Outputs the denominators for the new transition matrix
+*	@param[out] o_b_denom Outputs the denominators for the new emission matrix
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_bwa_reest_weighted_alg ( hmmp_Model model,		hmmp_Sequence seq,
+								  dbl_matrix *xi,		dbl_matrix *gamma,
+								  double weight,
+								  dbl_matrix *o_a_num,	dbl_matrix *o_b_num,
+								  dbl_array *o_a_denom,	dbl_array *o_b_denom	);
+
+///Part of the Baum-Welch algorithm: Re-estimation fused with the gamma and xi variables
+/**
+*	**This function does not include memory allocation!!!**
+*	All output variables must be allocated before using this function.
+*
+*	Computes the same weighted nominators and denominators as hmmp_bwa_gamma_alg(),
+*	hmmp_bwa_xi_alg() and hmmp_bwa_reest_weighted_alg() in sequence, together with the
+*	contributions to the initial parameters ( gamma at the first time step ). The gamma
+*	and xi variables are computed time step by time step from the rows of 'alfa' and 'beta'
+*	and added to the outputs immediately, so neither the N x T gamma nor the N x N x (T-1)
+*	xi matrices are stored or read back.
+*
+*	The function contains orphaned OpenMP constructs. Called inside a parallel region,
+*	each thread of the team processes a block of states and the function ends with a
+*	barrier; outside a parallel region it executes sequentially.
+*
+*	@param[in] model		The current working model
+*	@param[in] seq			The observed sequence
+*	@param[in] alfa			The forward variables
+*	@param[in] beta			The backward variables ( with scaling factors from the forward alg. )
+*	@param[in] alfa_scale	An array containing the scaling factor for the forward algorithm
+*	@param[in] weight		The weight of the sequence ( 1.0 for plain counting )
+*	@param[out] o_a_num		Outputs the nominators of the new transition matrix
+*	@param[out] o_b_num		Outputs the nominators for the new emission matrix
+*	@param[out] o_a_denom	Outputs the denominators for the new transition matrix
+*	@param[out] o_b_denom	Outputs the denominators for the new emission matrix
+*	@param[out] o_pi		Outputs the sums for the new initial parameters
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_bwa_fused_reest_alg ( hmmp_Model model,		hmmp_Sequence seq,
+							   dbl_matrix *alfa,		dbl_matrix *beta,
+							   dbl_array *alfa_scale,	double weight,
+							   dbl_matrix *o_a_num,		dbl_matrix *o_b_num,
+							   dbl_array *o_a_denom,	dbl_array *o_b_denom,
+							   dbl_array *o_pi );
+
+///Part of the Baum-Welch algorithm: Fused re-estimation using a symbol index
+/**
+*	**This function does not include memory allocation!!!**
+*	All output variables must be allocated before using this function.
+*
+*	Same as hmmp_bwa_fused_reest_alg(), with two changes for large alphabets:
+*		- The emission nominators are computed per symbol as a reduction over the time
+*		  steps listed in the index of the sequence, instead of scattering each time step
+*		  into the row of the observed symbol. The time steps are the outer loop over a
+*		  block of states, so each row of 'alfa' and 'beta' is read contiguously.
+*		- The emission probabilities are read from the transposed emission matrix
+*		  ( see hmmp_forward_emission_t_alg() ).
+*
+*	@param[in] model		The current working model
+*	@param[in] seq			The observed sequence
+*	@param[in] index		The index of the sequence, see hmmp_create_symbol_index()
+*	@param[in] emission_t	The transposed emission matrix of the model
+*	@param[in] alfa			The forward variables
+*	@param[in] beta			The backward variables ( with scaling factors from the forward alg. )
+*	@param[in] alfa_scale	An array containing the scaling factor for the forward algorithm
+*	@param[in] weight		The weight of the sequence ( 1.0 for plain counting )
+*	@param[out] o_a_num		Outputs the nominators of the new transition matrix
+*	@param[out] o_b_num		Outputs the nominators for the new emission matrix
+*	@param[out] o_a_denom	Outputs the denominators for the new transition matrix
+*	@param[out] o_b_denom	Outputs the denominators for the new emission matrix
+*	@param[out] o_pi		Outputs the sums for the new initial parameters
+*	@return @ref hmmp_Error Error code. E_PARAMETER if the index does not match.
+*/
+int hmmp_bwa_fused_reest_index_alg ( hmmp_Model model,		hmmp_Sequence seq,
+									 hmmp_Symbol_Index *index,	dbl_matrix *emission_t,
+									 dbl_matrix *alfa,		dbl_matrix *beta,
+									 dbl_array *alfa_scale,	double weight,
+									 dbl_matrix *o_a_num,	dbl_matrix *o_b_num,
+									 dbl_array *o_a_denom,	dbl_array *o_b_denom,
+									 dbl_array *o_pi );
+
+///Part of the Baum-Welch algorithm: Fused re-estimation on a window of time steps
+/**
+*	**This function does not include memory allocation!!!**
+*	All output variables must be allocated before using this function.
+*
+*	Same as hmmp_bwa_fused_reest_alg() with the transposed emission matrix, but only the 
+*	time steps t_begin ... t_end-1 are added to the outputs. Calling it on consecutive
+*	windows covering the sequence gives the same sums as one call on the whole sequence.
+*	It is used with hmmp_forward_window_alg() and hmmp_backward_window_alg() when the
+*	forward and backward variables of the whole sequence do not fit in memory.
+*
+*	@param[in] model		The current working model
+*	@param[in] seq			The observed sequence
+*	@param[in] emission_t	The transposed emission matrix of the model
+*	@param[in] t_begin		First time step of the window
+*	@param[in] t_end		Time step following the window
+*	@param[in] alfa			The forward variables of the window, row 0 holding t_begin
+*	@param[in] beta			The backward variables ( with scaling factors from the forward alg. )
+*							of the window and of time step t_end unless it is the sequence length
+*	@param[in] alfa_scale	The scaling factors of the forward algorithm, indexed by the time step
+*	@param[in] weight		The weight of the sequence ( 1.0 for plain counting )
+*	@param[out] o_a_num		Outputs the nominators of the new transition matrix
+*	@param[out] o_b_num		Outputs the nominators for the new emission matrix
+*	@param[out] o_a_denom	Outputs the denominators for the new transition matrix
+*	@param[out] o_b_denom	Outputs the denominators for the new emission matrix
+*	@param[out] o_pi		Outputs the sums for the new initial parameters
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_bwa_fused_reest_window_alg ( hmmp_Model model,		hmmp_Sequence seq,
+									  dbl_matrix *emission_t,
+									  int t_begin,				int t_end,
+									  dbl_matrix *alfa,		dbl_matrix *beta,
+									  dbl_array *alfa_scale,	double weight,
+									  dbl_matrix *o_a_num,		dbl_matrix *o_b_num,
+									  dbl_array *o_a_denom,	dbl_array *o_b_denom,
+									  dbl_array *o_pi );
 #endif
\ No newline at end of file
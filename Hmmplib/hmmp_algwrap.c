@@ -36,7 +36,7 @@ int hmmp_forward (	hmmp_Model *model, hmmp_Sequence seq, dbl_matrix **o_addr_alf
 	scaling = hmmp_create_dbl_array(seq.length);
 	if(!scaling)
 		return E_ALLOCATION;
-	alfa = hmmp_create_dbl_matrix(seq.length*model->num_states);
+	alfa = hmmp_create_dbl_matrix((size_t)seq.length*model->num_states);
 	if(!alfa){
 		hmmp_delete_dbl_array(scaling);
 		return E_ALLOCATION;
@@ -56,12 +56,14 @@ int hmmp_backward(	hmmp_Model *model, hmmp_Sequence seq, dbl_matrix **o_addr_bet
 
 	if(!model || !o_addr_beta || !o_scale_arr )
 		return E_PARAMETER;
+	if ( HMMP_SEQUENCE_TYPE ( seq ) == HMMP_SYMBOLS_RLE )
+		return E_ARGUMENT;
 	if (e_overflow = hmmp_memop_overflow(model->num_states, seq.length))
 		return e_overflow;
 	scaling = hmmp_create_dbl_array(seq.length);
 	if(!scaling)
 		return E_ALLOCATION;
-	beta = hmmp_create_dbl_matrix(seq.length*model->num_states);
+	beta = hmmp_create_dbl_matrix((size_t)seq.length*model->num_states);
 	if(!beta){
 		hmmp_delete_dbl_array(scaling);
 		return E_ALLOCATION;
@@ -84,12 +86,12 @@ int hmmp_viterbi(	hmmp_Model log_model,  hmmp_Sequence obs_seq, hmmp_Sequence *o
 		return E_PARAMETER;
 	if (e_overflow = hmmp_memop_overflow(log_model.num_states, obs_seq.length))
 		return e_overflow;
-	backtrack = hmmp_create_int_matrix ( log_model.num_states * obs_seq.length );
+	backtrack = (int_matrix*) hmmp_create_large_buffer ( sizeof ( int_matrix ) * log_model.num_states * obs_seq.length );
 	if(!backtrack)
 		return E_ALLOCATION;
-	mu = hmmp_create_dbl_matrix ( 2 * log_model.num_states );
+	mu = hmmp_create_dbl_matrix ( 2 * (size_t)log_model.num_states );
 	if(!mu){
-		hmmp_delete_int_matrix ( backtrack );
+		hmmp_delete_large_buffer ( backtrack );
 		return E_ALLOCATION;
 	}
 	o_state_seq->seq_id = obs_seq.seq_id;
@@ -100,7 +102,7 @@ int hmmp_viterbi(	hmmp_Model log_model,  hmmp_Sequence obs_seq, hmmp_Sequence *o
 	*o_logPS = logP_recv;
 
 	hmmp_delete_dbl_matrix ( mu );
-	hmmp_delete_int_matrix ( backtrack );
+	hmmp_delete_large_buffer ( backtrack );
 
 	return E_SUCCESS;
 }
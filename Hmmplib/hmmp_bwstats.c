@@ -0,0 +1,360 @@
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#include "hmmp_bwstats.h"
+#include "hmmp_datatypes.h"
+#include "hmmp_memop.h"
+#include "hmmp_dataproc.h"
+#include "hmmp_alg.h"
+#include "hmmp_numa.h"
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <omp.h>
+
+#define HMMP_BWS_MAGIC		0x53574248u	// "HBWS"
+#define HMMP_BWS_VERSION	1u
+#define HMMP_BWS_HEADER		32
+
+int hmmp_bw_stats_reset ( hmmp_Bw_Stats *stats )
+{
+	if ( !stats )
+		return E_PARAMETER;
+	hmmp_init_dbl_dataset ( stats->a_num, 
+			(size_t)stats->num_states * ( stats->num_states + stats->num_symbols + 3 ), 0.0 );
+	stats->logP = 0.0;
+	stats->num_seq = 0;
+	return E_SUCCESS;
+}
+
+/* Common part of the accumulation. Without an index the kernels read the model's emission
+*  matrix, with an index they read the transposed copy 'emission_t'. All the threads run
+*  every construct, so a thread whose section failed returns the error after the others. */
+static int hmmp_bw_stats_accumulate_core ( hmmp_Bw_Stats *stats, hmmp_Model model,
+										   hmmp_Sequence seq, hmmp_Symbol_Index *index,
+										   dbl_matrix *emission_t, double weight,
+										   dbl_matrix *alfa, dbl_matrix *beta,
+										   dbl_array *scales_a, dbl_array *scales_b )
+{
+	int e_forward = E_SUCCESS, e_backward = E_SUCCESS, e_reest;
+	if ( !stats || !alfa || !beta || !scales_a || !scales_b )
+		return E_PARAMETER;
+	// coded runs can not be read backwards
+	if ( HMMP_SEQUENCE_TYPE ( seq ) == HMMP_SYMBOLS_RLE )
+		return E_ARGUMENT;
+#pragma omp sections
+	{
+	#pragma omp section
+		{
+		if ( index )
+			e_forward = hmmp_forward_emission_t_alg(model, seq, emission_t, alfa, scales_a );
+		else
+			e_forward = hmmp_forward_alg(model, seq, alfa, scales_a );
+		if ( !e_forward ){
+			stats->logP += weight * hmmp_log_of_divisors( scales_a, seq.length );
+			++stats->num_seq;
+		}
+		}
+	#pragma omp section
+		{
+		if ( index )
+			e_backward = hmmp_backward_emission_t_alg(model, seq, emission_t, beta, scales_b );
+		else
+			e_backward = hmmp_backward_alg(model, seq, beta, scales_b );
+		}
+	}
+#pragma omp single
+	{ hmmp_backward_rescale(beta,model.num_states,seq.length,scales_a,scales_b);}
+	if ( index )
+		e_reest = hmmp_bwa_fused_reest_index_alg(model,seq,index,emission_t,alfa,beta,scales_a,
+												 weight,stats->a_num,stats->b_num,
+												 stats->a_denom,stats->b_denom,stats->pi_new);
+	else
+		e_reest = hmmp_bwa_fused_reest_alg(model,seq,alfa,beta,scales_a,weight,stats->a_num,
+										   stats->b_num,stats->a_denom,stats->b_denom,
+										   stats->pi_new);
+	if ( e_forward )
+		return e_forward;
+	if ( e_backward )
+		return e_backward;
+	return e_reest;
+}
+
+int hmmp_bw_stats_accumulate_alg ( hmmp_Bw_Stats *stats, hmmp_Model model, hmmp_Sequence seq,
+								   double weight, dbl_matrix *alfa, dbl_matrix *beta,
+								   dbl_array *scales_a, dbl_array *scales_b )
+{
+	return hmmp_bw_stats_accumulate_core ( stats, model, seq, 0, 0, weight, alfa, beta,
+										   scales_a, scales_b );
+}
+
+int hmmp_bw_stats_accumulate_index_alg ( hmmp_Bw_Stats *stats, hmmp_Model model,
+										 hmmp_Sequence seq, hmmp_Symbol_Index *index,
+										 dbl_matrix *emission_t, double weight,
+										 dbl_matrix *alfa, dbl_matrix *beta,
+										 dbl_array *scales_a, dbl_array *scales_b )
+{
+	if ( !index || !emission_t )
+		return E_PARAMETER;
+	return hmmp_bw_stats_accumulate_core ( stats, model, seq, index, emission_t, weight,
+										   alfa, beta, scales_a, scales_b );
+}
+
+int hmmp_bw_stats_accumulate_checkpoint_alg ( hmmp_Bw_Stats *stats, hmmp_Model model,
+											  hmmp_Sequence seq, dbl_matrix *emission_t,
+											  double weight, int interval,
+											  dbl_matrix *alfa_ckpt, dbl_matrix *beta_ckpt,
+											  dbl_matrix *alfa, dbl_matrix *beta,
+											  dbl_array *scales_a, dbl_array *scales_b )
+{
+	size_t i, N;
+	int s, t, t_begin, t_end, num_segments, e, ret = E_SUCCESS;
+	double rescale;
+	dbl_matrix *row;
+
+	if ( !stats || !emission_t || !alfa_ckpt || !beta_ckpt || !alfa || !beta ||
+		 !scales_a || !scales_b )
+		return E_PARAMETER;
+	if ( interval < 1 || seq.length < 1 || HMMP_SEQUENCE_TYPE ( seq ) == HMMP_SYMBOLS_RLE )
+		return E_ARGUMENT;
+	N = model.num_states;
+	num_segments = ( seq.length - 1 ) / interval + 1;
+	// boundaries: alfa_ckpt[s] holds time step s*interval-1, beta_ckpt[s] time step s*interval
+#pragma omp sections
+	{
+	#pragma omp section
+		{
+		for ( s = 0 ; s < num_segments ; ++s ){
+			t_begin = s * interval;
+			t_end = t_begin + interval < seq.length ? t_begin + interval : seq.length;
+			if ( ( e = hmmp_forward_window_alg ( model, seq, emission_t, t_begin, t_end,
+											     alfa_ckpt + (size_t)s*N, alfa, scales_a ) ) )
+				ret = e;
+			if ( s + 1 < num_segments ){
+				row = alfa + (size_t)( t_end - 1 - t_begin )*N;
+				for ( i = 0 ; i < N ; ++i )
+					alfa_ckpt[(size_t)(s+1)*N + i] = row[i];
+			}
+		}
+		if ( !ret ){
+			stats->logP += weight * hmmp_log_of_divisors( scales_a, seq.length );
+			++stats->num_seq;
+		}
+		}
+	#pragma omp section
+		{
+		for ( s = num_segments - 1 ; s >= 0 ; --s ){
+			t_begin = s * interval;
+			t_end = t_begin + interval < seq.length ? t_begin + interval : seq.length;
+			if ( ( e = hmmp_backward_window_alg ( model, seq, emission_t, t_begin, t_end,
+												  beta_ckpt + (size_t)(s+1)*N, beta, scales_b ) ) )
+				ret = e;
+			for ( i = 0 ; i < N ; ++i )
+				beta_ckpt[(size_t)s*N + i] = beta[i];
+		}
+		}
+	}
+#pragma omp single
+	{
+		// the factors of hmmp_backward_rescale(), stored over the backward scaling factors
+		rescale = 1.0;
+		for ( t = seq.length - 1 ; t >= 0 ; --t ){
+			rescale *= scales_a[t]/scales_b[t];
+			scales_b[t] = rescale;
+		}
+	}
+	for ( s = 0 ; s < num_segments ; ++s ){
+		t_begin = s * interval;
+		t_end = t_begin + interval < seq.length ? t_begin + interval : seq.length;
+#pragma omp sections
+		{
+		#pragma omp section
+			if ( ( e = hmmp_forward_window_alg ( model, seq, emission_t, t_begin, t_end,
+											     alfa_ckpt + (size_t)s*N, alfa, 0 ) ) )
+				ret = e;
+		#pragma omp section
+			{
+			if ( ( e = hmmp_backward_window_alg ( model, seq, emission_t, t_begin, t_end,
+												  beta_ckpt + (size_t)(s+1)*N, beta, 0 ) ) )
+				ret = e;
+			if ( t_end < seq.length )
+				for ( i = 0 ; i < N ; ++i )
+					beta[(size_t)( t_end - t_begin )*N + i] = beta_ckpt[(size_t)(s+1)*N + i];
+			for ( t = t_begin ; t <= t_end && t < seq.length ; ++t ){
+				row = beta + (size_t)( t - t_begin )*N;
+				for ( i = 0 ; i < N ; ++i )
+					row[i] *= scales_b[t];
+			}
+			}
+		}
+		if ( ( e = hmmp_bwa_fused_reest_window_alg ( model, seq, emission_t, t_begin, t_end,
+												     alfa, beta, scales_a, weight, stats->a_num,
+												     stats->b_num, stats->a_denom,
+												     stats->b_denom, stats->pi_new ) ) )
+			ret = e;
+	}
+	return ret;
+}
+
+int hmmp_bw_stats_accumulate ( hmmp_Bw_Stats *stats, hmmp_Model *model,
+							   hmmp_Sequence *seq_arr, dbl_array *weights, int num_seq )
+{
+	dbl_matrix *alfa = 0, *beta = 0;
+	dbl_array *scales_a = 0, *scales_b = 0;
+	int k, e, e_overflow, e_accumulate = E_SUCCESS, max_length = 0;
+	char flag_failed = 0;
+
+	if ( !stats || !model || !seq_arr )
+		return E_PARAMETER;
+	if ( stats->num_states != model->num_states || stats->num_symbols != model->num_symbols )
+		return E_ARGUMENT;
+	for ( k = 0 ; k < num_seq ; ++k ){
+		// coded runs can not be read backwards, expand them first
+		if ( HMMP_SEQUENCE_TYPE ( seq_arr[k] ) == HMMP_SYMBOLS_RLE )
+			return E_ARGUMENT;
+		if ( max_length < seq_arr[k].length )
+			max_length = seq_arr[k].length;
+	}
+	if ((e_overflow = hmmp_memop_overflow(model->num_states, max_length)))
+		return e_overflow;
+	alfa = (dbl_matrix*) hmmp_create_large_buffer ( sizeof ( dbl_matrix ) * max_length * model->num_states );
+	if ( !alfa ) {flag_failed = 1; goto SKIP_REST; }
+	beta = (dbl_matrix*) hmmp_create_large_buffer ( sizeof ( dbl_matrix ) * max_length * model->num_states );
+	if ( !beta ) {flag_failed = 1; goto SKIP_REST; }
+	scales_a = hmmp_create_dbl_array ( max_length );
+	if ( !scales_a ) {flag_failed = 1; goto SKIP_REST; }
+	scales_b = hmmp_create_dbl_array ( max_length );
+	if ( !scales_b ) {flag_failed = 1; goto SKIP_REST; }
+	for ( k = 0 ; k < num_seq && !e_accumulate ; ++k ){
+#pragma omp parallel private ( e ) num_threads(HMMP_NUM_THREADS) default(shared)
+		{
+		hmmp_numa_bind_thread ( );
+		if ( ( e = hmmp_bw_stats_accumulate_alg ( stats, *model, seq_arr[k],
+												  weights ? weights[k] : 1.0, alfa, beta,
+												  scales_a, scales_b ) ) ){
+			#pragma omp atomic write
+			e_accumulate = e;
+		}
+		}
+	}
+SKIP_REST:
+	if (scales_b) hmmp_delete_dbl_array(scales_b);
+	if (scales_a) hmmp_delete_dbl_array(scales_a);
+	if (beta) hmmp_delete_large_buffer(beta);
+	if (alfa) hmmp_delete_large_buffer(alfa);
+	if (flag_failed)
+		return E_ALLOCATION;
+	return e_accumulate;
+}
+
+int hmmp_bw_stats_merge ( hmmp_Bw_Stats *dest, hmmp_Bw_Stats *source )
+{
+	size_t i, count;
+	if ( !dest || !source )
+		return E_PARAMETER;
+	if ( dest->num_states != source->num_states || dest->num_symbols != source->num_symbols )
+		return E_ARGUMENT;
+	count = (size_t)dest->num_states * ( dest->num_states + dest->num_symbols + 3 );
+	for ( i = 0 ; i < count ; ++i )
+		dest->a_num[i] += source->a_num[i];
+	dest->logP += source->logP;
+	dest->num_seq += source->num_seq;
+	return E_SUCCESS;
+}
+
+int hmmp_bw_stats_apply ( hmmp_Bw_Stats *stats, hmmp_Model *model )
+{
+	size_t i, j, N, M;
+	if ( !stats || !model )
+		return E_PARAMETER;
+	if ( stats->num_states != model->num_states || stats->num_symbols != model->num_symbols )
+		return E_ARGUMENT;
+	N = model->num_states;
+	M = model->num_symbols;
+	for ( i = 0 ; i < N ; ++i )
+		model->initial[i] = stats->pi_new[i];
+	hmmp_normalize_arr( model->initial, model->num_states );
+
+	for ( i = 0 ; i < N ; ++i ){
+		for ( j = 0 ; j < N ; ++j ){
+			model->transition[i*model->num_states+j] = stats->a_num[i*model->num_states+j] / stats->a_denom[i];
+		}
+		for ( j = 0 ; j < M ; ++j ){
+			model->emission[i*model->num_symbols+j] = stats->b_num[i*model->num_symbols+j] / stats->b_denom[i];
+		}
+	}
+	model->prior = stats->logP;
+	return E_SUCCESS;
+}
+
+size_t hmmp_bw_stats_blob_size ( hmmp_Bw_Stats *stats )
+{
+	if ( !stats )
+		return 0;
+	return HMMP_BWS_HEADER + sizeof(double) * (size_t)stats->num_states * 
+			( stats->num_states + stats->num_symbols + 3 );
+}
+
+int hmmp_bw_stats_serialize ( hmmp_Bw_Stats *stats, void *o_blob )
+{
+	unsigned int header[6];
+	char *p = (char*) o_blob;
+	if ( !stats || !o_blob )
+		return E_PARAMETER;
+	header[0] = HMMP_BWS_MAGIC;
+	header[1] = HMMP_BWS_VERSION;
+	header[2] = stats->num_states;
+	header[3] = stats->num_symbols;
+	header[4] = stats->num_seq;
+	header[5] = 0;
+	memcpy ( p, header, sizeof ( header ) );
+	memcpy ( p + sizeof ( header ), &stats->logP, sizeof ( double ) );
+	memcpy ( p + HMMP_BWS_HEADER, stats->a_num, hmmp_bw_stats_blob_size ( stats ) - HMMP_BWS_HEADER );
+	return E_SUCCESS;
+}
+
+int hmmp_bw_stats_deserialize ( hmmp_Bw_Stats **o_stats, const void *blob, size_t blob_size )
+{
+	unsigned int header[6];
+	const char *p = (const char*) blob;
+	hmmp_Bw_Stats *stats;
+	uint64_t cells;
+	if ( !o_stats || !blob )
+		return E_PARAMETER;
+	*o_stats = 0;
+	if ( blob_size < HMMP_BWS_HEADER )
+		return E_FILE_FORMAT;
+	memcpy ( header, p, sizeof ( header ) );
+	if ( header[0] != HMMP_BWS_MAGIC || header[1] != HMMP_BWS_VERSION )
+		return E_FILE_FORMAT;
+	// the dimensions must give exactly the size of the blob, checked without overflow
+	cells = ( blob_size - HMMP_BWS_HEADER ) / sizeof ( double );
+	if ( header[2] < 1 || header[2] > INT_MAX || header[3] < 1 || header[3] > INT_MAX ||
+		 ( blob_size - HMMP_BWS_HEADER ) % sizeof ( double ) || cells % header[2] ||
+		 cells / header[2] != (uint64_t) header[2] + header[3] + 3 )
+		return E_FILE_FORMAT;
+	stats = hmmp_create_bw_stats ( (int) header[2], (int) header[3] );
+	if ( !stats )
+		return E_ALLOCATION;
+	stats->num_seq = header[4];
+	memcpy ( &stats->logP, p + sizeof ( header ), sizeof ( double ) );
+	memcpy ( stats->a_num, p + HMMP_BWS_HEADER, blob_size - HMMP_BWS_HEADER );
+	*o_stats = stats;
+	return E_SUCCESS;
+}
@@ -0,0 +1,222 @@
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#ifndef HMMP_BWSTATS_H
+#define HMMP_BWSTATS_H
+/** @file
+*	This file contains the functions operating on the expected counts of the Baum-Welch
+*	algorithm ( hmmp_Bw_Stats ). They split the learning in its two steps:
+*		- Expectation: accumulating the counts over sequences for the current model.
+*		- Maximization: applying the accumulated counts to the model parameters.
+*
+*	The counts are additive, so the expectation step can be distributed. Each worker
+*	( thread, process or machine ) accumulates its share of the sequences, serializes
+*	the counts to a binary blob and a coordinator merges the blobs and applies them:
+*	\code{.c}
+*		// worker
+*		hmmp_bw_stats_reset(stats);
+*		hmmp_bw_stats_accumulate(stats, model, my_sequences, NULL, my_num_seq);
+*		hmmp_save_bw_stats("shard_3.bws", stats);
+*		// coordinator
+*		hmmp_load_bw_stats(&shard, "shard_3.bws");
+*		hmmp_bw_stats_merge(total, shard);
+*		// ... after merging all shards
+*		hmmp_bw_stats_apply(total, model);
+*	\endcode
+*	One such round is one step of hmmp_baum_welch().
+*/
+#include "hmmp_datatypes.h"
+#include <stddef.h>
+
+/// Set all the counts to zero.
+/**
+*	@param[in,out] stats Address of the container to be reset
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_bw_stats_reset ( hmmp_Bw_Stats *stats );
+
+/// Accumulate the expected counts of one sequence. Algorithmic solution.
+/**
+*	**This function does not include memory allocation!!!**
+*
+*	Executes the expectation part of the Baum-Welch algorithm for one sequence:
+*	hmmp_forward_alg() and hmmp_backward_alg() as concurrent sections, hmmp_backward_rescale()
+*	and hmmp_bwa_fused_reest_alg(), which adds the results multiplied by 'weight' to the
+*	counts without storing the gamma and xi variables. The logarithmic probability is weighted
+*	the same way, while the number of sequences is increased by one.
+*
+*	The function contains orphaned OpenMP work-sharing constructs. Call it from inside
+*	a parallel region executed by all the threads of the team to use the parallelism,
+*	or outside a parallel region to execute it sequentially. An error of the forward or
+*	backward pass is returned by the thread which ran that pass, after all the threads
+*	finished the function; the counts are then not valid.
+*
+*	The containers should be sized as for the Baum-Welch sub-algorithms: N x T for 'alfa'
+*	and 'beta' and T for the scaling factors.
+*
+*	@param[in,out] stats	The counts to add to
+*	@param[in] model		The current working model
+*	@param[in] seq			The observed sequence
+*	@param[in] weight		The weight of the sequence ( 1.0 for plain counting )
+*	@param[in] alfa			Pre-allocated container for the forward variables
+*	@param[in] beta			Pre-allocated container for the backward variables
+*	@param[in] scales_a		Pre-allocated container for the forward scaling factors
+*	@param[in] scales_b		Pre-allocated container for the backward scaling factors
+*	@return @ref hmmp_Error Error code. E_ARGUMENT for a sequence of type HMMP_SYMBOLS_RLE.
+*/
+int hmmp_bw_stats_accumulate_alg ( hmmp_Bw_Stats *stats, hmmp_Model model, hmmp_Sequence seq,
+								   double weight, dbl_matrix *alfa, dbl_matrix *beta,
+								   dbl_array *scales_a, dbl_array *scales_b );
+
+/// Accumulate the expected counts of one sequence using its symbol index. Algorithmic solution.
+/**
+*	**This function does not include memory allocation!!!**
+*
+*	Same as hmmp_bw_stats_accumulate_alg(), but the forward and backward passes and the
+*	re-estimation read the emission probabilities of each time step as a contiguous column
+*	of the transposed emission matrix ( see hmmp_forward_emission_t_alg() ), and the
+*	emission counts are reduced per symbol over the time steps listed in the index
+*	( see hmmp_bwa_fused_reest_index_alg() ).
+*
+*	The index depends only on the sequence and the transposed matrix only on the model,
+*	so over many steps the indices can be built once and the matrix once per step. The
+*	learning entry points use hmmp_bw_stats_accumulate_alg(), which was measured faster.
+*
+*	@param[in,out] stats	The counts to add to
+*	@param[in] model		The current working model
+*	@param[in] seq			The observed sequence
+*	@param[in] index		The index of the sequence, see hmmp_create_symbol_index()
+*	@param[in] emission_t	The transposed emission matrix of the model
+*	@param[in] weight		The weight of the sequence ( 1.0 for plain counting )
+*	@param[in] alfa			Pre-allocated container for the forward variables
+*	@param[in] beta			Pre-allocated container for the backward variables
+*	@param[in] scales_a		Pre-allocated container for the forward scaling factors
+*	@param[in] scales_b		Pre-allocated container for the backward scaling factors
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_bw_stats_accumulate_index_alg ( hmmp_Bw_Stats *stats, hmmp_Model model,
+										 hmmp_Sequence seq, hmmp_Symbol_Index *index,
+										 dbl_matrix *emission_t, double weight,
+										 dbl_matrix *alfa, dbl_matrix *beta,
+										 dbl_array *scales_a, dbl_array *scales_b );
+
+/// Accumulate the expected counts of one sequence with checkpoints. Algorithmic solution.
+/**
+*	**This function does not include memory allocation!!!**
+*
+*	Same counts as hmmp_bw_stats_accumulate_alg(), for sequences whose forward and backward
+*	variables do not fit in memory. The sequence is split in segments of 'interval' time
+*	steps. A first forward and backward pass keeps only the variables at the segment
+*	boundaries and all the scaling factors. Then the variables of one segment at a time
+*	are recomputed from the boundaries and added to the counts with
+*	hmmp_bwa_fused_reest_window_alg(). This costs one more forward and backward pass, the
+*	working memory drops from 2 x N x T to about 2 x N x ( T / interval + interval ).
+*
+*	Must be called by all threads of a parallel region, as hmmp_bw_stats_accumulate_alg().
+*
+*	@param[in,out] stats	The counts to add to
+*	@param[in] model		The current working model
+*	@param[in] seq			The observed sequence
+*	@param[in] emission_t	The transposed emission matrix of the model
+*	@param[in] weight		The weight of the sequence ( 1.0 for plain counting )
+*	@param[in] interval		Number of time steps in one segment
+*	@param[in] alfa_ckpt	Pre-allocated ( ( T - 1 ) / interval + 1 ) x N container
+*							for the forward variables at the segment boundaries
+*	@param[in] beta_ckpt	Pre-allocated container of the same size for the backward variables
+*	@param[in] alfa			Pre-allocated interval x N container for the forward variables
+*	@param[in] beta			Pre-allocated ( interval + 1 ) x N container for the backward variables
+*	@param[in] scales_a		Pre-allocated container for the forward scaling factors ( T )
+*	@param[in] scales_b		Pre-allocated container for the backward scaling factors ( T )
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_bw_stats_accumulate_checkpoint_alg ( hmmp_Bw_Stats *stats, hmmp_Model model,
+											  hmmp_Sequence seq, dbl_matrix *emission_t,
+											  double weight, int interval,
+											  dbl_matrix *alfa_ckpt, dbl_matrix *beta_ckpt,
+											  dbl_matrix *alfa, dbl_matrix *beta,
+											  dbl_array *scales_a, dbl_array *scales_b );
+
+/// Accumulate the expected counts of multiple sequences including memory allocation.
+/**
+*	The counts are added to the existing ones, use hmmp_bw_stats_reset() before the first
+*	sequences of a step. The parallelism is the same as in hmmp_baum_welch(), set with the
+*	global variable HMMP_NUM_THREADS.
+*
+*	@param[in,out] stats	The counts to add to
+*	@param[in] model		The current working model
+*	@param[in] seq_arr		Adress of an array of observable sequences
+*	@param[in] weights		Adress of an array with the weight of each sequence,
+*							or NULL for weight 1.0 of all sequences
+*	@param[in] num_seq		Number of observable sequences in the array
+*	@return @ref hmmp_Error Error code. E_ARGUMENT if a sequence is of type HMMP_SYMBOLS_RLE,
+*			which is checked before any counts are added.
+*/
+int hmmp_bw_stats_accumulate ( hmmp_Bw_Stats *stats, hmmp_Model *model,
+							   hmmp_Sequence *seq_arr, dbl_array *weights, int num_seq );
+
+/// Add the counts of one container to another.
+/**
+*	@param[in,out] dest	The counts to add to
+*	@param[in] source	The counts to be added
+*	@return @ref hmmp_Error Error code. E_ARGUMENT if the numbers of states or symbols differ.
+*/
+int hmmp_bw_stats_merge ( hmmp_Bw_Stats *dest, hmmp_Bw_Stats *source );
+
+/// Reestimate the model parameters from the accumulated counts.
+/**
+*	The prior of the model is set to the accumulated logarithmic probability, which is
+*	the probability of the model the counts were accumulated with.
+*
+*	@param[in] stats		The accumulated counts
+*	@param[in,out] model	The model to receive the reestimated parameters
+*	@return @ref hmmp_Error Error code. E_ARGUMENT if the numbers of states or symbols differ.
+*/
+int hmmp_bw_stats_apply ( hmmp_Bw_Stats *stats, hmmp_Model *model );
+
+/// Size in bytes of the binary blob holding the counts.
+/**
+*	@param[in] stats The counts to be serialized
+*	@return Size of the blob in bytes. 0 on invalid input.
+*/
+size_t hmmp_bw_stats_blob_size ( hmmp_Bw_Stats *stats );
+
+/// Serialize the counts to a binary blob.
+/**
+*	The blob consists of a 32 byte header ( magic, version, numbers of states, symbols and
+*	sequences, logarithmic probability ) followed by the counts as doubles in the order:
+*	a_num, b_num, a_denom, b_denom, pi_new. Numbers are stored in the native byte order.
+*
+*	@param[in] stats	The counts to be serialized
+*	@param[out] o_blob	Pre-allocated buffer of hmmp_bw_stats_blob_size() bytes
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_bw_stats_serialize ( hmmp_Bw_Stats *stats, void *o_blob );
+
+/// Create a container of counts from a binary blob.
+/**
+*	Use hmmp_delete_bw_stats() to delete the resulting container.
+*
+*	@param[out] o_stats	Address of a pointer to receive the address of the new container
+*	@param[in] blob		The binary blob created with hmmp_bw_stats_serialize()
+*	@param[in] blob_size Size of the blob in bytes
+*	@return @ref hmmp_Error Error code. E_FILE_FORMAT if the blob is corrupt.
+*/
+int hmmp_bw_stats_deserialize ( hmmp_Bw_Stats **o_stats, const void *blob, size_t blob_size );
+
+#endif
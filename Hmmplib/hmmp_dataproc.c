@@ -21,43 +21,56 @@
 #include "hmmp_datatypes.h"
 #include "hmmp_memop.h"
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <float.h>
+#include <stdint.h>
 
 const double HMMP_DBL_MAX = 1.7976931348623157e+308;
 const double HMMP_PRECISION = 2.2204460492503131e-016;
 
 int hmmp_transpose_matrix ( dbl_matrix *mat, int num_rows, int num_cols )
 {
-	int i, j;
+	size_t i, j;
 	dbl_matrix *mat2;
 	if ( !mat )
 		return E_PARAMETER;
-	mat2 = hmmp_create_dbl_matrix(num_rows*num_cols);
+	mat2 = hmmp_create_dbl_matrix((size_t)num_rows*num_cols);
 	if(!mat2)
 		return E_ALLOCATION;
-	for ( i = 0 ; i < num_rows ; ++i )
-		for ( j = 0 ; j < num_cols ; ++j )
+	for ( i = 0 ; i < (size_t)num_rows ; ++i )
+		for ( j = 0 ; j < (size_t)num_cols ; ++j )
 			mat2[j*num_rows+i]=mat[i*num_cols+j];
-	for ( i = 0 ; i < num_rows*num_cols ; ++i )
+	for ( i = 0 ; i < (size_t)num_rows*num_cols ; ++i )
 			mat[i]=mat2[i];
 	hmmp_delete_dbl_matrix(mat2);
 	return E_SUCCESS;
 }
 
+int hmmp_transpose_matrix_copy ( dbl_matrix *o_dest, dbl_matrix *mat, int num_rows, int num_cols )
+{
+	size_t i, j;
+	if ( !o_dest || !mat )
+		return E_PARAMETER;
+	for ( i = 0 ; i < (size_t)num_rows ; ++i )
+		for ( j = 0 ; j < (size_t)num_cols ; ++j )
+			o_dest[j*num_rows+i]=mat[i*num_cols+j];
+	return E_SUCCESS;
+}
+
 int hmmp_normalize_columns ( dbl_matrix *mat, int num_rows, int num_cols )
 {
-	int i, j;
+	size_t i, j;
 	double partsum;
 	if(!mat)
 		return E_PARAMETER;
-	for( i = 0 ; i < num_cols ; ++i ){
+	for( i = 0 ; i < (size_t)num_cols ; ++i ){
 		partsum = 0.0;
-		for( j = 0 ; j < num_rows ; ++j)
+		for( j = 0 ; j < (size_t)num_rows ; ++j)
 			partsum += mat[j*num_cols+i];
 		partsum = 1 / partsum;
-		for( j = 0 ; j < num_rows ; ++j)
+		for( j = 0 ; j < (size_t)num_rows ; ++j)
 			mat[j*num_cols+i]*=partsum;
 	}
 	return E_SUCCESS;
@@ -65,16 +78,16 @@ int hmmp_normalize_columns ( dbl_matrix *mat, int num_rows, int num_cols )
 
 int hmmp_normalize_rows ( dbl_matrix *mat, int num_rows, int num_cols )
 {
-	int i, j;
+	size_t i, j;
 	double partsum;
 	if(!mat)
 		return E_PARAMETER;
-	for( i = 0 ; i < num_rows ; ++i ){
+	for( i = 0 ; i < (size_t)num_rows ; ++i ){
 		partsum = 0.0;
-		for( j = 0 ; j < num_cols ; ++j)
+		for( j = 0 ; j < (size_t)num_cols ; ++j)
 			partsum += mat[i*num_cols+j];
 		partsum = 1.0 / partsum;
-		for( j = 0 ; j < num_cols ; ++j)
+		for( j = 0 ; j < (size_t)num_cols ; ++j)
 			mat[i*num_cols+j]*=partsum;
 	}
 	return E_SUCCESS;
@@ -94,9 +107,9 @@ double hmmp_normalize_arr ( dbl_array *arr, int num_items )
 	return partsum;
 }
 
-int hmmp_init_dbl_dataset ( double *p, int size, double value )
+int hmmp_init_dbl_dataset ( double *p, size_t size, double value )
 {
-	int i;
+	size_t i;
 	if(!p)
 		return E_PARAMETER;
 	for ( i = size ; i-- ; )
@@ -136,9 +149,9 @@ double hmmp_log_of_divisors ( double *divisors, int num_div )
 	}
 	return ret;
 }
-int hmmp_data_log_scale ( double *data, int count )
+int hmmp_data_log_scale ( double *data, size_t count )
 {
-	int i;
+	size_t i;
 	if(!data)
 		return E_PARAMETER;
 	for ( i = 0 ; i < count ; ++i ){
@@ -154,27 +167,22 @@ int hmmp_model_log_param ( hmmp_Model *m )
 	if(!m)
 		return E_PARAMETER;
 	hmmp_data_log_scale(m->initial,m->num_states);
-	hmmp_data_log_scale(m->transition,m->num_states*m->num_states);
-	hmmp_data_log_scale(m->emission,m->num_states*m->num_symbols);
+	hmmp_data_log_scale(m->transition,(size_t)m->num_states*m->num_states);
+	hmmp_data_log_scale(m->emission,(size_t)m->num_states*m->num_symbols);
 	return E_SUCCESS;
 }
 
-int hmmp_multiplication_overflow(unsigned int *arr, int count){
-	double dbl_test = 1.0;
-	int	int_test = 1;
+int hmmp_multiplication_overflow(size_t *arr, int count){
+	size_t product = 1;
 	int i;
 	if ( !arr || count < 2 ){
 		return E_ARGUMENT;
 	}
 	for ( i = 0 ; i < count ; ++i ){
-		dbl_test *= (double) arr[i];
-		int_test *= arr[i];
-	}
-	for( i = 1 ; i < count; ++i ){
-		int_test /= arr[i];
+		if ( arr[i] && product > SIZE_MAX / arr[i] )
+			return 1;
+		product *= arr[i];
 	}
-	if ( dbl_test > (double) (UINT_MAX-1) )
-		return 1;
 	return 0;
 }
 int hmmp_model_copy ( hmmp_Model *dest, hmmp_Model *source )
@@ -185,15 +193,101 @@ int hmmp_model_copy ( hmmp_Model *dest, hmmp_Model *source )
 	dest->num_states = source->num_states;
 	dest->num_symbols = source->num_symbols;
 	dest->prior = source->prior;
-	memcpy ( dest->initial, source->initial, source->num_states * sizeof ( dbl_array ) );
+	memcpy ( dest->initial, source->initial, (size_t)source->num_states * sizeof ( dbl_array ) );
 	memcpy ( dest->transition, source->transition,
-			source->num_states*source->num_states * sizeof ( dbl_matrix ));
+			(size_t)source->num_states*source->num_states * sizeof ( dbl_matrix ));
 	memcpy ( dest->emission, source->emission, 
-		source->num_states*source->num_symbols * sizeof ( dbl_matrix));
+		(size_t)source->num_states*source->num_symbols * sizeof ( dbl_matrix));
 	return E_SUCCESS;
 }
 double hmmp_model_logprobability ( dbl_array *forward_scale, int length ){
 	if ( !forward_scale || !length )
 		return 0.0;
 	return hmmp_log_of_divisors(forward_scale, length);
-};
\ No newline at end of file
+}
+
+static unsigned hmmp_sequence_hash ( hmmp_Sequence *seq )
+{
+	// FNV-1a over the length and the symbols of the sequence
+	unsigned h = 2166136261u;
+	int t;
+	hmmp_Rle_Cursor c;
+	h = ( h ^ (unsigned) seq->length ) * 16777619u;
+	hmmp_rle_seek ( &c, *seq, 0 );
+	for ( t = 0 ; t < seq->length ; ++t )
+		h = ( h ^ (unsigned) HMMP_NEXT_SYMBOL ( *seq, t, c ) ) * 16777619u;
+	return h;
+}
+
+/* Equal symbols, whatever the storage types of the two sequences. */
+static int hmmp_sequence_equal ( hmmp_Sequence *a, hmmp_Sequence *b )
+{
+	int t, symbol_type = HMMP_SEQUENCE_TYPE ( *a );
+	hmmp_Rle_Cursor ca, cb;
+	if ( a->length != b->length )
+		return 0;
+	// consecutive symbols of the same size, which hmmp_symbol_size() tells
+	if ( symbol_type == HMMP_SEQUENCE_TYPE ( *b ) && hmmp_symbol_size ( symbol_type ) )
+		return !memcmp ( a->sequence ? (void*) a->sequence : a->symbols,
+						 b->sequence ? (void*) b->sequence : b->symbols,
+						 a->length * hmmp_symbol_size ( symbol_type ) );
+	hmmp_rle_seek ( &ca, *a, 0 );
+	hmmp_rle_seek ( &cb, *b, 0 );
+	for ( t = 0 ; t < a->length ; ++t )
+		if ( HMMP_NEXT_SYMBOL ( *a, t, ca ) != HMMP_NEXT_SYMBOL ( *b, t, cb ) )
+			return 0;
+	return 1;
+}
+
+int hmmp_dedup_sequences ( hmmp_Sequence *seq_arr, dbl_array *weights, int num_seq )
+{
+	hmmp_Sequence tmp;
+	unsigned *hashes;
+	int_array *table;
+	unsigned h, mask;
+	int k, u, slot, size;
+
+	if ( !seq_arr || !weights || num_seq < 0 )
+		return E_PARAMETER;
+	if ( num_seq < 2 )
+		return num_seq;
+	for ( size = 2 ; size < 2*num_seq ; size <<= 1 );
+	mask = (unsigned) size - 1;
+	table = hmmp_create_int_array ( size );
+	hashes = ( unsigned* ) malloc ( num_seq * sizeof ( unsigned ) );
+	if ( !table || !hashes ){
+		if ( table ) hmmp_delete_int_array ( table );
+		if ( hashes ) free ( hashes );
+		return E_ALLOCATION;
+	}
+	for ( k = 0 ; k < size ; ++k )
+		table[k] = -1;
+	u = 0;
+	for ( k = 0 ; k < num_seq ; ++k ){
+		h = hmmp_sequence_hash ( seq_arr + k );
+		// open addressing with linear probing, the table holds positions of unique sequences
+		for ( slot = h & mask ; table[slot] != -1 ; slot = ( slot + 1 ) & mask ){
+			if ( hashes[table[slot]] == h &&
+				 hmmp_sequence_equal ( seq_arr + table[slot], seq_arr + k ) )
+				break;
+		}
+		if ( table[slot] != -1 ){
+			weights[table[slot]] += weights[k];
+			weights[k] = 0.0;
+			continue;
+		}
+		// swap instead of overwrite so the array stays a permutation of the input
+		tmp = seq_arr[u];
+		seq_arr[u] = seq_arr[k];
+		seq_arr[k] = tmp;
+		weights[u] = weights[k];
+		if ( u != k )
+			weights[k] = 0.0;
+		hashes[u] = h;
+		table[slot] = u;
+		++u;
+	}
+	free ( hashes );
+	hmmp_delete_int_array ( table );
+	return u;
+}
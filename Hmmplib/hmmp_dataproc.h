@@ -34,6 +34,16 @@
 */
 int hmmp_transpose_matrix ( dbl_matrix *mat, int num_rows, int num_cols );
 
+/// Write the transpose of a matrix into another matrix.
+/** 
+*	@param[out]	o_dest Address of a pre-allocated num_cols x num_rows matrix
+*	@param[in]	mat Address of the matrix to be transposed
+*	@param[in]	num_rows Number of rows
+*	@param[in]	num_cols Number of columns
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_transpose_matrix_copy ( dbl_matrix *o_dest, dbl_matrix *mat, int num_rows, int num_cols );
+
 /// Normalize the values in each column of a matrix to sum up to 1.0.
 /** 
 *	@param[in,out] mat Address of the matrix to be modified
@@ -59,7 +69,7 @@ int hmmp_normalize_rows ( dbl_matrix *mat, int num_rows, int num_cols );
 *	@param[in]	value The value to be assigned to each member of the array
 *	@return @ref hmmp_Error Error code..
 */
-int hmmp_init_dbl_dataset ( double *p, int size, double value );
+int hmmp_init_dbl_dataset ( double *p, size_t size, double value );
 
 /// Normalize an array of real numbers to 1.0.
 /** 
@@ -130,7 +140,7 @@ double hmmp_log_of_divisors ( double* divisors, int num_div );
 *	@param[in]	count The number of data items
 *	@return @ref hmmp_Error Error code.
 */
-int hmmp_data_log_scale ( double *data, int count );
+int hmmp_data_log_scale ( double *data, size_t count );
 
 /// Change the model parameters to logarithmic scale
 /** 
@@ -147,15 +157,15 @@ int hmmp_data_log_scale ( double *data, int count );
 */
 int hmmp_model_log_param ( hmmp_Model *m );
 
-/// Check if multiplication between unsigned integers will overflow.
+/// Check if multiplication between sizes will overflow.
 /** 
 *	This function is used extensively troughout the library to sequre the input to memory
-*	allocation modules.
+*	allocation modules. The product is checked against the range of size_t.
 *	@param[in]	arr Array of the integers to be multiplied.
 *	@param[in]	count Number of integers in the array.
 *	@return If multiplication overflows: 1 'True', if not: 0 'False'
 */
-int hmmp_multiplication_overflow(unsigned *arr, int count);
+int hmmp_multiplication_overflow(size_t *arr, int count);
 
 /// Create a copy of a model into an empty model
 /** 
@@ -184,6 +194,26 @@ int hmmp_model_copy ( hmmp_Model *dest, hmmp_Model *source );
 */
 double hmmp_model_logprobability ( dbl_array *forward_scale, int length );
 
+/// Collapse identical sequences into one weighted sequence.
+/** 
+*	The sequences are compared by their length and symbols ( not by 'seq_id' ) using a
+*	hash table. The array is reordered in place: the first unique occurrence of each
+*	sequence is moved to the front and its weight becomes the sum of the weights of all
+*	its occurrences. The duplicates are moved behind the unique sequences with weight 0.0.
+*	No sequence data is copied or freed, the array remains a permutation of the input and
+*	can still be deleted with hmmp_delete_arr_seq().
+*
+*	It is used before learning with hmmp_baum_welch_weighted(), where a sequence with
+*	weight 'w' contributes as much as 'w' copies of it.
+*
+*	@param[in,out]	seq_arr Address of the array of sequences
+*	@param[in,out]	weights Address of an array with the weight of each sequence
+*					( all 1.0 for plain counting )
+*	@param[in]	num_seq Number of sequences in the array
+*	@return Number of unique sequences at the front of the array, or a negative
+*			@ref hmmp_Error error code.
+*/
+int hmmp_dedup_sequences ( hmmp_Sequence *seq_arr, dbl_array *weights, int num_seq );
 
 
 #endif
\ No newline at end of file
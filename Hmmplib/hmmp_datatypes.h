@@ -24,6 +24,8 @@
 *	can find declaration of external constants defined in dataproc.c and error codes enum
 *	definition.
 */
+#include <stddef.h>
+#include <stdint.h>
 
 /// One dimentional array is used to represent all complex types.
 typedef double dbl_matrix;
@@ -67,20 +69,280 @@ typedef struct s_hmmp_Model hmmp_Model;
 *	emission[j*M + k] = probability of emitting symbol 'k' from state 'j'
  */
 
+/// Storage type of the symbols of a sequence, see hmmp_Sequence::symbol_type.
+#define HMMP_SYMBOLS_INT	0	///< int symbols, the default.
+/// Storage type of the symbols of a sequence, see hmmp_Sequence::symbol_type.
+#define HMMP_SYMBOLS_UINT8	1	///< uint8_t symbols, for up to 256 symbols.
+/// Storage type of the symbols of a sequence, see hmmp_Sequence::symbol_type.
+#define HMMP_SYMBOLS_UINT16	2	///< uint16_t symbols, for up to 65536 symbols.
+/// Storage type of the symbols of a sequence, see hmmp_Sequence::symbol_type.
+#define HMMP_SYMBOLS_RLE	3	///< Runs of equal symbols coded as varints, see hmmp_rle_encode().
+/// Storage type of the symbols of a sequence, see hmmp_Sequence::symbol_type.
+#define HMMP_SYMBOLS_VIEW	4	///< Symbols read through a hmmp_Sequence_View, see hmmp_sequence_view().
+
+/// Content of a batch of a results file, see hmmp_append_results().
+#define HMMP_RESULTS_LOGP		0	///< The seq_id and logarithmic probability of each sequence.
+/// Content of a batch of a results file, see hmmp_append_results().
+#define HMMP_RESULTS_STATES		1	///< Also the state sequences, with the smallest width.
+/// Content of a batch of a results file, see hmmp_append_results().
+#define HMMP_RESULTS_STATES_RLE	2	///< Also the state sequences, as runs of equal states.
+
 /// An instance of this structure represents one squence
 /** This structure can be used for both observable symbol sequences and hidden state
-*	transition sequences.*/
+*	transition sequences. The symbols are normally an int array pointed to by 'sequence'.
+*	Observable symbols can instead be stored in 8 or 16 bits, compressed into runs
+*	( HMMP_SYMBOLS_RLE ) or read in place through a hmmp_Sequence_View; then 'sequence' is
+*	0, 'symbols' points to them and 'symbol_type' tells how they are stored. Read them with
+*	HMMP_SYMBOL(), or in order with HMMP_NEXT_SYMBOL(). State sequences are always int.
+*	'symbols' and 'symbol_type' are only read when 'sequence' is 0, so a sequence filled in
+*	by hand with an int array needs nothing else; still start such sequences from
+*	HMMP_SEQUENCE_INIT or hmmp_sequence_init().*/
 /** @see hmmp_Sequence */
 struct s_hmmp_Sequence {
 	int seq_id;			///< Sequence's specific ID
 	int length;			///< Sequence's length ( number of time steps )
 	int cardinality;	///< Number of different symbols/states possible.
-	int_array *sequence;///< Pointer to an array containing the sequence.
+	int_array *sequence;///< Pointer to an array containing the sequence, 0 for other storage.
+	uint8_t *symbols;	///< The symbols when 'sequence' is 0, stored as given by 'symbol_type'.
+	int symbol_type;	///< Storage type of 'symbols', only read when 'sequence' is 0.
 };
 /// Definition of a sequence type ommiting the 'struct' keyword.
 /** @see s_hmmp_Sequence */
 typedef struct s_hmmp_Sequence hmmp_Sequence;
 
+/// Initializer of an empty hmmp_Sequence of int symbols.
+#define HMMP_SEQUENCE_INIT { 0, 0, 0, 0, 0, HMMP_SYMBOLS_INT }
+
+/// Storage type of the sequence 'seq' ( a hmmp_Sequence, not a pointer ).
+#define HMMP_SEQUENCE_TYPE( seq ) ( (seq).sequence ? HMMP_SYMBOLS_INT : (seq).symbol_type )
+
+/// An instance of this structure describes symbols in memory owned by the caller.
+/** The symbols are 'width' bytes each and 'stride' bytes apart, e.g. a column of an array
+*	of records. Check hmmp_sequence_view() in hmmp_memop.h for reading them as a sequence.
+*	@see hmmp_Sequence_View */
+struct s_hmmp_Sequence_View {
+	const uint8_t *data;	///< Address of the first symbol.
+	int length;				///< Number of symbols.
+	int width;				///< Size of one symbol in bytes: 1, 2 or 4, or 0 for coded runs.
+	int stride;				///< Bytes from one symbol to the next, 0 or 'width' if consecutive.
+};
+/// Definition of the sequence view type ommiting the 'struct' keyword.
+/** @see s_hmmp_Sequence_View */
+typedef struct s_hmmp_Sequence_View hmmp_Sequence_View;
+
+/// Symbol 't' of the sequence 'seq' ( a hmmp_Sequence, not a pointer ) as an int.
+/** Works for all storage types but HMMP_SYMBOLS_RLE. Int symbols cost one test, the tests
+*	are predicted perfectly inside the loops over a sequence.*/
+#define HMMP_SYMBOL( seq, t ) \
+	( (seq).sequence ? (seq).sequence[t] : \
+	  (seq).symbol_type == HMMP_SYMBOLS_UINT8 ? (int) (seq).symbols[t] : \
+	  (seq).symbol_type == HMMP_SYMBOLS_UINT16 ? (int) ( (uint16_t*) (seq).symbols )[t] : \
+	  HMMP_VIEW_SYMBOL ( (const hmmp_Sequence_View*) (seq).symbols, t ) )
+
+/// Symbol 't' of the view 'view' ( a pointer to a hmmp_Sequence_View ), used by HMMP_SYMBOL().
+#define HMMP_VIEW_SYMBOL( view, t ) \
+	( (view)->width == 1 ? (int) (view)->data[(ptrdiff_t) (t) * (view)->stride] : \
+	  (view)->width == 2 ? \
+		(int) *(const uint16_t*) ( (view)->data + (ptrdiff_t) (t) * (view)->stride ) : \
+		*(const int_array*) ( (view)->data + (ptrdiff_t) (t) * (view)->stride ) )
+
+/// An instance of this structure is a position in a sequence of type HMMP_SYMBOLS_RLE.
+/** Check hmmp_rle_seek() in hmmp_memop.h.
+*	@see hmmp_Rle_Cursor */
+struct s_hmmp_Rle_Cursor {
+	const uint8_t *p;	///< The next run to decode.
+	int symbol;			///< Symbol of the current run.
+	int remaining;		///< Symbols of the current run not returned yet.
+};
+/// Definition of the run cursor type ommiting the 'struct' keyword.
+/** @see s_hmmp_Rle_Cursor */
+typedef struct s_hmmp_Rle_Cursor hmmp_Rle_Cursor;
+
+/// Next symbol at the cursor 'c' ( a hmmp_Rle_Cursor, not a pointer ) and advance it.
+/** A run is decoded by hmmp_rle_advance() once, its other symbols cost one test.*/
+#define HMMP_RLE_NEXT( c ) ( (c).remaining-- > 0 ? (c).symbol : hmmp_rle_advance ( &(c) ) )
+
+/// Symbol 't' of the sequence 'seq' for loops reading the symbols in order.
+/** Works for all storage types like HMMP_SYMBOL(), a HMMP_SYMBOLS_RLE sequence is read
+*	with the cursor 'c', positioned on symbol 't' by hmmp_rle_seek() before the loop.*/
+#define HMMP_NEXT_SYMBOL( seq, t, c ) \
+	( (seq).sequence ? (seq).sequence[t] : \
+	  (seq).symbol_type == HMMP_SYMBOLS_RLE ? HMMP_RLE_NEXT ( c ) : HMMP_SYMBOL ( seq, t ) )
+
+/// An instance of this structure holds the expected counts of the Baum-Welch algorithm.
+/** The counts are accumulated over any number of sequences and can be merged between
+*	instances, so the expectation step can be split between threads, processes or machines.
+*	Check hmmp_bwstats.h for the functions operating on this structure.
+*	@see hmmp_Bw_Stats */
+struct s_hmmp_Bw_Stats {
+	dbl_matrix *a_num;		///< Nominators of the reestimated transition matrix ( N x N ).
+	dbl_matrix *b_num;		///< Nominators of the reestimated emission matrix ( N x M ).
+	dbl_array *a_denom;		///< Denominators of the reestimated transition matrix ( N ).
+	dbl_array *b_denom;		///< Denominators of the reestimated emission matrix ( N ).
+	dbl_array *pi_new;		///< Sums of the initial state probabilities ( N ).
+	double logP;			///< Sum of the logarithmic probabilities of the accumulated sequences.
+	int num_seq;			///< Number of accumulated sequences.
+	int num_states;			///< Number of states of the model.
+	int num_symbols;		///< Number of observable symbols of the model.
+};
+/// Definition of the expected counts type ommiting the 'struct' keyword.
+/** @see s_hmmp_Bw_Stats */
+typedef struct s_hmmp_Bw_Stats hmmp_Bw_Stats;
+
+/// An instance of this structure holds the time steps of a sequence grouped by symbol.
+/** The time steps at which symbol 'k' is observed are stored in ascending order in
+*	positions[offsets[k]] ... positions[offsets[k+1]-1]. The index depends only on the
+*	sequence, so it is built once and reused by all the steps of the learning.
+*	@see hmmp_Symbol_Index */
+struct s_hmmp_Symbol_Index {
+	int length;				///< Length of the indexed sequence.
+	int num_symbols;		///< Number of observable symbols.
+	int_array *offsets;		///< num_symbols+1 offsets of each symbol's time steps.
+	int_array *positions;	///< length time steps grouped by symbol.
+};
+/// Definition of the symbol index type ommiting the 'struct' keyword.
+/** @see s_hmmp_Symbol_Index */
+typedef struct s_hmmp_Symbol_Index hmmp_Symbol_Index;
+
+/// An instance of this structure holds a corpus of sequences in one arena.
+/** All symbols are stored back to back in one buffer, the symbols of sequence 'k' are
+*	symbols[offsets[k]] ... symbols[offsets[k+1]-1]. The array 'seq_arr' holds ordinary
+*	hmmp_Sequence views into the buffer, so the corpus can be passed to every function
+*	taking an array of sequences. The whole corpus is allocated and freed with a constant
+*	number of calls regardless of the number of sequences. In a corpus compressed with
+*	hmmp_corpus_compress() the offsets and 'total_length' count bytes of coded runs.
+*	Check hmmp_create_corpus() and hmmp_load_corpus() for creating a corpus.
+*	@see hmmp_Corpus */
+struct s_hmmp_Corpus {
+	int num_seq;			///< Number of sequences in the corpus.
+	int max_seq;			///< Number of sequences the corpus can hold without growing.
+	size_t total_length;	///< Number of symbols of all sequences.
+	size_t max_length;		///< Number of symbols the corpus can hold without growing.
+	int_array *symbols;		///< The symbols of all sequences, of type 'symbol_type'.
+	size_t *offsets;		///< num_seq+1 offsets of the sequences in 'symbols'.
+	hmmp_Sequence *seq_arr;	///< Views of the sequences.
+	int symbol_type;		///< Storage type of the symbols, see hmmp_Sequence::symbol_type.
+};
+/// Definition of the corpus type ommiting the 'struct' keyword.
+/** @see s_hmmp_Corpus */
+typedef struct s_hmmp_Corpus hmmp_Corpus;
+
+/// An instance of this structure holds the buffers of one thread of the inference functions.
+/** A thread claims a free workspace for the duration of a call of hmmp_decode(),
+*	hmmp_evaluate_models() or hmmp_evaluate_sequences() and returns it afterwards, so the
+*	workspaces only grow and are reused by all later calls.
+*	Check hmmp_workspace.h for the functions operating on this structure.
+*	@see hmmp_Workspace */
+struct s_hmmp_Workspace {
+	int max_states;			///< Largest number of states the buffers are sized for.
+	int max_length;			///< Largest sequence length the buffers are sized for.
+	dbl_matrix *alfa;		///< Forward variables, N x T.
+	dbl_array *scales;		///< Forward scaling factors, T.
+	int_matrix *backtrack;	///< Viterbi backtracking, N x T.
+	dbl_matrix *mu;			///< Viterbi or rolling forward probabilities, 2 x N.
+	int node;				///< NUMA node of the thread which allocated the buffers.
+	int in_use;				///< Claimed by a caller until hmmp_workspace_release().
+	struct s_hmmp_Workspace *next;	///< Next workspace in the pool.
+};
+/// Definition of the workspace type ommiting the 'struct' keyword.
+/** @see s_hmmp_Workspace */
+typedef struct s_hmmp_Workspace hmmp_Workspace;
+
+/// An instance of this structure holds read-only copies of a model, one per NUMA node.
+/** The copy of a node is created by the first thread running on the node, so its memory
+*	is placed on that node. Without replication all threads read the source model.
+*	Check hmmp_numa.h for the functions operating on this structure.
+*	@see hmmp_Model_Replicas */
+struct s_hmmp_Model_Replicas {
+	int num_nodes;			///< Number of NUMA nodes, 0 when replication is off.
+	hmmp_Model *source;		///< The replicated model.
+	hmmp_Model **replica;	///< Copy of the model on each node, created on first use.
+};
+/// Definition of the model replicas type ommiting the 'struct' keyword.
+/** @see s_hmmp_Model_Replicas */
+typedef struct s_hmmp_Model_Replicas hmmp_Model_Replicas;
+
+/// An instance of this structure holds models whose parameters are read from a mapped file.
+/** The parameters of each model point directly into the file mapping, nothing is parsed or
+*	copied when the file is opened. The mapping is private: a model can be modified in
+*	memory ( e.g. trained ), the file is never changed. On platforms without mmap the file
+*	is read into one buffer instead.
+*	Check hmmp_map_models() and hmmp_unmap_models() in hmmp_file.h.
+*	@see hmmp_Model_Map */
+struct s_hmmp_Model_Map {
+	int num_models;			///< Number of models in the file.
+	hmmp_Model *models;		///< The models, their parameters point into 'base'.
+	void *base;				///< Start of the mapped file.
+	size_t size;			///< Size of the mapped file in bytes.
+	int mapped;				///< 1 if 'base' is a file mapping, 0 if it is a read buffer.
+};
+/// Definition of the model map type ommiting the 'struct' keyword.
+/** @see s_hmmp_Model_Map */
+typedef struct s_hmmp_Model_Map hmmp_Model_Map;
+
+/// An instance of this structure holds a corpus of sequences read from a mapped binary file.
+/** The symbols are stored with the smallest width allowed by the cardinality: 1, 2 or 4
+*	bits packed in bytes, or 8, 16 or 32 bit integers. The symbols of sequence 'k' are
+*	the symbols offsets[k] ... offsets[k+1]-1 of the packed array 'symbols'. With 'bits' 0
+*	the symbols are runs of hmmp_rle_encode() and the offsets count bytes. All arrays
+*	point directly into the file mapping, nothing is parsed when the file is opened.
+*	Use hmmp_packed_symbol() and hmmp_packed_unpack() to read the symbols.
+*	Check hmmp_map_corpus() and hmmp_save_corpus_binary() in hmmp_file.h.
+*	@see hmmp_Packed_Corpus */
+struct s_hmmp_Packed_Corpus {
+	int num_seq;			///< Number of sequences.
+	int bits;				///< Bits per symbol: 1, 2, 4, 8, 16 or 32, 0 for runs.
+	uint64_t total_length;	///< Number of symbols of all sequences.
+	int32_t *seq_ids;		///< ID of each sequence.
+	int32_t *lengths;		///< Length of each sequence.
+	int32_t *cardinalities;	///< Cardinality of each sequence.
+	uint64_t *offsets;		///< num_seq+1 offsets of the sequences in 'symbols'.
+	unsigned char *symbols;	///< The packed symbols of all sequences.
+	void *base;				///< Start of the mapped file.
+	size_t size;			///< Size of the mapped file in bytes.
+	int mapped;				///< 1 if 'base' is a file mapping, 0 if it is a read buffer.
+};
+/// Definition of the packed corpus type ommiting the 'struct' keyword.
+/** @see s_hmmp_Packed_Corpus */
+typedef struct s_hmmp_Packed_Corpus hmmp_Packed_Corpus;
+
+/// An instance of this structure reads or writes the sequences of a file a chunk at a time.
+/** Both the text format and the packed binary format are read. Only the sequences of
+*	the current chunk are held in memory, so files larger than the memory can be processed.
+*	A stream can also write a text file a chunk at a time, then 'next' counts the written
+*	sequences. Check hmmp_open_sequence_stream() and hmmp_create_sequence_stream() in
+*	hmmp_file.h.
+*	@see hmmp_Sequence_Stream */
+struct s_hmmp_Sequence_Stream {
+	void *file;					///< The open text file ( FILE* ), 0 for a packed file.
+	hmmp_Packed_Corpus *packed;	///< The mapped packed file, 0 for a text file.
+	int num_seq;				///< Number of sequences in the file.
+	int next;					///< Index of the next sequence to read.
+	int pending;				///< 1 if the header of the next text sequence is already read.
+	int pending_id;				///< seq_id of the pending sequence.
+	int pending_length;			///< Length of the pending sequence.
+	int pending_cardinality;	///< Cardinality of the pending sequence.
+	int writing;				///< 1 for a stream of hmmp_create_sequence_stream().
+};
+/// Definition of the sequence stream type ommiting the 'struct' keyword.
+/** @see s_hmmp_Sequence_Stream */
+typedef struct s_hmmp_Sequence_Stream hmmp_Sequence_Stream;
+
+/// An instance of this structure holds the execution plan chosen for a memory budget.
+/** Check hmmp_plan.h for the planner and the possible tasks and variants.
+*	@see hmmp_Plan */
+struct s_hmmp_Plan {
+	int task;				///< The planned entry point, one of HMMP_TASK_*.
+	int variant;			///< The algorithm variant, one of HMMP_VARIANT_*.
+	int interval;			///< Time steps between checkpoints, 0 unless checkpointed.
+	int num_threads;		///< Number of threads to run with.
+	int batch_size;			///< Number of sequences handed to each thread at once.
+	size_t peak_bytes;		///< Predicted peak of the working memory in bytes.
+};
+/// Definition of the plan type ommiting the 'struct' keyword.
+/** @see s_hmmp_Plan */
+typedef struct s_hmmp_Plan hmmp_Plan;
+
 #undef HMMP_DBL_MAX
 /** Maximum representable double value used in logarithmic calculations.\n
 *	Default value: HMMP_DBL_MAX = 1.7976931348623157e+308 defined in **hmmp_dataproc.c**
@@ -118,8 +380,11 @@ enum _hmmp_lib_error{
 	E_ARGUMENT	= -8,	///< One or more of the call argument values are not expected!
 	E_MEM_OVERFLOW_L1 = -9, ///< Cannot initialize: alfa, beta, gamma, xi variables.
 							///< Number of states and/or sequence lenght will cause overflow.
-	E_MEM_OVERFLOW_L2 = -10 ///< Cannot initialize: xi variables.
+	E_MEM_OVERFLOW_L2 = -10,///< Cannot initialize: xi variables.
 							///< Number of states and/or sequence lenght will cause overflow.
+	E_FILE_WRITE = -11,		///< Error writing file!
+	E_UNSUPPORTED = -12,	///< Not supported on this platform!
+	E_MEM_BUDGET = -13		///< No variant of the algorithm fits in the memory budget!
 };
 /// Definition of error type ommiting the 'enum' keyword.
 /** @see _hmmp_lib_error */
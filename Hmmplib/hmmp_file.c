@@ -1,3 +1,7 @@
+#ifdef __linux__
+#define _POSIX_C_SOURCE 200112L	// fseeko(), ftello(), flockfile() and getc_unlocked()
+#define _FILE_OFFSET_BITS 64	// 64 bit off_t for files above 2 GB
+#endif
 /*  This file is part of Hmmplib.
 *	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
 *   Copyright (C) 2017  Iskren Tarkalanov
@@ -19,276 +23,1947 @@
 */
 #include "hmmp_file.h"
 #include "hmmp_datatypes.h"
+#include "hmmp_memop.h"
+#include "hmmp_dataproc.h"
+#include "hmmp_bwstats.h"
+#include "hmmp_numconv.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <malloc.h>
+#include <stdint.h>
+#include <limits.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define HMMP_CKPT_MAGIC		0x54504B43u	// "CKPT"
+#define HMMP_CKPT_VERSION	1u
+#define HMMP_MODELS_MAGIC	0x424D4D48u	// "HMMB"
+#define HMMP_MODELS_VERSION	1u
+#define HMMP_SEQS_MAGIC		0x534D4D48u	// "HMMS"
+#define HMMP_SEQS_VERSION	1u
+#define HMMP_INDEX_MAGIC	0x494D4D48u	// "HMMI"
+#define HMMP_INDEX_VERSION	1u
+#define HMMP_RESULTS_MAGIC	0x524D4D48u	// "HMMR"
+#define HMMP_RESULTS_VERSION	1u
+
+// bytes read at a time when scanning a text sequence file for its records
+#define HMMP_SCAN_BLOCK		( 1 << 20 )
+// longest header of a sequence record kept in one piece while scanning
+#define HMMP_SCAN_HEADER	256
+
+/* Binary model file: header, table of models, then the parameters of each model. Every
+*  part starts at a multiple of HMMP_ALIGNMENT bytes from the start of the file. */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	int32_t num_models;
+	int32_t reserved;
+	uint64_t file_size;
+	uint64_t table_offset;
+	uint64_t padding[4];
+} hmmp_Models_Header;
+
+/* One model in the table. The initial, transition and emission parameters follow each
+*  other at 'offset', each padded to HMMP_ALIGNMENT bytes. */
+typedef struct {
+	int32_t model_id;
+	int32_t num_states;
+	int32_t num_symbols;
+	int32_t reserved;
+	double prior;
+	uint64_t offset;
+} hmmp_Models_Entry;
+
+/* Packed sequence file: header, the columns seq_id, length and cardinality ( num_seq int32
+*  each ) and offsets ( num_seq+1 uint64 ), then the packed symbols at 'data_offset'.
+*  Every part starts at a multiple of HMMP_ALIGNMENT bytes. */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	int32_t num_seq;
+	int32_t bits;
+	uint64_t file_size;
+	uint64_t total_length;
+	uint64_t data_offset;
+	uint64_t padding[3];
+} hmmp_Seqs_Header;
+
+/* Sequence index file: header, then one entry per sequence sorted by seq_id and by the
+*  position in the sequence file. 'file_size' is the size of the indexed file. */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	int32_t num_seq;
+	int32_t binary;
+	uint64_t file_size;
+	uint64_t reserved;
+} hmmp_Index_Header;
+
+/* One sequence of the index. In text files 'offset' and 'bytes' locate the record, starting
+*  at its "seq_id:". In packed files 'number' is used, they locate the packed symbols. */
+typedef struct {
+	int32_t seq_id;
+	int32_t number;
+	int32_t length;
+	int32_t cardinality;
+	uint64_t offset;
+	uint64_t bytes;
+} hmmp_Index_Entry;
+
+/* Results file: header, then one batch per call of hmmp_append_results(). */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t padding[7];
+} hmmp_Results_Header;
+
+/* A batch of a results file: this header, the columns seq_id, length and cardinality
+*  ( num_seq int32 each ), logP ( num_seq doubles ) and offsets ( num_seq+1 uint64, bytes
+*  into the states ), then the states. Every part starts at a multiple of HMMP_ALIGNMENT
+*  bytes from the start of the batch and 'batch_bytes' is a multiple of it as well. The
+*  states take 'width' bytes each, a run of the RLE content is a state followed by the
+*  number of its repetitions as uint32. */
+typedef struct {
+	int32_t num_seq;
+	int32_t content;
+	int32_t width;
+	int32_t reserved;
+	uint64_t batch_bytes;
+	uint64_t states_bytes;
+	uint64_t padding[4];
+} hmmp_Results_Batch;
+
+/* 'bytes' rounded up to a multiple of HMMP_ALIGNMENT. */
+static uint64_t hmmp_bin_align ( uint64_t bytes )
+{
+	return ( bytes + HMMP_ALIGNMENT - 1 ) / HMMP_ALIGNMENT * HMMP_ALIGNMENT;
+}
+
+/* Offset of the packed symbols of a sequence file with 'num_seq' sequences. */
+static uint64_t hmmp_bin_seqs_data_offset ( uint64_t num_seq )
+{
+	return sizeof ( hmmp_Seqs_Header ) + 3 * hmmp_bin_align ( num_seq * sizeof ( int32_t ) ) +
+		   hmmp_bin_align ( ( num_seq + 1 ) * sizeof ( uint64_t ) );
+}
+
+/* Smallest symbol width in bits for 'num_symbols' different symbols. */
+static int hmmp_bin_symbol_bits ( uint64_t num_symbols )
+{
+	if ( num_symbols <= 2 ) return 1;
+	if ( num_symbols <= 4 ) return 2;
+	if ( num_symbols <= 16 ) return 4;
+	if ( num_symbols <= 256 ) return 8;
+	if ( num_symbols <= 65536 ) return 16;
+	return 32;
+}
+
+/* Number of doubles of an array of 'count' doubles padded to HMMP_ALIGNMENT bytes. */
+static uint64_t hmmp_bin_padded ( uint64_t count )
+{
+	const uint64_t per_line = HMMP_ALIGNMENT / sizeof ( double );
+	return ( count + per_line - 1 ) / per_line * per_line;
+}
+
+/* Number of doubles of the padded parameters of a model. */
+static uint64_t hmmp_bin_model_doubles ( uint64_t num_states, uint64_t num_symbols )
+{
+	return hmmp_bin_padded ( num_states ) + hmmp_bin_padded ( num_states * num_states ) +
+		   hmmp_bin_padded ( num_states * num_symbols );
+}
+
+/* Map a whole file in memory. The mapping is private and writable, the pages are copied
+*  on the first write and the file never changes. Without mmap the file is read into an
+*  aligned buffer. */
+static int hmmp_file_map ( char *filename, void **o_base, size_t *o_size, int *o_mapped )
+{
+#ifdef __linux__
+	struct stat st;
+	void *base;
+	int fd;
+	if ( (fd = open ( filename, O_RDONLY )) < 0 )
+		return E_FILE_OPEN;
+	if ( fstat ( fd, &st ) || st.st_size < 0 ){
+		close ( fd );
+		return E_FILE_READ;
+	}
+	if ( st.st_size == 0 ){
+		close ( fd );
+		return E_FILE_FORMAT;
+	}
+	base = mmap ( 0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	close ( fd );
+	if ( base == MAP_FAILED )
+		return E_FILE_READ;
+	*o_base = base;
+	*o_size = st.st_size;
+	*o_mapped = 1;
+	return E_SUCCESS;
+#else
+	FILE *file;
+	void *base;
+	long size;
+	if(!(file = fopen ( filename , "rb" )))
+		return E_FILE_OPEN;
+	if ( fseek ( file, 0, SEEK_END ) || (size = ftell ( file )) < 0 || fseek ( file, 0, SEEK_SET ) ){
+		fclose ( file );
+		return E_FILE_READ;
+	}
+	if ( size == 0 ){
+		fclose ( file );
+		return E_FILE_FORMAT;
+	}
+	if ( !(base = hmmp_aligned_alloc ( size )) ){
+		fclose ( file );
+		return E_ALLOCATION;
+	}
+	if ( fread ( base, 1, size, file ) != (size_t) size ){
+		fclose ( file );
+		hmmp_aligned_free ( base );
+		return E_FILE_READ;
+	}
+	fclose ( file );
+	*o_base = base;
+	*o_size = size;
+	*o_mapped = 0;
+	return E_SUCCESS;
+#endif
+}
+
+static void hmmp_file_unmap ( void *base, size_t size, int mapped )
+{
+#ifdef __linux__
+	if ( mapped ){
+		munmap ( base, size );
+		return;
+	}
+#endif
+	hmmp_aligned_free ( base );
+}
+
+// doubles formatted by one thread into one buffer when writing arrays of doubles
+#define HMMP_FORMAT_BLOCK 4096
+
+/* Format data[begin, end) each followed by a blank, and by a new line after every
+*  'per_line' values counted from the start of the array ( none if 0 ). */
+static size_t hmmp_format_doubles ( char *buffer, const double *data, size_t begin,
+									size_t end, size_t per_line )
+{
+	char *p = buffer;
+	size_t i;
+	for ( i = begin ; i < end ; ++i ){
+		p += hmmp_format_double ( p, data[i] );
+		*p++ = ' ';
+		if ( per_line && !( ( i + 1 ) % per_line ) )
+			*p++ = '\n';
+	}
+	return p - buffer;
+}
+
+/* Write an array of doubles as hmmp_format_doubles() does. Each block of values is
+*  formatted into a buffer written with one fwrite(), the blocks of large arrays are
+*  formatted in parallel and written in order. */
+static int hmmp_write_doubles ( FILE *file, const double *data, size_t count, size_t per_line )
+{
+	size_t num_blocks = ( count + HMMP_FORMAT_BLOCK - 1 ) / HMMP_FORMAT_BLOCK;
+	size_t block_chars = ( count < HMMP_FORMAT_BLOCK ? count : HMMP_FORMAT_BLOCK ) *
+						 ( HMMP_DOUBLE_CHARS + 2 );
+	size_t b, *lengths;
+	char *buffers;
+	int j, num_buffers = HMMP_NUM_THREADS, n;
+	int ret = E_SUCCESS;
+
+	if ( !count )
+		return E_SUCCESS;
+	if ( num_buffers < 1 || num_blocks < 2 )
+		num_buffers = 1;
+	if ( (size_t) num_buffers > num_blocks )
+		num_buffers = (int) num_blocks;
+	buffers = (char*) malloc ( num_buffers * block_chars );
+	lengths = (size_t*) malloc ( num_buffers * sizeof ( size_t ) );
+	if ( !buffers || !lengths ){
+		if ( buffers ) free ( buffers );
+		if ( lengths ) free ( lengths );
+		return E_ALLOCATION;
+	}
+	for ( b = 0 ; b < num_blocks && ret == E_SUCCESS ; b += n ){
+		n = num_blocks - b < (size_t) num_buffers ? (int) ( num_blocks - b ) : num_buffers;
+#pragma omp parallel for num_threads(n) if(n > 1)
+		for ( j = 0 ; j < n ; ++j ){
+			size_t begin = ( b + j ) * HMMP_FORMAT_BLOCK;
+			size_t end = begin + HMMP_FORMAT_BLOCK < count ? begin + HMMP_FORMAT_BLOCK : count;
+			lengths[j] = hmmp_format_doubles ( buffers + j * block_chars, data, begin, end,
+											   per_line );
+		}
+		for ( j = 0 ; j < n ; ++j )
+			if ( fwrite ( buffers + j * block_chars, 1, lengths[j], file ) != lengths[j] ){
+				ret = E_FILE_WRITE;
+				break;
+			}
+	}
+	free ( buffers );
+	free ( lengths );
+	return ret;
+}
+
 int hmmp_save_models ( char *filename, hmmp_Model *arr_models, int num_models )
 {
 	FILE *file;
-	int i, j, n_times_n, n_times_m;
-	char flag_broken = 0;
+	int i;
+	char prior[HMMP_DOUBLE_CHARS];
+	int ret = E_SUCCESS;
 	if ( !arr_models || !filename )
 		return E_PARAMETER;
 	if(!(file = fopen ( filename , "w" )))
 		return E_FILE_OPEN;
-	fprintf( file, "num_models: %d\n\n", num_models);
-	for ( i = 0 ; i < num_models ; ++i ){
-		fprintf( file, "model_id: %d\nnum_states: %d\nnum_symbols: %d\nprior: %.*E\n",
-				arr_models[i].model_id,		arr_models[i].num_states, 
-				arr_models[i].num_symbols, 17,arr_models[i].prior );
-		fprintf( file, "initial: ");
-		for ( j = 0 ; j < arr_models[i].num_states ; ++j )
-			fprintf(file, "%.*E ", 17, arr_models[i].initial[j] );
-
-		fprintf( file, "\ntransition: ");
-		n_times_n = arr_models[i].num_states * arr_models[i].num_states; 
-		for ( j = 0 ; j < n_times_n ; ++j )
-			fprintf(file, "%.17E ", arr_models[i].transition[j] );
-
-		fprintf( file, "\nemission: ");
-		n_times_m = arr_models[i].num_states * arr_models[i].num_symbols;
-		for ( j = 0 ; j < n_times_m ; ++j )
-			fprintf(file, "%.*E ", 17, arr_models[i].emission[j] );
-		fprintf(file, "\n\n");
-	}
-	fclose(file);
-	return E_SUCCESS;
+	if ( fprintf( file, "num_models: %d\n\n", num_models) < 0 )
+		ret = E_FILE_WRITE;
+	for ( i = 0 ; i < num_models && ret == E_SUCCESS ; ++i ){
+		hmmp_format_double ( prior, arr_models[i].prior );
+		if ( fprintf( file, "model_id: %d\nnum_states: %d\nnum_symbols: %d\nprior: %s\n",
+					  arr_models[i].model_id,		arr_models[i].num_states,
+					  arr_models[i].num_symbols, prior ) < 0 ||
+			 fprintf( file, "initial: ") < 0 ||
+			 (ret = hmmp_write_doubles ( file, arr_models[i].initial,
+										 arr_models[i].num_states, 0 )) ||
+			 fprintf( file, "\ntransition: ") < 0 ||
+			 (ret = hmmp_write_doubles ( file, arr_models[i].transition,
+										 (size_t)arr_models[i].num_states * arr_models[i].num_states, 0 )) ||
+			 fprintf( file, "\nemission: ") < 0 ||
+			 (ret = hmmp_write_doubles ( file, arr_models[i].emission,
+										 (size_t)arr_models[i].num_states * arr_models[i].num_symbols, 0 )) ||
+			 fprintf(file, "\n\n") < 0 )
+			if ( ret == E_SUCCESS )
+				ret = E_FILE_WRITE;
+	}
+	if ( fclose(file) && ret == E_SUCCESS )
+		ret = E_FILE_WRITE;
+	return ret;
 }
 
-int hmmp_load_models ( hmmp_Model **arr_models, char *filename, int max_num  )
+int hmmp_save_models_binary ( char *filename, hmmp_Model *arr_models, int num_models )
 {
+	static const double zeros[HMMP_ALIGNMENT / sizeof ( double )];
 	FILE *file;
-	hmmp_Model *p_models;
-	int i, j, num_models, model_id, num_states, num_symbols, n_times_n, n_times_m;
-	double prior;
-	char flag_broken = 0;
-
+	hmmp_Models_Header header;
+	hmmp_Models_Entry *table;
+	dbl_array *params[3];
+	uint64_t offset, sizes[3], pad;
+	size_t table_size;
+	int i, j;
+	int ret = E_SUCCESS;
 	if ( !arr_models || !filename )
 		return E_PARAMETER;
-	if(!(file = fopen ( filename , "r" )))
-		return E_FILE_OPEN;
-
-	if ( fscanf(file,"num_models: %d\n", &num_models ) != 1 )
-		return E_FILE_READ;
-
-	if ( max_num && max_num < num_models )
-		num_models = max_num;
-	p_models = ( hmmp_Model *)malloc(num_models * sizeof ( hmmp_Model ));
-	if ( !p_models )
+	if ( num_models < 1 )
+		return E_ARGUMENT;
+	table_size = hmmp_bin_padded ( (uint64_t) num_models * sizeof ( hmmp_Models_Entry ) /
+								   sizeof ( double ) ) * sizeof ( double );
+	if ( !(table = (hmmp_Models_Entry*) calloc ( 1, table_size )) )
 		return E_ALLOCATION;
-
+	offset = sizeof ( hmmp_Models_Header ) + table_size;
 	for ( i = 0 ; i < num_models ; ++i ){
-		if ( fscanf(file,"model_id:%d\nnum_states:%d\nnum_symbols:%d\nprior:%lf\n", 
-			&model_id, &num_states, &num_symbols, &prior ) != 4 ){
-			flag_broken = 1;
-			break;
-		}
-		p_models[i].initial = (dbl_matrix *)malloc( sizeof(double)*num_states );
-		if ( !p_models[i].initial ){
-			flag_broken = 2;
-			break;
-		}
-		p_models[i].transition = (dbl_matrix *)malloc( sizeof(double)*num_states*num_states );
-		if ( !p_models[i].transition ){
-			free(p_models[i].initial);
-			flag_broken = 2;
-			break;
-		}
-		p_models[i].emission = (dbl_matrix *)malloc( sizeof(double)*num_states*num_symbols );
-		if ( !p_models[i].emission ){
-			free(p_models[i].initial);
-			free(p_models[i].transition);
-			flag_broken = 2;
-			break;
-		}		
-		p_models[i].model_id = model_id;
-		p_models[i].num_states = num_states;
-		p_models[i].num_symbols = num_symbols;
-		p_models[i].prior = prior;
-
-		if ( fscanf(file,"initial:") == EOF ){
-			flag_broken = -1;
-			break;
-		}
-		if ( flag_broken == -1 )
-			break;
-		for ( j = 0 ; j < num_states ; ++j ){
-			if (fscanf(file, "%lf", &p_models[i].initial[j] ) != 1 ){
-				flag_broken = -1;
-				break;
-			}
-		}
-		if ( flag_broken == -1 )
-			break;
-		if ( fscanf(file,"\ntransition:") == EOF ){
-			flag_broken = -1;
-			break;
-		}
-		n_times_n = num_states * num_states;
-		for ( j = 0 ; j < n_times_n ; ++j ){
-			if (fscanf(file, "%lf", &p_models[i].transition[j] ) != 1 ){
-				flag_broken = -1;
+		table[i].model_id = arr_models[i].model_id;
+		table[i].num_states = arr_models[i].num_states;
+		table[i].num_symbols = arr_models[i].num_symbols;
+		table[i].prior = arr_models[i].prior;
+		table[i].offset = offset;
+		offset += hmmp_bin_model_doubles ( arr_models[i].num_states,
+										   arr_models[i].num_symbols ) * sizeof ( double );
+	}
+	memset ( &header, 0, sizeof ( header ) );
+	header.magic = HMMP_MODELS_MAGIC;
+	header.version = HMMP_MODELS_VERSION;
+	header.num_models = num_models;
+	header.file_size = offset;
+	header.table_offset = sizeof ( hmmp_Models_Header );
+	if(!(file = fopen ( filename , "wb" ))){
+		free ( table );
+		return E_FILE_OPEN;
+	}
+	if ( fwrite ( &header, sizeof ( header ), 1, file ) != 1 ||
+		 fwrite ( table, table_size, 1, file ) != 1 )
+		ret = E_FILE_WRITE;
+	for ( i = 0 ; i < num_models && ret == E_SUCCESS ; ++i ){
+		params[0] = arr_models[i].initial;
+		params[1] = arr_models[i].transition;
+		params[2] = arr_models[i].emission;
+		sizes[0] = arr_models[i].num_states;
+		sizes[1] = (uint64_t) arr_models[i].num_states * arr_models[i].num_states;
+		sizes[2] = (uint64_t) arr_models[i].num_states * arr_models[i].num_symbols;
+		for ( j = 0 ; j < 3 ; ++j ){
+			pad = hmmp_bin_padded ( sizes[j] ) - sizes[j];
+			if ( fwrite ( params[j], sizeof ( double ), sizes[j], file ) != sizes[j] ||
+				 fwrite ( zeros, sizeof ( double ), pad, file ) != pad ){
+				ret = E_FILE_WRITE;
 				break;
 			}
 		}
-		if ( flag_broken == -1 )
-			break;
-		if ( fscanf(file,"\nemission:") == EOF ){
-			flag_broken = -1;
+	}
+	if ( fclose ( file ) )
+		ret = E_FILE_WRITE;
+	free ( table );
+	return ret;
+}
+
+int hmmp_map_models ( hmmp_Model_Map **o_map, char *filename )
+{
+	hmmp_Model_Map *map;
+	hmmp_Models_Header *header;
+	hmmp_Models_Entry *table;
+	hmmp_Model *m;
+	uint64_t doubles;
+	int i, ret;
+
+	if ( !o_map || !filename )
+		return E_PARAMETER;
+	*o_map = 0;
+	if ( !(map = (hmmp_Model_Map*) calloc ( 1, sizeof ( hmmp_Model_Map ) )) )
+		return E_ALLOCATION;
+	if ( ( ret = hmmp_file_map ( filename, &map->base, &map->size, &map->mapped ) ) ){
+		free ( map );
+		return ret;
+	}
+	header = (hmmp_Models_Header*) map->base;
+	ret = E_SUCCESS;
+	if ( map->size < sizeof ( hmmp_Models_Header ) || header->magic != HMMP_MODELS_MAGIC ||
+		 header->version != HMMP_MODELS_VERSION || header->num_models < 1 ||
+		 header->file_size != map->size || header->table_offset % HMMP_ALIGNMENT ||
+		 header->table_offset > map->size || ( map->size - header->table_offset ) /
+						sizeof ( hmmp_Models_Entry ) < (uint64_t) header->num_models )
+		ret = E_FILE_FORMAT;
+	else if ( !(map->models = (hmmp_Model*) calloc ( header->num_models, sizeof ( hmmp_Model ) )) )
+		ret = E_ALLOCATION;
+	if ( ret ){
+		hmmp_unmap_models ( map );
+		return ret;
+	}
+	table = (hmmp_Models_Entry*) ( (char*) map->base + header->table_offset );
+	for ( i = 0 ; i < header->num_models ; ++i ){
+		if ( table[i].num_states < 1 || table[i].num_symbols < 1 ||
+			 table[i].offset % HMMP_ALIGNMENT || table[i].offset > map->size ){
+			ret = E_FILE_FORMAT;
 			break;
 		}
-		n_times_m = num_symbols * num_states;
-		for ( j = 0 ; j < n_times_m ; ++j ){
-			if (fscanf(file, "%lf", &p_models[i].emission[j] ) != 1 ){
-				flag_broken = -1;
-				break;
-			}
-		}
-		if ( flag_broken == -1 )
-			break;
-		if ( fscanf(file,"\n\n") == EOF ){
-			flag_broken = -1;
+		doubles = hmmp_bin_model_doubles ( table[i].num_states, table[i].num_symbols );
+		if ( ( map->size - table[i].offset ) / sizeof ( double ) < doubles ){
+			ret = E_FILE_FORMAT;
 			break;
 		}
+		m = map->models + i;
+		m->model_id = table[i].model_id;
+		m->num_states = table[i].num_states;
+		m->num_symbols = table[i].num_symbols;
+		m->prior = table[i].prior;
+		m->initial = (dbl_array*) ( (char*) map->base + table[i].offset );
+		m->transition = m->initial + hmmp_bin_padded ( m->num_states );
+		m->emission = m->transition + hmmp_bin_padded ( (uint64_t) m->num_states * m->num_states );
 	}
-	fclose(file);
-	if ( flag_broken == 1 || flag_broken == 2 || flag_broken == -1){
-		num_models = i;
-		if ( flag_broken == -1 )
-			++num_models;
+	if ( ret ){
+		hmmp_unmap_models ( map );
+		return ret;
+	}
+	map->num_models = header->num_models;
+	*o_map = map;
+	return map->num_models;
+}
+
+int hmmp_unmap_models ( hmmp_Model_Map *map )
+{
+	if ( !map )
+		return E_PARAMETER;
+	if ( map->models ) free ( map->models );
+	if ( map->base ) hmmp_file_unmap ( map->base, map->size, map->mapped );
+	free ( map );
+	return E_SUCCESS;
+}
+
+/* hmmp_load_models() of a binary file: the models are copied out of the mapping. */
+static int hmmp_load_models_binary ( hmmp_Model **arr_models, char *filename, int max_num )
+{
+	hmmp_Model_Map *map;
+	hmmp_Model *p_models = 0;
+	int_array *dims;
+	int i, num_models;
+
+	num_models = hmmp_map_models ( &map, filename );
+	if ( num_models < 0 )
+		return num_models;
+	if ( max_num && max_num < num_models )
+		num_models = max_num;
+	dims = hmmp_create_int_array ( 2*num_models );
+	if ( dims ){
 		for ( i = 0 ; i < num_models ; ++i ){
-			free ( p_models[i].initial );
-			free ( p_models[i].transition );
-			free ( p_models[i].emission );
-			p_models[i].model_id = -1;
+			dims[i] = map->models[i].num_states;
+			dims[num_models+i] = map->models[i].num_symbols;
 		}
-		free ( p_models );
-		if ( flag_broken == 2 )
-			return E_ALLOCATION;
+		p_models = hmmp_create_arr_models_dims ( num_models, dims, dims+num_models );
+		hmmp_delete_int_array ( dims );
+	}
+	if ( p_models )
+		for ( i = 0 ; i < num_models ; ++i )
+			hmmp_model_copy ( p_models+i, map->models+i );
+	hmmp_unmap_models ( map );
+	if ( !p_models )
+		return E_ALLOCATION;
+	*arr_models = p_models;
+	return num_models;
+}
+
+/* Skip whitespace and match 'literal', as a blank followed by the literal in a fscanf()
+*  format. */
+static int hmmp_text_expect ( const char **io_p, const char *end, const char *literal )
+{
+	const char *p = *io_p;
+	size_t len = strlen ( literal );
+	while ( p < end && ( *p == ' ' || *p == '\n' || *p == '\t' || *p == '\r' ||
+						 *p == '\v' || *p == '\f' ) )
+		++p;
+	if ( (size_t) ( end - p ) < len || memcmp ( p, literal, len ) )
+		return E_FILE_FORMAT;
+	*io_p = p + len;
+	return E_SUCCESS;
+}
+
+/* First occurrence of 'key' in the text, 'end' if there is none. */
+static const char *hmmp_text_find ( const char *p, const char *end, const char *key )
+{
+	size_t len = strlen ( key );
+	while ( p < end && (p = (const char*) memchr ( p, key[0], end - p )) ){
+		if ( (size_t) ( end - p ) < len )
+			break;
+		if ( !memcmp ( p, key, len ) )
+			return p;
+		++p;
+	}
+	return end;
+}
+
+/* Parse the text record of one model into a model of the right dimensions. */
+static int hmmp_parse_model_record ( const char *p, const char *end, hmmp_Model *m )
+{
+	size_t j, n_times_n, n_times_m;
+	int num_states, num_symbols;
+	if ( hmmp_text_expect ( &p, end, "model_id:" ) || hmmp_parse_int ( &p, end, &m->model_id ) ||
+		 hmmp_text_expect ( &p, end, "num_states:" ) || hmmp_parse_int ( &p, end, &num_states ) ||
+		 hmmp_text_expect ( &p, end, "num_symbols:" ) || hmmp_parse_int ( &p, end, &num_symbols ) ||
+		 hmmp_text_expect ( &p, end, "prior:" ) || hmmp_parse_double ( &p, end, &m->prior ) ||
+		 hmmp_text_expect ( &p, end, "initial:" ) ||
+		 num_states != m->num_states || num_symbols != m->num_symbols )
+		return E_FILE_FORMAT;
+	for ( j = 0 ; j < (size_t)num_states ; ++j )
+		if ( hmmp_parse_double ( &p, end, m->initial + j ) )
+			return E_FILE_FORMAT;
+	if ( hmmp_text_expect ( &p, end, "transition:" ) )
+		return E_FILE_FORMAT;
+	n_times_n = (size_t)num_states * num_states;
+	for ( j = 0 ; j < n_times_n ; ++j )
+		if ( hmmp_parse_double ( &p, end, m->transition + j ) )
+			return E_FILE_FORMAT;
+	if ( hmmp_text_expect ( &p, end, "emission:" ) )
 		return E_FILE_FORMAT;
+	n_times_m = (size_t)num_symbols * num_states;
+	for ( j = 0 ; j < n_times_m ; ++j )
+		if ( hmmp_parse_double ( &p, end, m->emission + j ) )
+			return E_FILE_FORMAT;
+	return E_SUCCESS;
+}
+
+/* hmmp_load_models() of a text file. The file is mapped, the records of the models are
+*  found at their "model_id:" headers and the dimensions are read, then the records are
+*  parsed in parallel directly into the resulting array. */
+static int hmmp_load_models_text ( hmmp_Model **arr_models, char *filename, int max_num )
+{
+	hmmp_Model *p_models = 0;
+	const char *p, *end, **records;
+	void *base;
+	size_t size;
+	int_array *dims;
+	int i, num_models, model_id, mapped, ret;
+	char flag_broken = 0;
+
+	if ( ( ret = hmmp_file_map ( filename, &base, &size, &mapped ) ) )
+		return ret == E_FILE_FORMAT ? E_FILE_READ : ret;
+	p = (const char*) base;
+	end = p + size;
+	if ( hmmp_text_expect ( &p, end, "num_models:" ) || hmmp_parse_int ( &p, end, &num_models ) ){
+		hmmp_file_unmap ( base, size, mapped );
+		return E_FILE_READ;
 	}
+	if ( max_num && max_num < num_models )
+		num_models = max_num;
+	if ( num_models < 1 ){
+		hmmp_file_unmap ( base, size, mapped );
+		return E_FILE_FORMAT;
+	}
+	records = (const char**) malloc ( num_models * sizeof ( char* ) );
+	dims = hmmp_create_int_array ( 2*num_models );
+	if ( !records || !dims )
+		flag_broken = 2;
+	for ( i = 0 ; i < num_models && !flag_broken ; ++i ){
+		p = records[i] = hmmp_text_find ( p, end, "model_id:" );
+		if ( hmmp_text_expect ( &p, end, "model_id:" ) || hmmp_parse_int ( &p, end, &model_id ) ||
+			 hmmp_text_expect ( &p, end, "num_states:" ) || hmmp_parse_int ( &p, end, dims+i ) ||
+			 hmmp_text_expect ( &p, end, "num_symbols:" ) ||
+			 hmmp_parse_int ( &p, end, dims+num_models+i ) )
+			flag_broken = 1;
+	}
+	if ( !flag_broken &&
+		 !(p_models = hmmp_create_arr_models_dims ( num_models, dims, dims+num_models )) )
+		flag_broken = 2;
+	if ( !flag_broken ){
+#pragma omp parallel for schedule(dynamic) num_threads(HMMP_NUM_THREADS)
+		for ( i = 0 ; i < num_models ; ++i )
+			if ( hmmp_parse_model_record ( records[i], end, p_models+i ) ){
+				#pragma omp atomic write
+				flag_broken = 1;
+			}
+	}
+	if ( records ) free ( records );
+	if ( dims ) hmmp_delete_int_array ( dims );
+	hmmp_file_unmap ( base, size, mapped );
+	if ( flag_broken && p_models )
+		hmmp_delete_arr_models ( p_models, num_models );
+	if ( flag_broken == 2 )
+		return E_ALLOCATION;
+	if ( flag_broken )
+		return E_FILE_FORMAT;
 	*arr_models = p_models;
 	return num_models;
 }
 
+int hmmp_load_models ( hmmp_Model **arr_models, char *filename, int max_num  )
+{
+	FILE *file;
+	uint32_t magic;
+	int binary;
+
+	if ( !arr_models || !filename )
+		return E_PARAMETER;
+	if(!(file = fopen ( filename , "rb" )))
+		return E_FILE_OPEN;
+	binary = fread ( &magic, sizeof ( magic ), 1, file ) == 1 && magic == HMMP_MODELS_MAGIC;
+	fclose ( file );
+	if ( binary )
+		return hmmp_load_models_binary ( arr_models, filename, max_num );
+	return hmmp_load_models_text ( arr_models, filename, max_num );
+}
+
+
+// characters written for one symbol: sign, 10 digits and the blank
+#define HMMP_SYMBOL_CHARS 12
+
+/* Write sequences in the text format of hmmp_save_sequences(), without the num_sequences
+*  line. The symbols are formatted into blocks of HMMP_FORMAT_BLOCK, each block is written
+*  with one fwrite(). '*io_flag_cardinality' is set if a symbol is not below the cardinality. */
+static int hmmp_write_sequences_text ( FILE *file, hmmp_Sequence *arr_seq, int num_seq,
+									   char *io_flag_cardinality )
+{
+	char *buffer, *p, digits[HMMP_SYMBOL_CHARS];
+	hmmp_Rle_Cursor c;
+	unsigned int u;
+	int i, j, symbol, n;
+	int ret = E_SUCCESS;
+
+	if ( !(buffer = (char*) malloc ( HMMP_FORMAT_BLOCK * HMMP_SYMBOL_CHARS )) )
+		return E_ALLOCATION;
+	for ( i = 0 ; i < num_seq && ret == E_SUCCESS ; ++i ){
+		if ( fprintf( file, "seq_id: %d\nlength: %d\ncardinality: %d\nsequence: ",
+					  arr_seq[i].seq_id, arr_seq[i].length, arr_seq[i].cardinality ) < 0 ){
+			ret = E_FILE_WRITE;
+			break;
+		}
+		hmmp_rle_seek ( &c, arr_seq[i], 0 );
+		for ( j = 0 ; j < arr_seq[i].length && ret == E_SUCCESS ; ){
+			p = buffer;
+			for ( ; j < arr_seq[i].length && p - buffer < HMMP_FORMAT_BLOCK * ( HMMP_SYMBOL_CHARS - 1 ) ; ++j ){
+				symbol = HMMP_NEXT_SYMBOL ( arr_seq[i], j, c );
+				if ( symbol >= arr_seq[i].cardinality )
+					*io_flag_cardinality = 1;
+				if ( symbol < 0 )
+					*p++ = '-';
+				u = symbol < 0 ? 0u - (unsigned int) symbol : (unsigned int) symbol;
+				n = 0;
+				do {
+					digits[n++] = (char) ( '0' + u % 10 );
+					u /= 10;
+				} while ( u );
+				while ( n )
+					*p++ = digits[--n];
+				*p++ = ' ';
+			}
+			if ( fwrite ( buffer, 1, p - buffer, file ) != (size_t) ( p - buffer ) )
+				ret = E_FILE_WRITE;
+		}
+		if ( ret == E_SUCCESS && fprintf(file, "\n\n") < 0 )
+			ret = E_FILE_WRITE;
+	}
+	free ( buffer );
+	return ret;
+}
 
 int hmmp_save_sequences ( char *filename, hmmp_Sequence *arr_seq, int num_seq )
 {
 	FILE *file;
-	int i, j;
+	int ret = E_SUCCESS;
 	char flag_cardinality = 0;
 	if(!arr_seq || !filename)
 		return E_PARAMETER;
 	if(!(file = fopen ( filename , "w" )))
 		return E_FILE_OPEN;
-	fprintf( file, "num_sequences: %d\n\n", num_seq);
+	if ( fprintf( file, "num_sequences: %d\n\n", num_seq) < 0 )
+		ret = E_FILE_WRITE;
+	else
+		ret = hmmp_write_sequences_text ( file, arr_seq, num_seq, &flag_cardinality );
+	if ( fclose(file) && ret == E_SUCCESS )
+		ret = E_FILE_WRITE;
+	if ( ret == E_SUCCESS && flag_cardinality )
+		return E_SEQUENCE;
+	return ret;
+}
+
+int hmmp_save_corpus_binary ( char *filename, hmmp_Sequence *arr_seq, int num_seq )
+{
+	FILE *file;
+	hmmp_Seqs_Header header;
+	unsigned char *body, *data;
+	int32_t *ids, *lengths, *cards;
+	hmmp_Rle_Cursor c;
+	uint64_t *offsets, column, max_symbols = 1, pos, bit, run_bytes = 0, data_bytes;
+	int i, j, symbol, bits;
+	int ret = E_SUCCESS;
+	char flag_cardinality = 0;
+
+	if ( !arr_seq || !filename )
+		return E_PARAMETER;
+	if ( num_seq < 1 )
+		return E_ARGUMENT;
+	memset ( &header, 0, sizeof ( header ) );
 	for ( i = 0 ; i < num_seq ; ++i ){
-		fprintf( file, "seq_id: %d\nlength: %d\ncardinality: %d\n",
-				arr_seq[i].seq_id, arr_seq[i].length, arr_seq[i].cardinality );
-		fprintf( file, "sequence: ");
+		if ( arr_seq[i].length < 0 ||
+			 ( arr_seq[i].length && !arr_seq[i].sequence && !arr_seq[i].symbols ) )
+			return E_ARGUMENT;
+		if ( max_symbols < (uint64_t) arr_seq[i].cardinality )
+			max_symbols = arr_seq[i].cardinality;
+		hmmp_rle_seek ( &c, arr_seq[i], 0 );
 		for ( j = 0 ; j < arr_seq[i].length ; ++j ){
-			if(arr_seq[i].sequence[j] >= arr_seq[i].cardinality)
+			symbol = HMMP_NEXT_SYMBOL ( arr_seq[i], j, c );
+			if ( symbol < 0 )
+				return E_ARGUMENT;
+			if ( symbol >= arr_seq[i].cardinality )
 				flag_cardinality = 1;
-			fprintf(file, "%d ", arr_seq[i].sequence[j] );
+			if ( max_symbols <= (uint64_t) symbol )
+				max_symbols = (uint64_t) symbol + 1;
+		}
+		header.total_length += arr_seq[i].length;
+		run_bytes += hmmp_rle_encode ( arr_seq[i], 0 );
+	}
+	bits = hmmp_bin_symbol_bits ( max_symbols );
+	data_bytes = ( header.total_length * bits + 7 ) / 8;
+	// long runs of equal symbols are stored as runs when these are smaller
+	if ( run_bytes < data_bytes ){
+		bits = 0;
+		data_bytes = run_bytes;
+	}
+	column = hmmp_bin_align ( (uint64_t) num_seq * sizeof ( int32_t ) );
+	header.magic = HMMP_SEQS_MAGIC;
+	header.version = HMMP_SEQS_VERSION;
+	header.num_seq = num_seq;
+	header.bits = bits;
+	header.data_offset = hmmp_bin_seqs_data_offset ( num_seq );
+	header.file_size = header.data_offset + hmmp_bin_align ( data_bytes );
+	// everything after the header is built in memory and written at once
+	if ( !(body = (unsigned char*) calloc ( 1, header.file_size - sizeof ( header ) )) )
+		return E_ALLOCATION;
+	ids = (int32_t*) body;
+	lengths = (int32_t*) ( body + column );
+	cards = (int32_t*) ( body + 2*column );
+	offsets = (uint64_t*) ( body + 3*column );
+	data = body + header.data_offset - sizeof ( header );
+	pos = 0;
+	for ( i = 0 ; i < num_seq ; ++i ){
+		ids[i] = arr_seq[i].seq_id;
+		lengths[i] = arr_seq[i].length;
+		cards[i] = arr_seq[i].cardinality;
+		offsets[i] = pos;
+		if ( !bits ){
+			pos += hmmp_rle_encode ( arr_seq[i], data + pos );
+			continue;
 		}
-		fprintf(file, "\n\n");
+		hmmp_rle_seek ( &c, arr_seq[i], 0 );
+		for ( j = 0 ; j < arr_seq[i].length ; ++j, ++pos ){
+			symbol = HMMP_NEXT_SYMBOL ( arr_seq[i], j, c );
+			switch ( bits ){
+			case 8:  data[pos] = (unsigned char) symbol; break;
+			case 16: ((uint16_t*) data)[pos] = (uint16_t) symbol; break;
+			case 32: ((int32_t*) data)[pos] = symbol; break;
+			default:
+				bit = pos * bits;
+				data[bit / 8] |= (unsigned char) ( symbol << ( bit % 8 ) );
+			}
+		}
+	}
+	offsets[num_seq] = pos;
+	if(!(file = fopen ( filename , "wb" ))){
+		free ( body );
+		return E_FILE_OPEN;
 	}
-	fclose(file);
-	if(flag_cardinality)
+	if ( fwrite ( &header, sizeof ( header ), 1, file ) != 1 ||
+		 fwrite ( body, header.file_size - sizeof ( header ), 1, file ) != 1 )
+		ret = E_FILE_WRITE;
+	if ( fclose ( file ) )
+		ret = E_FILE_WRITE;
+	free ( body );
+	if ( ret == E_SUCCESS && flag_cardinality )
 		return E_SEQUENCE;
+	return ret;
+}
+
+int hmmp_map_corpus ( hmmp_Packed_Corpus **o_corpus, char *filename )
+{
+	hmmp_Packed_Corpus *corpus;
+	hmmp_Seqs_Header *header;
+	unsigned char *base;
+	uint64_t column;
+	int k, ret;
+
+	if ( !o_corpus || !filename )
+		return E_PARAMETER;
+	*o_corpus = 0;
+	if ( !(corpus = (hmmp_Packed_Corpus*) calloc ( 1, sizeof ( hmmp_Packed_Corpus ) )) )
+		return E_ALLOCATION;
+	if ( ( ret = hmmp_file_map ( filename, &corpus->base, &corpus->size, &corpus->mapped ) ) ){
+		free ( corpus );
+		return ret;
+	}
+	base = (unsigned char*) corpus->base;
+	header = (hmmp_Seqs_Header*) base;
+	if ( corpus->size < sizeof ( hmmp_Seqs_Header ) || header->magic != HMMP_SEQS_MAGIC ||
+		 header->version != HMMP_SEQS_VERSION || header->num_seq < 1 ||
+		 ( header->bits != 0 && header->bits != 1 && header->bits != 2 && header->bits != 4 &&
+		   header->bits != 8 && header->bits != 16 && header->bits != 32 ) ||
+		 header->file_size != corpus->size ||
+		 header->data_offset != hmmp_bin_seqs_data_offset ( header->num_seq ) ||
+		 header->data_offset > corpus->size ||
+		 ( header->bits &&
+		   ( corpus->size - header->data_offset ) * 8 / header->bits < header->total_length ) ){
+		hmmp_unmap_corpus ( corpus );
+		return E_FILE_FORMAT;
+	}
+	column = hmmp_bin_align ( (uint64_t) header->num_seq * sizeof ( int32_t ) );
+	corpus->num_seq = header->num_seq;
+	corpus->bits = header->bits;
+	corpus->total_length = header->total_length;
+	corpus->seq_ids = (int32_t*) ( base + sizeof ( hmmp_Seqs_Header ) );
+	corpus->lengths = (int32_t*) ( base + sizeof ( hmmp_Seqs_Header ) + column );
+	corpus->cardinalities = (int32_t*) ( base + sizeof ( hmmp_Seqs_Header ) + 2*column );
+	corpus->offsets = (uint64_t*) ( base + sizeof ( hmmp_Seqs_Header ) + 3*column );
+	corpus->symbols = base + header->data_offset;
+	// only the table is checked, the symbols are read on use. The offsets of runs count bytes.
+	if ( corpus->bits )
+		ret = corpus->offsets[0] != 0 || corpus->offsets[corpus->num_seq] != corpus->total_length;
+	else
+		ret = corpus->offsets[0] != 0 ||
+			  corpus->offsets[corpus->num_seq] > corpus->size - header->data_offset;
+	for ( k = 0 ; k < corpus->num_seq && !ret ; ++k )
+		ret = corpus->lengths[k] < 0 || corpus->offsets[k+1] < corpus->offsets[k] ||
+			  ( corpus->bits &&
+				corpus->offsets[k+1] - corpus->offsets[k] != (uint64_t) corpus->lengths[k] );
+	if ( ret ){
+		hmmp_unmap_corpus ( corpus );
+		return E_FILE_FORMAT;
+	}
+	*o_corpus = corpus;
+	return corpus->num_seq;
+}
+
+int hmmp_unmap_corpus ( hmmp_Packed_Corpus *corpus )
+{
+	if ( !corpus )
+		return E_PARAMETER;
+	if ( corpus->base ) hmmp_file_unmap ( corpus->base, corpus->size, corpus->mapped );
+	free ( corpus );
 	return E_SUCCESS;
 }
 
-int hmmp_load_sequences ( hmmp_Sequence **addr_seqp, char *filename, int max_num )
+/* Read a varint of the runs of a packed corpus, E_FILE_FORMAT past 'end'. */
+static int hmmp_packed_varint ( const unsigned char **io_p, const unsigned char *end,
+								unsigned int *o_value )
 {
-	FILE *file;
-	hmmp_Sequence *sequences;
-	int i, j, num_seq, seq_id, length, cardinalty;
+	const unsigned char *p = *io_p;
+	unsigned int value = 0;
+	int shift = 0;
+	do {
+		if ( p >= end || shift > 28 )
+			return E_FILE_FORMAT;
+		value |= (unsigned int) ( *p & 0x7F ) << shift;
+		shift += 7;
+	} while ( *p++ & 0x80 );
+	*io_p = p;
+	*o_value = value;
+	return E_SUCCESS;
+}
+
+/* hmmp_packed_unpack() of a corpus stored as runs ( 'bits' 0 ): the runs of sequence 'k'
+*  are walked from its first byte, every run is checked against the bytes of the sequence. */
+static int hmmp_packed_runs ( hmmp_Packed_Corpus *corpus, int k, int t_begin, int count,
+							  int_array *o_symbols )
+{
+	const unsigned char *p = corpus->symbols + corpus->offsets[k];
+	const unsigned char *end = corpus->symbols + corpus->offsets[k+1];
+	unsigned int symbol, run;
+	int t = 0;
+	while ( count > 0 ){
+		if ( hmmp_packed_varint ( &p, end, &symbol ) || hmmp_packed_varint ( &p, end, &run ) ||
+			 symbol > INT_MAX || run >= (unsigned int) ( corpus->lengths[k] - t ) )
+			return E_FILE_FORMAT;
+		for ( t += run + 1 ; t > t_begin && count > 0 ; ++t_begin, --count )
+			*o_symbols++ = (int) symbol;
+	}
+	return E_SUCCESS;
+}
+
+int hmmp_packed_symbol ( hmmp_Packed_Corpus *corpus, int k, int t )
+{
+	uint64_t pos = corpus->offsets[k] + t, bit;
+	int symbol, ret;
+	switch ( corpus->bits ){
+	case 0:
+		ret = hmmp_packed_runs ( corpus, k, t, 1, &symbol );
+		return ret ? ret : symbol;
+	case 8:  return corpus->symbols[pos];
+	case 16: return ((uint16_t*) corpus->symbols)[pos];
+	case 32: return ((int32_t*) corpus->symbols)[pos];
+	}
+	bit = pos * corpus->bits;
+	return ( corpus->symbols[bit / 8] >> ( bit % 8 ) ) & ( ( 1 << corpus->bits ) - 1 );
+}
+
+int hmmp_packed_unpack ( hmmp_Packed_Corpus *corpus, int k, int t_begin, int count,
+						 int_array *o_symbols )
+{
+	unsigned char *bytes;
+	uint16_t *words;
+	int32_t *ints;
+	uint64_t pos, bit;
+	int t, mask;
+
+	if ( !corpus || !o_symbols )
+		return E_PARAMETER;
+	if ( k < 0 || k >= corpus->num_seq || t_begin < 0 || count < 0 ||
+		 count > corpus->lengths[k] - t_begin )
+		return E_ARGUMENT;
+	pos = corpus->offsets[k] + t_begin;
+	switch ( corpus->bits ){
+	case 0:
+		return hmmp_packed_runs ( corpus, k, t_begin, count, o_symbols );
+	case 8:
+		bytes = corpus->symbols + pos;
+		for ( t = 0 ; t < count ; ++t )
+			o_symbols[t] = bytes[t];
+		break;
+	case 16:
+		words = (uint16_t*) corpus->symbols + pos;
+		for ( t = 0 ; t < count ; ++t )
+			o_symbols[t] = words[t];
+		break;
+	case 32:
+		ints = (int32_t*) corpus->symbols + pos;
+		memcpy ( o_symbols, ints, count * sizeof ( int_array ) );
+		break;
+	default:
+		mask = ( 1 << corpus->bits ) - 1;
+		for ( t = 0, bit = pos * corpus->bits ; t < count ; ++t, bit += corpus->bits )
+			o_symbols[t] = ( corpus->symbols[bit / 8] >> ( bit % 8 ) ) & mask;
+	}
+	return E_SUCCESS;
+}
+
+/* Create the sequences filled by a loader: the arena of a new corpus when 'o_corpus' is
+*  given, otherwise sequences with symbols of their own ( hmmp_create_arr_seq_lengths() ),
+*  so the symbols are stored once in either case. The symbols are not set. */
+static hmmp_Sequence *hmmp_load_create ( hmmp_Corpus **o_corpus, int num_seq, int_array *seq_ids,
+										 int_array *lengths, int_array *cardinalities )
+{
+	hmmp_Sequence *seq_arr;
+	size_t total_length = 0;
+	int k;
+	if ( o_corpus ){
+		for ( k = 0 ; k < num_seq ; ++k )
+			total_length += lengths[k];
+		if ( !(*o_corpus = hmmp_create_corpus ( num_seq, total_length )) )
+			return 0;
+		for ( k = 0 ; k < num_seq ; ++k )
+			if ( !hmmp_corpus_add_sequence ( *o_corpus, seq_ids[k], lengths[k], cardinalities[k] ) ){
+				hmmp_delete_corpus ( *o_corpus );
+				*o_corpus = 0;
+				return 0;
+			}
+		return (*o_corpus)->seq_arr;
+	}
+	if ( !(seq_arr = hmmp_create_arr_seq_lengths ( num_seq, lengths, 0 )) )
+		return 0;
+	for ( k = 0 ; k < num_seq ; ++k ){
+		seq_arr[k].seq_id = seq_ids[k];
+		seq_arr[k].cardinality = cardinalities[k];
+	}
+	return seq_arr;
+}
+
+/* Delete the sequences of hmmp_load_create(). */
+static void hmmp_load_delete ( hmmp_Corpus *corpus, hmmp_Sequence *seq_arr, int num_seq )
+{
+	if ( corpus )
+		hmmp_delete_corpus ( corpus );
+	else if ( seq_arr )
+		hmmp_delete_arr_seq ( seq_arr, num_seq );
+}
+
+/* Load a packed binary file into a corpus ( 'o_corpus' ) or into sequences of their own
+*  ( 'o_seq_arr' ), see hmmp_load_create(). The symbols are unpacked in place. */
+static int hmmp_load_binary ( hmmp_Corpus **o_corpus, hmmp_Sequence **o_seq_arr,
+							  char *filename, int max_num )
+{
+	hmmp_Packed_Corpus *packed;
+	hmmp_Corpus *corpus = 0;
+	hmmp_Sequence *seq_arr;
+	int k, num_seq, ret = E_SUCCESS;
+
+	num_seq = hmmp_map_corpus ( &packed, filename );
+	if ( num_seq < 0 )
+		return num_seq;
+	if ( max_num && max_num < num_seq )
+		num_seq = max_num;
+	seq_arr = hmmp_load_create ( o_corpus ? &corpus : 0, num_seq, packed->seq_ids,
+								 packed->lengths, packed->cardinalities );
+	if ( !seq_arr )
+		ret = E_ALLOCATION;
+	for ( k = 0 ; ret == E_SUCCESS && k < num_seq ; ++k )
+		ret = hmmp_packed_unpack ( packed, k, 0, packed->lengths[k], seq_arr[k].sequence );
+	hmmp_unmap_corpus ( packed );
+	if ( ret ){
+		hmmp_load_delete ( corpus, seq_arr, num_seq );
+		return ret;
+	}
+	if ( o_corpus )
+		*o_corpus = corpus;
+	else
+		*o_seq_arr = seq_arr;
+	return num_seq;
+}
+
+/* Read a decimal integer after white space, as fscanf "%d" does for the files of Hmmplib.
+*  The caller holds the lock of the file, so getc_unlocked() keeps the cost per symbol low. */
+static int hmmp_read_text_int ( FILE *file, int *o_value )
+{
+	unsigned int value = 0;
+	int c, negative = 0;
+	while ( ( c = getc_unlocked ( file ) ) == ' ' || c == '\n' || c == '\r' || c == '\t' )
+		;
+	if ( c == '-' || c == '+' ){
+		negative = c == '-';
+		c = getc_unlocked ( file );
+	}
+	if ( c < '0' || c > '9' )
+		return E_FILE_FORMAT;
+	do {
+		value = value * 10 + ( c - '0' );
+		c = getc_unlocked ( file );
+	} while ( c >= '0' && c <= '9' );
+	ungetc ( c, file );
+	*o_value = negative ? -(int) value : (int) value;
+	return E_SUCCESS;
+}
+
+/* Read the symbols of a sequence of a text file, which follow its header. The
+*  cardinality of the sequence is raised when a larger symbol is found. */
+static int hmmp_read_text_symbols ( FILE *file, hmmp_Sequence *seq )
+{
+	int j, ret = E_SUCCESS;
+	if ( fscanf(file,"sequence:") == EOF )
+		return E_FILE_FORMAT;
+	flockfile ( file );
+	for ( j = 0 ; j < seq->length ; ++j ){
+		if ( ( ret = hmmp_read_text_int ( file, &seq->sequence[j] ) ) )
+			break;
+		if ( seq->sequence[j] >= seq->cardinality )
+			seq->cardinality = seq->sequence[j];
+	}
+	funlockfile ( file );
+	if ( ret || fscanf(file,"\n\n") == EOF )
+		return E_FILE_FORMAT;
+	return E_SUCCESS;
+}
+
+/* Parse the symbols of the text record of one sequence, which follow its header. The
+*  cardinality of the sequence is raised when a larger symbol is found. */
+static int hmmp_parse_sequence_record ( const char *p, const char *end, hmmp_Sequence *seq )
+{
+	int j;
+	if ( hmmp_text_expect ( &p, end, "sequence:" ) )
+		return E_FILE_FORMAT;
+	for ( j = 0 ; j < seq->length ; ++j ){
+		if ( hmmp_parse_int ( &p, end, seq->sequence + j ) )
+			return E_FILE_FORMAT;
+		if ( seq->sequence[j] >= seq->cardinality )
+			seq->cardinality = seq->sequence[j];
+	}
+	return E_SUCCESS;
+}
+
+/* hmmp_load_binary() of a text file. The file is mapped, the headers of the sequences are
+*  read first to size the destination, then the symbols are parsed into it in parallel. */
+static int hmmp_load_text ( hmmp_Corpus **o_corpus, hmmp_Sequence **o_seq_arr,
+							char *filename, int max_num )
+{
+	hmmp_Corpus *corpus = 0;
+	hmmp_Sequence *seq_arr = 0;
+	const char *p, *end, **records;
+	void *base;
+	size_t size;
+	int_array *headers, *lengths = 0, *cardinalities = 0;
+	int i, num_seq, mapped, ret;
 	char flag_broken = 0;
+
+	if ( ( ret = hmmp_file_map ( filename, &base, &size, &mapped ) ) )
+		return ret == E_FILE_FORMAT ? E_FILE_READ : ret;
+	p = (const char*) base;
+	end = p + size;
+	if ( hmmp_text_expect ( &p, end, "num_sequences:" ) || hmmp_parse_int ( &p, end, &num_seq ) ){
+		hmmp_file_unmap ( base, size, mapped );
+		return E_FILE_READ;
+	}
+	if ( max_num && max_num < num_seq )
+		num_seq = max_num;
+	if ( num_seq < 1 ){
+		hmmp_file_unmap ( base, size, mapped );
+		return E_FILE_FORMAT;
+	}
+	// seq_id, length and cardinality of all sequences, one after the other
+	records = (const char**) malloc ( num_seq * sizeof ( char* ) );
+	headers = hmmp_create_int_array ( 3*(size_t)num_seq );
+	if ( !records || !headers )
+		flag_broken = 2;
+	else {
+		lengths = headers + num_seq;
+		cardinalities = lengths + num_seq;
+	}
+	for ( i = 0 ; i < num_seq && !flag_broken ; ++i ){
+		p = hmmp_text_find ( p, end, "seq_id:" );
+		if ( hmmp_text_expect ( &p, end, "seq_id:" ) || hmmp_parse_int ( &p, end, headers+i ) ||
+			 hmmp_text_expect ( &p, end, "length:" ) || hmmp_parse_int ( &p, end, lengths+i ) ||
+			 hmmp_text_expect ( &p, end, "cardinality:" ) ||
+			 hmmp_parse_int ( &p, end, cardinalities+i ) || lengths[i] < 0 )
+			flag_broken = 1;
+		records[i] = p;
+	}
+	if ( !flag_broken && !(seq_arr = hmmp_load_create ( o_corpus ? &corpus : 0, num_seq, headers,
+														lengths, cardinalities )) )
+		flag_broken = 2;
+	if ( !flag_broken ){
+#pragma omp parallel for schedule(dynamic) num_threads(HMMP_NUM_THREADS)
+		for ( i = 0 ; i < num_seq ; ++i )
+			if ( hmmp_parse_sequence_record ( records[i], end, seq_arr+i ) ){
+				#pragma omp atomic write
+				flag_broken = 1;
+			}
+	}
+	if ( records ) free ( records );
+	if ( headers ) hmmp_delete_int_array ( headers );
+	hmmp_file_unmap ( base, size, mapped );
+	if ( flag_broken )
+		hmmp_load_delete ( corpus, seq_arr, num_seq );
+	if ( flag_broken == 2 )
+		return E_ALLOCATION;
+	if ( flag_broken )
+		return E_FILE_FORMAT;
+	if ( o_corpus )
+		*o_corpus = corpus;
+	else
+		*o_seq_arr = seq_arr;
+	return num_seq;
+}
+
+/* Load a text or packed binary file, see hmmp_load_binary(). */
+static int hmmp_load ( hmmp_Corpus **o_corpus, hmmp_Sequence **o_seq_arr,
+					   char *filename, int max_num )
+{
+	FILE *file;
+	uint32_t magic;
+	int binary;
 	
+	if(!(file = fopen ( filename , "rb" )))
+		return E_FILE_OPEN;
+	binary = fread ( &magic, sizeof ( magic ), 1, file ) == 1 && magic == HMMP_SEQS_MAGIC;
+	fclose ( file );
+	if ( binary )
+		return hmmp_load_binary ( o_corpus, o_seq_arr, filename, max_num );
+	return hmmp_load_text ( o_corpus, o_seq_arr, filename, max_num );
+}
+
+int hmmp_load_corpus ( hmmp_Corpus **o_corpus, char *filename, int max_num )
+{
+	if(!o_corpus || !filename )
+		return E_PARAMETER;
+	*o_corpus = 0;
+	return hmmp_load ( o_corpus, 0, filename, max_num );
+}
+
+int hmmp_load_sequences ( hmmp_Sequence **addr_seqp, char *filename, int max_num )
+{
 	if(!addr_seqp || !filename )
 		return E_PARAMETER;
+	return hmmp_load ( 0, addr_seqp, filename, max_num );
+}
 
-	if(!(file = fopen ( filename , "r" )))
-		return E_FILE_OPEN;
+static int hmmp_file_seek ( FILE *file, uint64_t offset )
+{
+#ifdef __linux__
+	return fseeko ( file, (off_t) offset, SEEK_SET );
+#else
+	return fseek ( file, (long) offset, SEEK_SET );
+#endif
+}
 
-	if ( fscanf(file,"num_sequences: %d\n", &num_seq ) != 1 )
+/* Size of a file opened for reading, the file position is left at the start. */
+static int hmmp_file_size ( FILE *file, uint64_t *o_size )
+{
+#ifdef __linux__
+	off_t size;
+	if ( fseeko ( file, 0, SEEK_END ) || (size = ftello ( file )) < 0 )
 		return E_FILE_READ;
+#else
+	long size;
+	if ( fseek ( file, 0, SEEK_END ) || (size = ftell ( file )) < 0 )
+		return E_FILE_READ;
+#endif
+	*o_size = (uint64_t) size;
+	return hmmp_file_seek ( file, 0 ) ? E_FILE_READ : E_SUCCESS;
+}
 
-	if ( max_num && max_num < num_seq )
-		num_seq = max_num;
-	sequences = ( hmmp_Sequence *)malloc(num_seq * sizeof ( hmmp_Sequence ));
-	if ( !sequences )
+/* Entries of the sequence records of a text file, found at their "seq_id:" headers. The
+*  file is read in blocks and the symbols are skipped, only the headers are parsed. */
+static int hmmp_index_text ( FILE *file, uint64_t file_size, hmmp_Index_Entry **o_entries )
+{
+	const size_t capacity = HMMP_SCAN_BLOCK + HMMP_SCAN_HEADER;
+	const size_t key_length = strlen ( "seq_id:" );
+	hmmp_Index_Entry *entries = 0;
+	char *buffer;
+	const char *p, *q, *end;
+	uint64_t position = 0;
+	size_t filled, keep;
+	int count = 0, num_seq, eof, k;
+	int ret = E_SUCCESS;
+
+	if ( !(buffer = (char*) malloc ( capacity )) )
 		return E_ALLOCATION;
+	filled = fread ( buffer, 1, capacity, file );
+	eof = filled < capacity;
+	p = buffer;
+	end = buffer + filled;
+	if ( hmmp_text_expect ( &p, end, "num_sequences:" ) || hmmp_parse_int ( &p, end, &num_seq ) )
+		ret = E_FILE_READ;
+	else if ( num_seq < 1 )
+		ret = E_FILE_FORMAT;
+	else if ( !(entries = (hmmp_Index_Entry*) malloc ( num_seq * sizeof ( hmmp_Index_Entry ) )) )
+		ret = E_ALLOCATION;
+	while ( ret == E_SUCCESS && count < num_seq ){
+		q = hmmp_text_find ( p, end, "seq_id:" );
+		if ( q == end || ( end - q < HMMP_SCAN_HEADER && !eof ) ){
+			if ( eof ){
+				ret = E_FILE_FORMAT;
+				break;
+			}
+			// keep a header or a key cut by the end of the block, and read on
+			if ( q == end ){
+				keep = (size_t) ( end - p ) < key_length - 1 ? (size_t) ( end - p ) : key_length - 1;
+				q = end - keep;
+			}
+			else
+				keep = end - q;
+			memmove ( buffer, q, keep );
+			position += q - buffer;
+			filled = keep + fread ( buffer + keep, 1, capacity - keep, file );
+			eof = filled < capacity;
+			p = buffer;
+			end = buffer + filled;
+			continue;
+		}
+		entries[count].number = count;
+		entries[count].offset = position + ( q - buffer );
+		p = q;
+		if ( hmmp_text_expect ( &p, end, "seq_id:" ) ||
+			 hmmp_parse_int ( &p, end, &entries[count].seq_id ) ||
+			 hmmp_text_expect ( &p, end, "length:" ) ||
+			 hmmp_parse_int ( &p, end, &entries[count].length ) ||
+			 hmmp_text_expect ( &p, end, "cardinality:" ) ||
+			 hmmp_parse_int ( &p, end, &entries[count].cardinality ) ||
+			 entries[count].length < 0 )
+			ret = E_FILE_FORMAT;
+		++count;
+	}
+	free ( buffer );
+	if ( ret ){
+		if ( entries ) free ( entries );
+		return ret;
+	}
+	// a record ends where the next one starts
+	for ( k = 0 ; k < count ; ++k )
+		entries[k].bytes = ( k + 1 < count ? entries[k+1].offset : file_size ) - entries[k].offset;
+	*o_entries = entries;
+	return count;
+}
 
-	for ( i = 0 ; i < num_seq ; ++i ){
-		if ( fscanf(file,"seq_id:%d\nlength:%d\ncardinality:%d\n", 
-			&seq_id, &length, &cardinalty ) != 3 ){
-			flag_broken = 1;
+static int hmmp_index_entry_compare ( const void *a, const void *b )
+{
+	const hmmp_Index_Entry *x = (const hmmp_Index_Entry*) a, *y = (const hmmp_Index_Entry*) b;
+	if ( x->seq_id != y->seq_id )
+		return x->seq_id < y->seq_id ? -1 : 1;
+	return x->number < y->number ? -1 : x->number > y->number;
+}
+
+int hmmp_build_sequence_index ( char *filename, char *index_filename )
+{
+	FILE *file;
+	hmmp_Packed_Corpus *packed;
+	hmmp_Index_Header header;
+	hmmp_Index_Entry *entries = 0;
+	uint64_t file_size;
+	uint32_t magic;
+	int k, num_seq, binary, ret;
+
+	if ( !filename || !index_filename )
+		return E_PARAMETER;
+	if(!(file = fopen ( filename , "rb" )))
+		return E_FILE_OPEN;
+	binary = fread ( &magic, sizeof ( magic ), 1, file ) == 1 && magic == HMMP_SEQS_MAGIC;
+	if ( ( ret = hmmp_file_size ( file, &file_size ) ) ){
+		fclose ( file );
+		return ret;
+	}
+	if ( !binary )
+		num_seq = hmmp_index_text ( file, file_size, &entries );
+	fclose ( file );
+	if ( binary ){
+		// the table of the packed file has everything, the symbols are not touched
+		if ( (num_seq = hmmp_map_corpus ( &packed, filename )) < 0 )
+			return num_seq;
+		if ( ( entries = (hmmp_Index_Entry*) malloc ( num_seq * sizeof ( hmmp_Index_Entry ) ) ) )
+			for ( k = 0 ; k < num_seq ; ++k ){
+				entries[k].seq_id = packed->seq_ids[k];
+				entries[k].number = k;
+				entries[k].length = packed->lengths[k];
+				entries[k].cardinality = packed->cardinalities[k];
+				entries[k].offset = (unsigned char*) packed->symbols - (unsigned char*) packed->base +
+									( packed->bits ? packed->offsets[k] * packed->bits / 8 :
+													 packed->offsets[k] );
+				entries[k].bytes = packed->bits ? ( packed->offsets[k+1] * packed->bits + 7 ) / 8 -
+												  packed->offsets[k] * packed->bits / 8 :
+												  packed->offsets[k+1] - packed->offsets[k];
+			}
+		hmmp_unmap_corpus ( packed );
+		if ( !entries )
+			return E_ALLOCATION;
+	}
+	if ( num_seq < 0 )
+		return num_seq;
+	qsort ( entries, num_seq, sizeof ( hmmp_Index_Entry ), hmmp_index_entry_compare );
+
+	memset ( &header, 0, sizeof ( header ) );
+	header.magic = HMMP_INDEX_MAGIC;
+	header.version = HMMP_INDEX_VERSION;
+	header.num_seq = num_seq;
+	header.binary = binary;
+	header.file_size = file_size;
+	if(!(file = fopen ( index_filename , "wb" ))){
+		free ( entries );
+		return E_FILE_OPEN;
+	}
+	ret = E_SUCCESS;
+	if ( fwrite ( &header, sizeof ( header ), 1, file ) != 1 ||
+		 fwrite ( entries, sizeof ( hmmp_Index_Entry ), num_seq, file ) != (size_t) num_seq )
+		ret = E_FILE_WRITE;
+	if ( fclose ( file ) )
+		ret = E_FILE_WRITE;
+	free ( entries );
+	return ret ? ret : num_seq;
+}
+
+/* The first entry of 'seq_id' in the sorted entries, 0 if there is none. */
+static const hmmp_Index_Entry *hmmp_index_find ( const hmmp_Index_Entry *entries, int count,
+												 int seq_id )
+{
+	int low = 0, high = count;
+	while ( low < high ){
+		int middle = low + ( high - low ) / 2;
+		if ( entries[middle].seq_id < seq_id )
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low < count && entries[low].seq_id == seq_id ? entries + low : 0;
+}
+
+int hmmp_load_sequences_by_id ( hmmp_Corpus **o_corpus, char *filename, char *index_filename,
+								int *seq_ids, int num_ids )
+{
+	hmmp_Corpus *corpus = 0;
+	hmmp_Packed_Corpus *packed = 0;
+	const hmmp_Index_Header *header;
+	const hmmp_Index_Entry *entries, **found = 0;
+	FILE *file = 0;
+	void *base;
+	char *buffer = 0;
+	const char *p, *end;
+	size_t size, total_length = 0;
+	uint64_t file_size, max_bytes = 0;
+	int i, num_found = 0, mapped, seq_id, length, cardinality, ret;
+
+	if ( !o_corpus || !filename || !index_filename || ( num_ids && !seq_ids ) )
+		return E_PARAMETER;
+	if ( num_ids < 0 )
+		return E_ARGUMENT;
+	*o_corpus = 0;
+	if ( ( ret = hmmp_file_map ( index_filename, &base, &size, &mapped ) ) )
+		return ret;
+	header = (const hmmp_Index_Header*) base;
+	entries = (const hmmp_Index_Entry*) ( header + 1 );
+	if ( size < sizeof ( hmmp_Index_Header ) || header->magic != HMMP_INDEX_MAGIC ||
+		 header->version != HMMP_INDEX_VERSION || header->num_seq < 0 ||
+		 size != sizeof ( hmmp_Index_Header ) + header->num_seq * sizeof ( hmmp_Index_Entry ) ){
+		hmmp_file_unmap ( base, size, mapped );
+		return E_FILE_FORMAT;
+	}
+
+	// the file must be the one indexed, the binary one is checked again when mapped
+	if ( header->binary ){
+		if ( (ret = hmmp_map_corpus ( &packed, filename )) >= 0 )
+			ret = packed->size == header->file_size ? E_SUCCESS : E_FILE_FORMAT;
+	}
+	else if ( !(file = fopen ( filename, "rb" )) )
+		ret = E_FILE_OPEN;
+	else if ( !(ret = hmmp_file_size ( file, &file_size )) && file_size != header->file_size )
+		ret = E_FILE_FORMAT;
+	if ( ret == E_SUCCESS && num_ids &&
+		 !(found = (const hmmp_Index_Entry**) malloc ( num_ids * sizeof ( hmmp_Index_Entry* ) )) )
+		ret = E_ALLOCATION;
+	for ( i = 0 ; i < num_ids && ret == E_SUCCESS ; ++i )
+		if ( ( found[num_found] = hmmp_index_find ( entries, header->num_seq, seq_ids[i] ) ) ){
+			total_length += found[num_found]->length;
+			if ( found[num_found]->bytes > max_bytes )
+				max_bytes = found[num_found]->bytes;
+			++num_found;
+		}
+	if ( ret == E_SUCCESS && !(corpus = hmmp_create_corpus ( num_found, total_length )) )
+		ret = E_ALLOCATION;
+	if ( ret == E_SUCCESS && file && num_found && !(buffer = (char*) malloc ( max_bytes )) )
+		ret = E_ALLOCATION;
+
+	for ( i = 0 ; i < num_found && ret == E_SUCCESS ; ++i ){
+		if ( packed ){
+			if ( found[i]->number >= packed->num_seq ||
+				 packed->seq_ids[found[i]->number] != found[i]->seq_id ){
+				ret = E_FILE_FORMAT;
+				break;
+			}
+			if ( !hmmp_corpus_add_sequence ( corpus, found[i]->seq_id, found[i]->length,
+											 found[i]->cardinality ) ){
+				ret = E_ALLOCATION;
+				break;
+			}
+			ret = hmmp_packed_unpack ( packed, found[i]->number, 0, found[i]->length,
+									   corpus->seq_arr[i].sequence );
+			continue;
+		}
+		// read only the record of the sequence
+		if ( hmmp_file_seek ( file, found[i]->offset ) ||
+			 fread ( buffer, 1, found[i]->bytes, file ) != found[i]->bytes ){
+			ret = E_FILE_READ;
 			break;
 		}
-		sequences[i].sequence = (int_array *)malloc( sizeof(int_array)*length );
-		if ( !sequences[i].sequence){
-			flag_broken = 2;
+		p = buffer;
+		end = buffer + found[i]->bytes;
+		if ( hmmp_text_expect ( &p, end, "seq_id:" ) || hmmp_parse_int ( &p, end, &seq_id ) ||
+			 hmmp_text_expect ( &p, end, "length:" ) || hmmp_parse_int ( &p, end, &length ) ||
+			 hmmp_text_expect ( &p, end, "cardinality:" ) ||
+			 hmmp_parse_int ( &p, end, &cardinality ) ||
+			 seq_id != found[i]->seq_id || length != found[i]->length ){
+			ret = E_FILE_FORMAT;
 			break;
 		}
-		sequences[i].seq_id = seq_id;
-		sequences[i].length = length;
-		sequences[i].cardinality = cardinalty;
-		if ( fscanf(file,"sequence:") == EOF ){
-			flag_broken = -1;
+		if ( !hmmp_corpus_add_sequence ( corpus, seq_id, length, cardinality ) ){
+			ret = E_ALLOCATION;
 			break;
 		}
-		for ( j = 0 ; j < length ; ++j ){
-			if (fscanf(file, "%d", &sequences[i].sequence[j] ) != 1 ){
-				flag_broken = -1;
+		ret = hmmp_parse_sequence_record ( p, end, corpus->seq_arr + i );
+	}
+
+	if ( buffer ) free ( buffer );
+	if ( found ) free ( found );
+	if ( file ) fclose ( file );
+	if ( packed ) hmmp_unmap_corpus ( packed );
+	hmmp_file_unmap ( base, size, mapped );
+	if ( ret < 0 ){
+		if ( corpus ) hmmp_delete_corpus ( corpus );
+		return ret;
+	}
+	*o_corpus = corpus;
+	return num_found;
+}
+
+int hmmp_open_sequence_stream ( hmmp_Sequence_Stream **o_stream, char *filename )
+{
+	hmmp_Sequence_Stream *stream;
+	FILE *file;
+	uint32_t magic;
+	int num_seq;
+
+	if ( !o_stream || !filename )
+		return E_PARAMETER;
+	*o_stream = 0;
+	if(!(file = fopen ( filename , "rb" )))
+		return E_FILE_OPEN;
+	if ( !(stream = (hmmp_Sequence_Stream*) calloc ( 1, sizeof ( hmmp_Sequence_Stream ) )) ){
+		fclose ( file );
+		return E_ALLOCATION;
+	}
+	if ( fread ( &magic, sizeof ( magic ), 1, file ) == 1 && magic == HMMP_SEQS_MAGIC ){
+		// packed files are mapped, the symbols are unpacked chunk by chunk
+		fclose ( file );
+		num_seq = hmmp_map_corpus ( &stream->packed, filename );
+	}
+	else {
+		rewind ( file );
+		stream->file = file;
+		if ( fscanf(file,"num_sequences: %d\n", &num_seq ) != 1 )
+			num_seq = E_FILE_READ;
+		else if ( num_seq < 1 )
+			num_seq = E_FILE_FORMAT;
+	}
+	if ( num_seq < 0 ){
+		hmmp_close_sequence_stream ( stream );
+		return num_seq;
+	}
+	stream->num_seq = num_seq;
+	*o_stream = stream;
+	return num_seq;
+}
+
+int hmmp_read_sequence_chunk ( hmmp_Sequence_Stream *stream, hmmp_Corpus *chunk,
+							   size_t max_length )
+{
+	FILE *file;
+	hmmp_Packed_Corpus *packed;
+	int_array *symbols;
+	int k, length;
+
+	if ( !stream || !chunk || stream->writing )
+		return E_PARAMETER;
+	hmmp_corpus_clear ( chunk );
+	file = (FILE*) stream->file;
+	packed = stream->packed;
+	while ( stream->next < stream->num_seq ){
+		if ( packed ){
+			k = stream->next;
+			length = packed->lengths[k];
+			if ( chunk->num_seq && chunk->total_length + length > max_length )
+				break;
+			symbols = hmmp_corpus_add_sequence ( chunk, packed->seq_ids[k], length,
+												 packed->cardinalities[k] );
+			if ( !symbols )
+				return E_ALLOCATION;
+			if ( hmmp_packed_unpack ( packed, k, 0, length, symbols ) )
+				return E_FILE_FORMAT;
+		}
+		else {
+			// the header of a sequence which does not fit is kept for the next chunk
+			if ( !stream->pending && fscanf(file,"seq_id:%d\nlength:%d\ncardinality:%d\n", 
+					&stream->pending_id, &stream->pending_length,
+					&stream->pending_cardinality ) != 3 )
+				return E_FILE_FORMAT;
+			stream->pending = 1;
+			if ( chunk->num_seq && chunk->total_length + stream->pending_length > max_length )
 				break;
+			if ( !hmmp_corpus_add_sequence ( chunk, stream->pending_id, stream->pending_length,
+											 stream->pending_cardinality ) )
+				return E_ALLOCATION;
+			stream->pending = 0;
+			if ( hmmp_read_text_symbols ( file, chunk->seq_arr + chunk->num_seq - 1 ) )
+				return E_FILE_FORMAT;
+		}
+		++stream->next;
+	}
+	return chunk->num_seq;
+}
+
+int hmmp_create_sequence_stream ( hmmp_Sequence_Stream **o_stream, char *filename, int num_seq )
+{
+	hmmp_Sequence_Stream *stream;
+	FILE *file;
+
+	if ( !o_stream || !filename )
+		return E_PARAMETER;
+	*o_stream = 0;
+	if ( num_seq < 1 )
+		return E_ARGUMENT;
+	if(!(file = fopen ( filename , "w" )))
+		return E_FILE_OPEN;
+	if ( !(stream = (hmmp_Sequence_Stream*) calloc ( 1, sizeof ( hmmp_Sequence_Stream ) )) ){
+		fclose ( file );
+		return E_ALLOCATION;
+	}
+	stream->file = file;
+	stream->writing = 1;
+	stream->num_seq = num_seq;
+	if ( fprintf( file, "num_sequences: %d\n\n", num_seq) < 0 ){
+		hmmp_close_sequence_stream ( stream );
+		return E_FILE_WRITE;
+	}
+	*o_stream = stream;
+	return E_SUCCESS;
+}
+
+int hmmp_write_sequence_chunk ( hmmp_Sequence_Stream *stream, hmmp_Sequence *arr_seq, int num_seq )
+{
+	int ret;
+	char flag_cardinality = 0;
+
+	if ( !stream || !arr_seq || !stream->writing )
+		return E_PARAMETER;
+	if ( num_seq < 0 || num_seq > stream->num_seq - stream->next )
+		return E_ARGUMENT;
+	if ( ( ret = hmmp_write_sequences_text ( (FILE*) stream->file, arr_seq, num_seq,
+										     &flag_cardinality ) ) )
+		return ret;
+	stream->next += num_seq;
+	if ( flag_cardinality )
+		return E_SEQUENCE;
+	return E_SUCCESS;
+}
+
+int hmmp_close_sequence_stream ( hmmp_Sequence_Stream *stream )
+{
+	int ret = E_SUCCESS;
+	if ( !stream )
+		return E_PARAMETER;
+	// a written file announcing more sequences than it holds can not be read back
+	if ( stream->writing && stream->next != stream->num_seq )
+		ret = E_FILE_FORMAT;
+	if ( stream->file && fclose ( (FILE*) stream->file ) && stream->writing && !ret )
+		ret = E_FILE_WRITE;
+	if ( stream->packed ) hmmp_unmap_corpus ( stream->packed );
+	free ( stream );
+	return ret;
+}
+
+/* Offsets of the columns of a results batch from the start of the batch. */
+static void hmmp_results_layout ( uint64_t num_seq, uint64_t o_column[6] )
+{
+	o_column[0] = hmmp_bin_align ( sizeof ( hmmp_Results_Batch ) );
+	o_column[1] = o_column[0] + hmmp_bin_align ( num_seq * sizeof ( int32_t ) );
+	o_column[2] = o_column[1] + hmmp_bin_align ( num_seq * sizeof ( int32_t ) );
+	o_column[3] = o_column[2] + hmmp_bin_align ( num_seq * sizeof ( int32_t ) );
+	o_column[4] = o_column[3] + hmmp_bin_align ( num_seq * sizeof ( double ) );
+	o_column[5] = o_column[4] + hmmp_bin_align ( ( num_seq + 1 ) * sizeof ( uint64_t ) );
+}
+
+/* Store a state in 'width' bytes. */
+static void hmmp_results_put ( unsigned char *p, int width, int state )
+{
+	uint8_t s8 = (uint8_t) state;
+	uint16_t s16 = (uint16_t) state;
+	int32_t s32 = state;
+	memcpy ( p, width == 1 ? (void*) &s8 : width == 2 ? (void*) &s16 : (void*) &s32, width );
+}
+
+/* Read a state stored in 'width' bytes. */
+static int hmmp_results_get ( const unsigned char *p, int width )
+{
+	uint16_t s16;
+	int32_t s32;
+	if ( width == 1 )
+		return *p;
+	if ( width == 2 ){
+		memcpy ( &s16, p, sizeof ( s16 ) );
+		return s16;
+	}
+	memcpy ( &s32, p, sizeof ( s32 ) );
+	return s32;
+}
+
+/* Bytes of the states of one sequence in a results batch. */
+static uint64_t hmmp_results_bytes ( hmmp_Sequence seq, int content, int width )
+{
+	uint64_t runs;
+	int t;
+	if ( content == HMMP_RESULTS_LOGP )
+		return 0;
+	if ( content == HMMP_RESULTS_STATES )
+		return (uint64_t) seq.length * width;
+	runs = seq.length > 0;
+	for ( t = 1 ; t < seq.length ; ++t )
+		if ( HMMP_SYMBOL ( seq, t ) != HMMP_SYMBOL ( seq, t-1 ) )
+			++runs;
+	return runs * ( width + sizeof ( uint32_t ) );
+}
+
+int hmmp_append_results ( char *filename, hmmp_Sequence *arr_seq, double *logP, int num_seq,
+						  int content )
+{
+	FILE *file;
+	hmmp_Results_Header header;
+	hmmp_Results_Batch *batch;
+	unsigned char *block, *states;
+	int32_t *ids, *lengths, *cards;
+	double *probs;
+	uint64_t *offsets, column[6], batch_bytes;
+	int k, min_state = 0, max_state = 0, width = 0, exists;
+	int ret = E_SUCCESS;
+
+	if ( !filename || !arr_seq || !logP )
+		return E_PARAMETER;
+	if ( num_seq < 1 || content < HMMP_RESULTS_LOGP || content > HMMP_RESULTS_STATES_RLE )
+		return E_ARGUMENT;
+	if ( content != HMMP_RESULTS_LOGP ){
+		// the states are read at random, sequences of runs are expanded first
+		for ( k = 0 ; k < num_seq ; ++k )
+			if ( HMMP_SEQUENCE_TYPE ( arr_seq[k] ) == HMMP_SYMBOLS_RLE )
+				return E_ARGUMENT;
+#pragma omp parallel for num_threads(HMMP_NUM_THREADS) schedule(dynamic,16) \
+		reduction(min:min_state) reduction(max:max_state)
+		for ( k = 0 ; k < num_seq ; ++k ){
+			int t, state;
+			for ( t = 0 ; t < arr_seq[k].length ; ++t ){
+				state = HMMP_SYMBOL ( arr_seq[k], t );
+				if ( state < min_state ) min_state = state;
+				if ( state > max_state ) max_state = state;
 			}
-			if ( sequences[i].sequence[j] >= cardinalty ){
-				sequences[i].cardinality = cardinalty = sequences[i].sequence[j];
+		}
+		width = min_state < 0 ? 4 : max_state <= UINT8_MAX ? 1 : max_state <= UINT16_MAX ? 2 : 4;
+	}
+	hmmp_results_layout ( num_seq, column );
+	if ( !(offsets = (uint64_t*) malloc ( ( num_seq + 1 ) * sizeof ( uint64_t ) )) )
+		return E_ALLOCATION;
+	offsets[0] = 0;
+#pragma omp parallel for num_threads(HMMP_NUM_THREADS) schedule(dynamic,16)
+	for ( k = 0 ; k < num_seq ; ++k )
+		offsets[k+1] = hmmp_results_bytes ( arr_seq[k], content, width );
+	for ( k = 0 ; k < num_seq ; ++k )
+		offsets[k+1] += offsets[k];
+	batch_bytes = hmmp_bin_align ( column[5] + offsets[num_seq] );
+	if ( batch_bytes > SIZE_MAX || !(block = (unsigned char*) calloc ( 1, (size_t) batch_bytes )) ){
+		free ( offsets );
+		return E_ALLOCATION;
+	}
+	batch = (hmmp_Results_Batch*) block;
+	batch->num_seq = num_seq;
+	batch->content = content;
+	batch->width = width;
+	batch->batch_bytes = batch_bytes;
+	batch->states_bytes = offsets[num_seq];
+	ids = (int32_t*) ( block + column[0] );
+	lengths = (int32_t*) ( block + column[1] );
+	cards = (int32_t*) ( block + column[2] );
+	probs = (double*) ( block + column[3] );
+	memcpy ( block + column[4], offsets, ( num_seq + 1 ) * sizeof ( uint64_t ) );
+	states = block + column[5];
+#pragma omp parallel for num_threads(HMMP_NUM_THREADS) schedule(dynamic,16)
+	for ( k = 0 ; k < num_seq ; ++k ){
+		unsigned char *p = states + offsets[k];
+		uint32_t run;
+		int t, state;
+		ids[k] = arr_seq[k].seq_id;
+		lengths[k] = content == HMMP_RESULTS_LOGP ? 0 : arr_seq[k].length;
+		cards[k] = arr_seq[k].cardinality;
+		probs[k] = logP[k];
+		if ( content == HMMP_RESULTS_STATES )
+			for ( t = 0 ; t < arr_seq[k].length ; ++t, p += width )
+				hmmp_results_put ( p, width, HMMP_SYMBOL ( arr_seq[k], t ) );
+		else if ( content == HMMP_RESULTS_STATES_RLE )
+			for ( t = 0 ; t < arr_seq[k].length ; t += run ){
+				state = HMMP_SYMBOL ( arr_seq[k], t );
+				for ( run = 1 ; t + (int) run < arr_seq[k].length &&
+								HMMP_SYMBOL ( arr_seq[k], t + (int) run ) == state ; ++run )
+					;
+				hmmp_results_put ( p, width, state );
+				memcpy ( p + width, &run, sizeof ( run ) );
+				p += width + sizeof ( run );
 			}
+	}
+	free ( offsets );
+
+	// a new or empty file gets the header, an existing one has to be a results file
+	exists = 0;
+	if ( ( file = fopen ( filename , "rb" ) ) ){
+		if ( fread ( &header, sizeof ( header ), 1, file ) == 1 ){
+			exists = 1;
+			if ( header.magic != HMMP_RESULTS_MAGIC || header.version != HMMP_RESULTS_VERSION )
+				ret = E_FILE_FORMAT;
 		}
-		if ( flag_broken == -1 )
+		else if ( !feof ( file ) || ftell ( file ) > 0 )
+			ret = E_FILE_FORMAT;
+		fclose ( file );
+	}
+	if ( ret == E_SUCCESS && !(file = fopen ( filename , exists ? "ab" : "wb" )) )
+		ret = E_FILE_OPEN;
+	if ( ret == E_SUCCESS ){
+		memset ( &header, 0, sizeof ( header ) );
+		header.magic = HMMP_RESULTS_MAGIC;
+		header.version = HMMP_RESULTS_VERSION;
+		if ( ( !exists && fwrite ( &header, sizeof ( header ), 1, file ) != 1 ) ||
+			 fwrite ( block, 1, (size_t) batch_bytes, file ) != (size_t) batch_bytes )
+			ret = E_FILE_WRITE;
+		if ( fclose ( file ) && ret == E_SUCCESS )
+			ret = E_FILE_WRITE;
+	}
+	free ( block );
+	return ret;
+}
+
+int hmmp_load_results ( hmmp_Corpus **o_states, dbl_array **o_logP, char *filename )
+{
+	const hmmp_Results_Header *header;
+	const hmmp_Results_Batch *batch;
+	const unsigned char *p;
+	const int32_t *lengths;
+	hmmp_Corpus *corpus = 0;
+	dbl_array *logP = 0;
+	void *base;
+	size_t size;
+	uint64_t pos, column[6], total_length = 0;
+	int64_t num_seq = 0;
+	int k, first, width = 1, mapped, ret = E_SUCCESS;
+
+	if ( !o_states || !o_logP || !filename )
+		return E_PARAMETER;
+	*o_states = 0;
+	*o_logP = 0;
+	if ( ( ret = hmmp_file_map ( filename, &base, &size, &mapped ) ) )
+		return ret;
+	header = (const hmmp_Results_Header*) base;
+	if ( size < sizeof ( hmmp_Results_Header ) || header->magic != HMMP_RESULTS_MAGIC ||
+		 header->version != HMMP_RESULTS_VERSION )
+		ret = E_FILE_FORMAT;
+	// first pass over the batch headers: validate and size the results
+	for ( pos = sizeof ( hmmp_Results_Header ) ; ret == E_SUCCESS && pos < size ; pos += batch->batch_bytes ){
+		batch = (const hmmp_Results_Batch*) ( (const unsigned char*) base + pos );
+		if ( size - pos < sizeof ( hmmp_Results_Batch ) || batch->num_seq < 1 ||
+			 batch->content < HMMP_RESULTS_LOGP || batch->content > HMMP_RESULTS_STATES_RLE ||
+			 ( batch->width != 0 && batch->width != 1 && batch->width != 2 && batch->width != 4 ) ||
+			 ( batch->content != HMMP_RESULTS_LOGP && !batch->width ) ||
+			 batch->batch_bytes % HMMP_ALIGNMENT || batch->batch_bytes > size - pos ){
+			ret = E_FILE_FORMAT;
 			break;
-		if ( fscanf(file,"\n\n") == EOF ){
-			flag_broken = -1;
+		}
+		hmmp_results_layout ( batch->num_seq, column );
+		if ( column[5] + batch->states_bytes > batch->batch_bytes ){
+			ret = E_FILE_FORMAT;
 			break;
 		}
+		lengths = (const int32_t*) ( (const unsigned char*) batch + column[1] );
+		for ( k = 0 ; k < batch->num_seq ; ++k ){
+			if ( lengths[k] < 0 || ( batch->content == HMMP_RESULTS_LOGP && lengths[k] ) )
+				ret = E_FILE_FORMAT;
+			total_length += (uint64_t) lengths[k];
+		}
+		num_seq += batch->num_seq;
+		if ( width < batch->width )
+			width = batch->width;
 	}
-	fclose(file);
-	if ( flag_broken == 1 || flag_broken == 2 || flag_broken == -1){
-		num_seq = i;
-		if ( flag_broken == -1 )
-			++num_seq;
-		for ( i = 0 ; i < num_seq ; ++i ){
-			free ( sequences[i].sequence );
-			sequences[i].seq_id = -1;
+	if ( ret == E_SUCCESS && ( num_seq < 1 || num_seq > INT_MAX ) )
+		ret = E_FILE_FORMAT;
+	if ( ret == E_SUCCESS &&
+		 ( !(corpus = hmmp_create_corpus_typed ( (int) num_seq, total_length,
+								width == 1 ? HMMP_SYMBOLS_UINT8 : width == 2 ?
+								HMMP_SYMBOLS_UINT16 : HMMP_SYMBOLS_INT )) ||
+		   !(logP = hmmp_create_dbl_array ( (int) num_seq )) ) )
+		ret = E_ALLOCATION;
+	// second pass: the views of all sequences, then the states of each batch in parallel
+	for ( pos = sizeof ( hmmp_Results_Header ) ; ret == E_SUCCESS && pos < size ; pos += batch->batch_bytes ){
+		const int32_t *ids, *cards;
+		const uint64_t *offsets;
+		int fail = 0;
+		batch = (const hmmp_Results_Batch*) ( (const unsigned char*) base + pos );
+		hmmp_results_layout ( batch->num_seq, column );
+		p = (const unsigned char*) batch;
+		ids = (const int32_t*) ( p + column[0] );
+		lengths = (const int32_t*) ( p + column[1] );
+		cards = (const int32_t*) ( p + column[2] );
+		offsets = (const uint64_t*) ( p + column[4] );
+		first = corpus->num_seq;
+		memcpy ( logP + first, p + column[3], batch->num_seq * sizeof ( double ) );
+		for ( k = 0 ; k < batch->num_seq ; ++k )
+			if ( offsets[k] > offsets[k+1] || offsets[k+1] > batch->states_bytes ||
+				 !hmmp_corpus_add_sequence ( corpus, ids[k], lengths[k], cards[k] ) ){
+				ret = E_FILE_FORMAT;
+				break;
+			}
+		if ( ret )
+			break;
+#pragma omp parallel for num_threads(HMMP_NUM_THREADS) schedule(dynamic,16) reduction(|:fail)
+		for ( k = 0 ; k < batch->num_seq ; ++k ){
+			hmmp_Sequence *seq = corpus->seq_arr + first + k;
+			const unsigned char *q = p + column[5] + offsets[k], *q_end = p + column[5] + offsets[k+1];
+			uint32_t run;
+			int t = 0, state;
+			while ( t < seq->length && !fail ){
+				if ( q_end - q < batch->width + ( batch->content == HMMP_RESULTS_STATES_RLE ?
+												  (int) sizeof ( run ) : 0 ) ){
+					fail = 1;
+					break;
+				}
+				state = hmmp_results_get ( q, batch->width );
+				q += batch->width;
+				run = 1;
+				if ( batch->content == HMMP_RESULTS_STATES_RLE ){
+					memcpy ( &run, q, sizeof ( run ) );
+					q += sizeof ( run );
+					if ( !run || run > (uint32_t) ( seq->length - t ) ){
+						fail = 1;
+						break;
+					}
+				}
+				for ( ; run ; --run, ++t ){
+					if ( corpus->symbol_type == HMMP_SYMBOLS_UINT8 )
+						seq->symbols[t] = (uint8_t) state;
+					else if ( corpus->symbol_type == HMMP_SYMBOLS_UINT16 )
+						( (uint16_t*) seq->symbols )[t] = (uint16_t) state;
+					else
+						seq->sequence[t] = state;
+				}
+			}
 		}
-		free ( sequences );
-		if ( flag_broken == 2 )
-			return E_ALLOCATION;
-		return E_FILE_FORMAT;
+		if ( fail )
+			ret = E_FILE_FORMAT;
 	}
-	*addr_seqp = sequences;
-	return num_seq;
+	hmmp_file_unmap ( base, size, mapped );
+	if ( ret ){
+		if ( corpus ) hmmp_delete_corpus ( corpus );
+		if ( logP ) hmmp_delete_dbl_array ( logP );
+		return ret;
+	}
+	*o_states = corpus;
+	*o_logP = logP;
+	return (int) num_seq;
 }
 
-
 int hmmp_save_real ( char *filename, double *data, int data_count, int val_per_line )
 {
 	FILE *file1;
-	int i;
+	int ret;
 	if(!data || !filename)
 		return E_PARAMETER;
+	if ( val_per_line < 1 || data_count < 0 )
+		return E_ARGUMENT;
 	if(!(file1 = fopen ( filename , "w" )))
 		return E_FILE_OPEN;
-
-	for ( i = 0 ; i < data_count ; ++i ){
-		fprintf(file1, "%.*E ", 17, data[i] );
-		if(!((i+1) % val_per_line ))
-			fprintf(file1, "\n");
-	}
-	fclose(file1);
-	return E_SUCCESS;
+	ret = hmmp_write_doubles ( file1, data, data_count, val_per_line );
+	if ( fclose(file1) && ret == E_SUCCESS )
+		ret = E_FILE_WRITE;
+	return ret;
 }
 
 int hmmp_load_real ( double *load_to, char *filename, int max_count )
@@ -339,4 +2014,144 @@ int hmmp_load_int ( int *load_to, char *filename, int max_count )
 	}
 	fclose(file1);
 	return i;
-}
\ No newline at end of file
+}
+
+int hmmp_save_bw_stats ( char *filename, hmmp_Bw_Stats *stats )
+{
+	FILE *file;
+	void *blob;
+	size_t size;
+	int ret = E_SUCCESS;
+	if ( !filename || !stats )
+		return E_PARAMETER;
+	size = hmmp_bw_stats_blob_size ( stats );
+	if ( !(blob = malloc ( size )) )
+		return E_ALLOCATION;
+	hmmp_bw_stats_serialize ( stats, blob );
+	if(!(file = fopen ( filename , "wb" ))){
+		free ( blob );
+		return E_FILE_OPEN;
+	}
+	if ( fwrite ( blob, 1, size, file ) != size )
+		ret = E_FILE_WRITE;
+	if ( fclose ( file ) )
+		ret = E_FILE_WRITE;
+	free ( blob );
+	return ret;
+}
+
+int hmmp_load_bw_stats ( hmmp_Bw_Stats **o_stats, char *filename )
+{
+	FILE *file;
+	void *blob;
+	uint64_t size;
+	int ret;
+	if ( !o_stats || !filename )
+		return E_PARAMETER;
+	*o_stats = 0;
+	if(!(file = fopen ( filename , "rb" )))
+		return E_FILE_OPEN;
+	if ( hmmp_file_size ( file, &size ) ){
+		fclose ( file );
+		return E_FILE_READ;
+	}
+	if ( size > SIZE_MAX || !(blob = malloc ( size ? (size_t) size : 1 )) ){
+		fclose ( file );
+		return E_ALLOCATION;
+	}
+	if ( fread ( blob, 1, (size_t) size, file ) != size )
+		ret = E_FILE_READ;
+	else
+		ret = hmmp_bw_stats_deserialize ( o_stats, blob, size );
+	fclose ( file );
+	free ( blob );
+	return ret;
+}
+
+int hmmp_save_checkpoint ( char *filename, hmmp_Model *model, int step, int converged )
+{
+	FILE *file;
+	char *tmp_name;
+	unsigned int header[8];
+	size_t n_times_n, n_times_m, len;
+	int ret = E_SUCCESS;
+	if ( !filename || !model )
+		return E_PARAMETER;
+	len = strlen ( filename );
+	if ( !(tmp_name = (char*) malloc ( len + 5 )) )
+		return E_ALLOCATION;
+	memcpy ( tmp_name, filename, len );
+	memcpy ( tmp_name + len, ".tmp", 5 );
+	if(!(file = fopen ( tmp_name , "wb" ))){
+		free ( tmp_name );
+		return E_FILE_OPEN;
+	}
+	header[0] = HMMP_CKPT_MAGIC;
+	header[1] = HMMP_CKPT_VERSION;
+	header[2] = model->num_states;
+	header[3] = model->num_symbols;
+	header[4] = step;
+	header[5] = converged ? 1 : 0;
+	header[6] = model->model_id;
+	header[7] = 0;
+	n_times_n = (size_t) model->num_states * model->num_states;
+	n_times_m = (size_t) model->num_states * model->num_symbols;
+	if ( fwrite ( header, sizeof ( header ), 1, file ) != 1 ||
+		 fwrite ( &model->prior, sizeof ( double ), 1, file ) != 1 ||
+		 fwrite ( model->initial, sizeof ( double ), model->num_states, file ) != (size_t) model->num_states ||
+		 fwrite ( model->transition, sizeof ( double ), n_times_n, file ) != n_times_n ||
+		 fwrite ( model->emission, sizeof ( double ), n_times_m, file ) != n_times_m )
+		ret = E_FILE_WRITE;
+	if ( fclose ( file ) )
+		ret = E_FILE_WRITE;
+	if ( ret == E_SUCCESS && rename ( tmp_name, filename ) ){
+		// some platforms do not replace an existing file on rename
+		remove ( filename );
+		if ( rename ( tmp_name, filename ) )
+			ret = E_FILE_WRITE;
+	}
+	if ( ret != E_SUCCESS )
+		remove ( tmp_name );
+	free ( tmp_name );
+	return ret;
+}
+
+int hmmp_load_checkpoint ( hmmp_Model *model, char *filename, int *o_step, int *o_converged )
+{
+	FILE *file;
+	unsigned int header[8];
+	double prior;
+	size_t n_times_n, n_times_m;
+	int ret = E_SUCCESS;
+	if ( !model || !filename || !o_step || !o_converged )
+		return E_PARAMETER;
+	if(!(file = fopen ( filename , "rb" )))
+		return E_FILE_OPEN;
+	if ( fread ( header, sizeof ( header ), 1, file ) != 1 ||
+		 fread ( &prior, sizeof ( double ), 1, file ) != 1 ){
+		fclose ( file );
+		return E_FILE_READ;
+	}
+	if ( header[0] != HMMP_CKPT_MAGIC || header[1] != HMMP_CKPT_VERSION ){
+		fclose ( file );
+		return E_FILE_FORMAT;
+	}
+	if ( header[2] != (unsigned) model->num_states || header[3] != (unsigned) model->num_symbols ){
+		fclose ( file );
+		return E_ARGUMENT;
+	}
+	n_times_n = (size_t) model->num_states * model->num_states;
+	n_times_m = (size_t) model->num_states * model->num_symbols;
+	if ( fread ( model->initial, sizeof ( double ), model->num_states, file ) != (size_t) model->num_states ||
+		 fread ( model->transition, sizeof ( double ), n_times_n, file ) != n_times_n ||
+		 fread ( model->emission, sizeof ( double ), n_times_m, file ) != n_times_m )
+		ret = E_FILE_FORMAT;
+	fclose ( file );
+	if ( ret != E_SUCCESS )
+		return ret;
+	model->prior = prior;
+	model->model_id = header[6];
+	*o_step = header[4];
+	*o_converged = header[5];
+	return E_SUCCESS;
+}
@@ -24,13 +24,16 @@
 *	The layout format in the files is explained in [File Format](@ref fileformat).
 *	There are available functions for: saving/loading - multiple models, multiple sequences,
 *	real number data, integer data.
+*	Model libraries can also be stored in a binary format which is mapped and used in place,
+*	see hmmp_map_models().
 */
 #include "hmmp_datatypes.h"
 
 /// Save multiple models in one file
 /** 
 *	If file does not exist it will be created. If the file exist it's contents will be
-*	discarded!
+*	discarded! The parameters are written with the fewest digits that read back exactly
+*	( see hmmp_format_double() ).
 *
 *	@param[in]	filename String containing the file name and relative location
 *	@param[in]	arr_models Address of an existing array of models
@@ -42,6 +45,11 @@ int hmmp_save_models ( char *filename, hmmp_Model *arr_models, int num_models );
 
 /// Load multiple models from one file
 /** 
+*	Reads both the text format of hmmp_save_models() and the binary format of
+*	hmmp_save_models_binary(). The models are copied to memory owned by the caller.
+*	Text files are parsed with HMMP_NUM_THREADS threads, one model at a time each, and
+*	independently of the locale.
+*
 *	@param[out]	arr_models Address of uninitialized pointer designated to hold 
 *							the address of the resulting array of models
 *	@param[in]	filename String containing the name and relative location of the file
@@ -51,6 +59,44 @@ int hmmp_save_models ( char *filename, hmmp_Model *arr_models, int num_models );
 */
 int hmmp_load_models ( hmmp_Model **arr_models, char *filename, int max_num  );
 
+/// Save multiple models in one binary file
+/** 
+*	If file does not exist it will be created. If the file exist it's contents will be
+*	discarded! The parameters are stored in native byte order, aligned so that the file
+*	can be mapped and used in place by hmmp_map_models(). hmmp_load_models() reads this
+*	format as well.
+*
+*	@param[in]	filename String containing the file name and relative location
+*	@param[in]	arr_models Address of an existing array of models
+*	@param[in]	num_models Number of models in the array
+*	@return @ref hmmp_Error Error code.
+*	@see [File format and layout](@ref fileformatbinmodels)
+*/
+int hmmp_save_models_binary ( char *filename, hmmp_Model *arr_models, int num_models );
+
+/// Map a binary model file and use the models in place
+/** 
+*	The file is mapped in memory and the parameters of the models point directly into
+*	the mapping, so opening the file takes the same time regardless of its size and the
+*	pages are read only when the models are used. The mapping is private, the models
+*	can be modified in memory without changing the file.
+*	Use hmmp_unmap_models() to release the models and the mapping. The models must not
+*	be deleted with hmmp_delete_model() or hmmp_delete_arr_models().
+*
+*	@param[out]	o_map Address of a pointer to receive the address of the mapped models
+*	@param[in]	filename String containing the name and relative location of the file
+*	@return Number of models in the file or @ref hmmp_Error Error code.
+*	@see [File format and layout](@ref fileformatbinmodels)
+*/
+int hmmp_map_models ( hmmp_Model_Map **o_map, char *filename );
+
+/// Release the models of hmmp_map_models() and their file mapping
+/** 
+*	@param[in]	map Address of the mapped models
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_unmap_models ( hmmp_Model_Map *map );
+
 /// Save multiple sequences in one file
 /** 
 *	If file does not exist it will be created. If the file exist it's contents will be
@@ -65,6 +111,11 @@ int hmmp_save_sequences ( char *filename, hmmp_Sequence *arr_seq, int num_seq );
 
 /// Load multiple sequences from one file
 /** 
+*	Reads both the text format of hmmp_save_sequences() and the packed binary format of
+*	hmmp_save_corpus_binary(). The symbols are read directly into one allocation per
+*	sequence, text files with HMMP_NUM_THREADS threads. Delete the sequences with
+*	hmmp_delete_arr_seq().
+*
 *	@param[out]	addr_seqp Address of uninitialized pointer designated to hold the address of 
 *						the resulting array of sequences
 *	@param[in]	filename String containing the name and relative location of the file
@@ -74,15 +125,230 @@ int hmmp_save_sequences ( char *filename, hmmp_Sequence *arr_seq, int num_seq );
 */
 int hmmp_load_sequences ( hmmp_Sequence** addr_seqp, char *filename, int max_num );
 
-/// Save real numbered data in 10-base scientific notation to a file.
+/// Load multiple sequences from one file into a corpus
+/** 
+*	Reads the same file formats as hmmp_load_sequences(), but the symbols of all sequences
+*	are stored in one arena ( see hmmp_Corpus ) instead of one allocation per sequence.
+*	This is the recommended way to load large numbers of sequences.
+*	The sequences can be used as an array through corpus->seq_arr.
+*	The symbols of text files are parsed with HMMP_NUM_THREADS threads, independently of
+*	the locale.
+*	Delete the corpus with hmmp_delete_corpus().
+*
+*	@param[out]	o_corpus Address of a pointer to receive the address of the new corpus
+*	@param[in]	filename String containing the name and relative location of the file
+*	@param[in]	max_num Maximum number of sequences to load from the file ( 0 for all )
+*	@return Number of sequences loaded or @ref hmmp_Error Error code.
+*	@see [File format and layout](@ref fileformatsequences)
+*/
+int hmmp_load_corpus ( hmmp_Corpus **o_corpus, char *filename, int max_num );
+
+/// Save multiple sequences in one packed binary file
 /** 
 *	If file does not exist it will be created. If the file exist it's contents will be
-*	discarded!
+*	discarded! The symbols are stored with the smallest width allowed by the largest
+*	cardinality ( or symbol ) of all sequences: bit-packed for up to 2, 4 or 16 symbols,
+*	8 or 16 bit integers up to 256 or 65536 symbols, 32 bits otherwise. When the runs of
+*	equal symbols of hmmp_rle_encode() take fewer bytes the symbols are stored as runs.
+*	The file can be mapped and read in place by hmmp_map_corpus(), hmmp_load_corpus() and
+*	hmmp_load_sequences() read it as well.
+*
+*	@param[in]	filename String containing the file name and relative location
+*	@param[in]	arr_seq Address of an existing array of sequences
+*	@param[in]	num_seq Number of sequences in the array
+*	@return @ref hmmp_Error Error code. E_ARGUMENT for negative symbols, E_SEQUENCE if a
+*			symbol exceeds the cardinality of its sequence ( the file is written ).
+*	@see [File format and layout](@ref fileformatbinsequences)
+*/
+int hmmp_save_corpus_binary ( char *filename, hmmp_Sequence *arr_seq, int num_seq );
+
+/// Map a packed binary sequence file and read the symbols in place
+/** 
+*	The file is mapped in memory and all the arrays of the corpus point directly into the
+*	mapping, so opening the file takes the same time regardless of the number of symbols.
+*	The sequence table is checked for consistency, the symbols are not read. Use
+*	hmmp_unmap_corpus() to release the mapping.
+*
+*	@param[out]	o_corpus Address of a pointer to receive the address of the mapped corpus
+*	@param[in]	filename String containing the name and relative location of the file
+*	@return Number of sequences in the file or @ref hmmp_Error Error code.
+*	@see [File format and layout](@ref fileformatbinsequences)
+*/
+int hmmp_map_corpus ( hmmp_Packed_Corpus **o_corpus, char *filename );
+
+/// Release a corpus mapped with hmmp_map_corpus()
+/** 
+*	@param[in]	corpus Address of the mapped corpus
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_unmap_corpus ( hmmp_Packed_Corpus *corpus );
+
+/// Read one symbol of a packed corpus
+/** 
+*	No bounds are checked. A corpus stored as runs is decoded from the start of the
+*	sequence, use hmmp_packed_unpack() to read more than a few symbols.
+*
+*	@param[in]	corpus Address of the mapped corpus
+*	@param[in]	k Index of the sequence
+*	@param[in]	t Time step in the sequence
+*	@return The symbol, E_FILE_FORMAT if the runs of the sequence are broken.
+*/
+int hmmp_packed_symbol ( hmmp_Packed_Corpus *corpus, int k, int t );
+
+/// Unpack consecutive symbols of one sequence of a packed corpus
+/** 
+*	Use this to feed the algorithms, which take the symbols as integers, one sequence or
+*	one window of a sequence at a time.
+*
+*	@param[in]	corpus Address of the mapped corpus
+*	@param[in]	k Index of the sequence
+*	@param[in]	t_begin First time step to unpack
+*	@param[in]	count Number of symbols to unpack
+*	@param[out]	o_symbols Address of an existing array of at least 'count' integers
+*	@return @ref hmmp_Error Error code. E_ARGUMENT if the range is outside the sequence,
+*			E_FILE_FORMAT if the runs of the sequence are broken.
+*/
+int hmmp_packed_unpack ( hmmp_Packed_Corpus *corpus, int k, int t_begin, int count,
+						 int_array *o_symbols );
+
+/// Build an index of a sequence file by seq_id
+/** 
+*	The index is a small binary file with the position of every sequence of the file,
+*	sorted by seq_id, for hmmp_load_sequences_by_id(). Text files are scanned once in
+*	blocks, only the headers of the records are parsed. For packed binary files the index
+*	is built from the sequence table. Rebuild the index whenever the file changes.
+*
+*	@param[in]	filename String containing the name and relative location of the sequence file
+*	@param[in]	index_filename String containing the name and relative location of the
+*				index file to create
+*	@return Number of sequences indexed or @ref hmmp_Error Error code.
+*	@see [File format and layout](@ref fileformatindex)
+*/
+int hmmp_build_sequence_index ( char *filename, char *index_filename );
+
+/// Load the sequences with the given seq_ids from a file
+/** 
+*	Only the index and the requested records are read, so a few sequences can be fetched
+*	from a very large file. The sequences are stored in the corpus in the order of
+*	'seq_ids', requested ids which are not in the file are skipped. If a seq_id occurs more
+*	than once in the file, its first sequence is loaded. The size of the file is checked
+*	against the index, E_FILE_FORMAT is returned for a stale index.
+*
+*	@param[out]	o_corpus Address of a pointer to receive the address of the new corpus
+*	@param[in]	filename String containing the name and relative location of the sequence file
+*	@param[in]	index_filename Index of the file built by hmmp_build_sequence_index()
+*	@param[in]	seq_ids Array of the seq_ids to load
+*	@param[in]	num_ids Number of seq_ids in the array
+*	@return Number of sequences loaded or @ref hmmp_Error Error code.
+*/
+int hmmp_load_sequences_by_id ( hmmp_Corpus **o_corpus, char *filename, char *index_filename,
+								int *seq_ids, int num_ids );
+
+/// Open a sequence file for reading a chunk at a time
+/** 
+*	Reads both the text format of hmmp_save_sequences() and the packed binary format of
+*	hmmp_save_corpus_binary(). Use hmmp_read_sequence_chunk() to read the sequences and
+*	hmmp_close_sequence_stream() to close the file.
+*
+*	@param[out]	o_stream Address of a pointer to receive the address of the new stream
+*	@param[in]	filename String containing the name and relative location of the file
+*	@return Number of sequences in the file or @ref hmmp_Error Error code.
+*	@see hmmp_evaluate_file()
+*/
+int hmmp_open_sequence_stream ( hmmp_Sequence_Stream **o_stream, char *filename );
+
+/// Read the next chunk of sequences of a stream
+/** 
+*	The chunk is cleared ( hmmp_corpus_clear() ) and filled with the next sequences of the
+*	file, as long as their total length does not exceed 'max_length'. A chunk always holds
+*	at least one sequence, even a longer one. Reusing the same chunk keeps the memory
+*	bounded by the largest chunk read.
+*
+*	@param[in,out] stream	The stream to read from
+*	@param[in,out] chunk	An existing corpus to receive the sequences
+*	@param[in]	max_length	Maximum total number of symbols of the chunk
+*	@return Number of sequences read, 0 at the end of the file, or @ref hmmp_Error Error code.
+*/
+int hmmp_read_sequence_chunk ( hmmp_Sequence_Stream *stream, hmmp_Corpus *chunk,
+							   size_t max_length );
+
+/// Create a sequence file for writing a chunk at a time
+/** 
+*	The file has the text format of hmmp_save_sequences() and announces 'num_seq'
+*	sequences, which are written with hmmp_write_sequence_chunk(). Close the file with
+*	hmmp_close_sequence_stream().
+*
+*	@param[out]	o_stream Address of a pointer to receive the address of the new stream
+*	@param[in]	filename String containing the name and relative location of the file
+*	@param[in]	num_seq	 Number of sequences the file will hold
+*	@return @ref hmmp_Error Error code.
+*	@see hmmp_decode_file()
+*/
+int hmmp_create_sequence_stream ( hmmp_Sequence_Stream **o_stream, char *filename, int num_seq );
+
+/// Write the next chunk of sequences to a stream
+/** 
+*	The sequences are appended as hmmp_save_sequences() writes them. E_SEQUENCE is returned,
+*	after writing, if a symbol is not smaller than the cardinality of its sequence.
+*
+*	@param[in,out] stream	A stream of hmmp_create_sequence_stream()
+*	@param[in]	arr_seq		Address of an array of sequences
+*	@param[in]	num_seq		Number of sequences in the array
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_write_sequence_chunk ( hmmp_Sequence_Stream *stream, hmmp_Sequence *arr_seq, int num_seq );
+
+/// Close a stream opened with hmmp_open_sequence_stream() or hmmp_create_sequence_stream()
+/** 
+*	A written stream returns E_FILE_FORMAT if it holds fewer sequences than announced.
+*
+*	@param[in]	stream Address of the stream
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_close_sequence_stream ( hmmp_Sequence_Stream *stream );
+
+/// Append decode or evaluate results to a binary results file
+/** 
+*	Writes one batch of results in the columnar format described in @ref fileformatresults,
+*	the file is created if it does not exist. For results of hmmp_decode() 'arr_seq' are
+*	the state sequences, for results of hmmp_evaluate_sequences() with HMMP_RESULTS_LOGP
+*	they are the evaluated sequences, only their seq_id and cardinality are kept.
+*
+*	@param[in]	filename	String containing the name and relative location of the file
+*	@param[in]	arr_seq		Address of an array of sequences
+*	@param[in]	logP		Logarithmic probability of each sequence
+*	@param[in]	num_seq		Number of sequences in the array
+*	@param[in]	content		HMMP_RESULTS_LOGP, HMMP_RESULTS_STATES or HMMP_RESULTS_STATES_RLE
+*	@return @ref hmmp_Error Error code. E_ARGUMENT for states of type HMMP_SYMBOLS_RLE.
+*	@see hmmp_load_results()
+*/
+int hmmp_append_results ( char *filename, hmmp_Sequence *arr_seq, double *logP, int num_seq,
+						  int content );
+
+/// Load all batches of a binary results file
+/** 
+*	The state sequences of all batches are loaded into one corpus, in the order of the
+*	file, with the symbol type of the widest batch. Results without states have length 0.
+*	Delete the results with hmmp_delete_corpus() and hmmp_delete_dbl_array().
+*
+*	@param[out]	o_states	Address of a pointer to receive the corpus of state sequences
+*	@param[out]	o_logP		Address of a pointer to receive the logarithmic probabilities
+*	@param[in]	filename	String containing the name and relative location of the file
+*	@return Number of results or @ref hmmp_Error Error code.
+*	@see hmmp_append_results()
+*/
+int hmmp_load_results ( hmmp_Corpus **o_states, dbl_array **o_logP, char *filename );
+
+/// Save real numbered data in 10-base notation to a file.
+/** 
+*	If file does not exist it will be created. If the file exist it's contents will be
+*	discarded! Each value is written with the fewest digits that read back exactly
+*	( see hmmp_format_double() ). Large arrays are formatted with HMMP_NUM_THREADS threads.
 *
 *	@param[in]	filename String containing the file name and relative location
 *	@param[in]	data Address of an existing array of real numbers
 *	@param[in]	data_count Number of elements/values in the array
-*	@param[in] val_per_line Number of elements per line to be printed in the file
+*	@param[in] val_per_line Number of elements per line to be printed in the file ( positive )
 *	@return @ref hmmp_Error Error code.
 *	@see [File format and layout](@ref fileformatdata)
 */
@@ -123,4 +389,58 @@ int hmmp_save_int ( char *filename, int *data, int data_count, int val_per_line
 */
 int hmmp_load_int ( int *load_to, char *filename, int max_count );
 
+/// Save the expected counts of the Baum-Welch algorithm to a binary file.
+/** 
+*	If file does not exist it will be created. If the file exist it's contents will be
+*	discarded! The file contains the blob created by hmmp_bw_stats_serialize().
+*
+*	@param[in]	filename String containing the file name and relative location
+*	@param[in]	stats Address of the counts to be saved
+*	@return @ref hmmp_Error Error code.
+*	@see hmmp_bwstats.h
+*/
+int hmmp_save_bw_stats ( char *filename, hmmp_Bw_Stats *stats );
+
+/// Load the expected counts of the Baum-Welch algorithm from a binary file.
+/** 
+*	Use hmmp_delete_bw_stats() to delete the resulting container.
+*
+*	@param[out]	o_stats Address of uninitialized pointer designated to hold the address
+*						of the loaded counts
+*	@param[in]	filename String containing the name and relative location of the file
+*	@return @ref hmmp_Error Error code.
+*	@see hmmp_bwstats.h
+*/
+int hmmp_load_bw_stats ( hmmp_Bw_Stats **o_stats, char *filename );
+
+/// Save a checkpoint of a learning process to a binary file.
+/** 
+*	The checkpoint holds the model parameters and prior, the number of completed steps and
+*	whether the learning has converged. It is written to a temporary file ( the file name
+*	with ".tmp" appended ) which then replaces the destination, so an interrupted write
+*	never damages the previous checkpoint.
+*
+*	@param[in]	filename String containing the file name and relative location
+*	@param[in]	model Address of the model being trained
+*	@param[in]	step Number of completed learning steps
+*	@param[in]	converged Non-zero if the learning has converged
+*	@return @ref hmmp_Error Error code.
+*	@see hmmp_baum_welch_checkpoint()
+*/
+int hmmp_save_checkpoint ( char *filename, hmmp_Model *model, int step, int converged );
+
+/// Load a checkpoint of a learning process from a binary file.
+/** 
+*	The model receives the saved parameters, prior and model_id. It must have the same
+*	number of states and symbols as the saved model.
+*
+*	@param[in,out] model Address of an existing model to receive the parameters
+*	@param[in]	filename String containing the name and relative location of the file
+*	@param[out]	o_step Address of a variable to receive the number of completed steps
+*	@param[out]	o_converged Address of a variable to receive the convergence flag
+*	@return @ref hmmp_Error Error code. E_ARGUMENT if the model dimensions do not match.
+*	@see hmmp_baum_welch_checkpoint()
+*/
+int hmmp_load_checkpoint ( hmmp_Model *model, char *filename, int *o_step, int *o_converged );
+
 #endif
\ No newline at end of file
@@ -23,48 +23,72 @@
 #include "hmmp_dataproc.h"
 #include "hmmp_alg.h"
 #include "hmmp_algwrap.h"
+#include "hmmp_generate.h"
+#include "hmmp_bwstats.h"
+#include "hmmp_file.h"
+#include "hmmp_workspace.h"
+#include "hmmp_numa.h"
+#include "hmmp_plan.h"
+#include "hmmp_numconv.h"
+#include <stdio.h>
 #include <malloc.h>
+#include <string.h>
+#include <math.h>
 #include <omp.h>
 
 
 int hmmp_decode(hmmp_Model model, hmmp_Sequence *observ_array, int num_obs, 
 				hmmp_Sequence **o_state_array, dbl_array **o_logPS )
 {
-	hmmp_Model *log_model = 0;
+	hmmp_Model *log_model = 0, *local_model;
+	hmmp_Model_Replicas *replicas = 0;
 	hmmp_Sequence *states_arr = 0;
 	dbl_array *arr_prob_state_seq = 0;
-	int_matrix *backtrack = 0; // T x N matrix
-	dbl_matrix *mu = 0;	// 2 x N matrix
-	int k , max_length = 0;
+	int_array *lengths;
+	hmmp_Workspace *ws; // T x N backtrack and 2 x N mu matrices
+	hmmp_Plan plan;
+	size_t total_length = 0;
+	int k , max_length = 0, ws_length;
 	int e_overflow;
 	char fail_flag = 0;
 	if ( !observ_array || !o_state_array || !o_logPS )
 		return E_PARAMETER;
-	for ( k = 0 ; k < num_obs ; ++k )
+	for ( k = 0 ; k < num_obs ; ++k ){
 		if ( max_length < observ_array[k].length )
 			max_length = observ_array[k].length;
+		total_length += observ_array[k].length;
+	}
 	e_overflow = hmmp_memop_overflow(model.num_states, max_length);
 	if (e_overflow == E_MEM_OVERFLOW_L1){
 		*o_state_array = 0;
 		*o_logPS = 0;
 		return e_overflow;
 	}
-
-	states_arr = (hmmp_Sequence *) malloc ( sizeof(hmmp_Sequence)*num_obs);
-	if ( ! states_arr ){ fail_flag = 1; goto SKIP_REST; }	
-	for ( k = 0 ; k < num_obs ; ++k ){
-		states_arr[k].sequence=hmmp_create_int_array(observ_array[k].length);
-		if(!(states_arr[k].sequence)){
-			--k;
-			for (; k >= 0 ; --k )
-				hmmp_delete_int_array( states_arr[k].sequence );
-			free ( states_arr );
-			states_arr = 0;
-			fail_flag = 1;
-			goto SKIP_REST;
-		}
+	if ((e_overflow = hmmp_plan_memory ( hmmp_get_memory_budget(), HMMP_TASK_DECODE,
+										 model.num_states, model.num_symbols, max_length,
+										 num_obs, total_length, HMMP_NUM_THREADS, &plan ))){
+		*o_state_array = 0;
+		*o_logPS = 0;
+		return e_overflow;
+	}
+	ws_length = max_length;
+	if ( plan.variant == HMMP_VARIANT_CHECKPOINT ){
+		// the checkpoints of N+1 values go to 'alfa', one segment of backtracking to 'backtrack'
+		ws_length = 2 * ( ( max_length - 1 ) / plan.interval + 1 );
+		if ( ws_length < plan.interval )
+			ws_length = plan.interval;
 	}
 
+	lengths = hmmp_create_int_array ( num_obs );
+	if ( ! lengths ){ fail_flag = 1; goto SKIP_REST; }
+	for ( k = 0 ; k < num_obs ; ++k )
+		lengths[k] = observ_array[k].length;
+	states_arr = hmmp_create_arr_seq_lengths ( num_obs, lengths, model.num_states );
+	hmmp_delete_int_array ( lengths );
+	if ( ! states_arr ){ fail_flag = 1; goto SKIP_REST; }
+	for ( k = 0 ; k < num_obs ; ++k )
+		states_arr[k].seq_id = observ_array[k].seq_id;
+
 	arr_prob_state_seq = hmmp_create_dbl_array ( num_obs );
 	if ( ! arr_prob_state_seq ){ fail_flag = 1; goto SKIP_REST;	}
 
@@ -72,38 +96,40 @@ int hmmp_decode(hmmp_Model model, hmmp_Sequence *observ_array, int num_obs,
 	if ( !log_model ){ fail_flag = 1; goto SKIP_REST; }
 
 	hmmp_model_log_param ( log_model );
+	replicas = hmmp_numa_create_replicas ( log_model );
+	if ( !replicas ){ fail_flag = 1; goto SKIP_REST; }
 
-#pragma omp parallel firstprivate ( backtrack, mu ) default(shared) num_threads(HMMP_NUM_THREADS)
+#pragma omp parallel private ( ws, local_model ) default(shared) num_threads(plan.num_threads)
 {
-	#pragma omp critical
-	{
-	#pragma omp flush ( fail_flag )
-		if (!fail_flag){
-			backtrack = hmmp_create_int_matrix ( model.num_states * max_length );
-			if ( !backtrack ) fail_flag = 1;
-			else{
-				mu = hmmp_create_dbl_matrix ( 2 * model.num_states );
-				if (!mu ) fail_flag = 1;
-			}
-		}
-	}//END OF CRITICAL SECTION
+	hmmp_numa_bind_thread ( );
+	ws = hmmp_workspace_acquire ( model.num_states, ws_length, plan.variant == HMMP_VARIANT_FULL ?
+								  HMMP_WS_VITERBI : HMMP_WS_FORWARD | HMMP_WS_VITERBI );
+	local_model = hmmp_numa_local_model ( replicas );
+	if ( !ws ){
+		#pragma omp atomic write
+		fail_flag = 1;
+	}
 	#pragma omp barrier
 	#pragma omp flush ( fail_flag )
 	if(!fail_flag){
-		#pragma omp for schedule(static)
-		for ( k = 0 ; k < num_obs ; ++k )
-			hmmp_viterbi_alg ( *log_model, observ_array[k], backtrack, 
-								mu,states_arr+k,arr_prob_state_seq+k );
+		#pragma omp for schedule(static,plan.batch_size)
+		for ( k = 0 ; k < num_obs ; ++k ){
+			if ( plan.variant == HMMP_VARIANT_FULL )
+				hmmp_viterbi_alg ( *local_model, observ_array[k], ws->backtrack, 
+									ws->mu,states_arr+k,arr_prob_state_seq+k );
+			else
+				hmmp_viterbi_checkpoint_alg ( *local_model, observ_array[k], plan.interval,
+											  ws->alfa, ws->backtrack, ws->mu, states_arr+k,
+											  arr_prob_state_seq+k );
+		}
 	}
-	#pragma omp critical
-	{
-		if ( mu ) hmmp_delete_dbl_matrix ( mu );
-		if ( backtrack ) hmmp_delete_int_array ( backtrack );
-	}//end of critical section
+	if ( ws )
+		hmmp_workspace_release ( ws );
 }//end of paralell region
 	*o_state_array = states_arr;
 	*o_logPS = arr_prob_state_seq;
 SKIP_REST:
+	if ( replicas ) hmmp_numa_delete_replicas ( replicas );
 	if ( log_model ) hmmp_delete_model ( log_model );
 
 	if ( fail_flag && arr_prob_state_seq )
@@ -121,59 +147,53 @@ SKIP_REST:
 int hmmp_evaluate_models(hmmp_Model *arr_models, int num_models, 
 						 hmmp_Sequence observ_seq, dbl_array **o_logP_arr )
 {
-	int k, max_num_states = 0;
+	int k, max_num_states = 0, max_num_symbols = 0;
 	int e_overflow;
-	dbl_array *scales = 0, *prob_arr = 0;
-	dbl_matrix *alfa = 0;
+	dbl_array *prob_arr = 0;
+	hmmp_Workspace *ws;
+	hmmp_Plan plan;
 	char fail_flag = 0;
 	if ( !arr_models || !o_logP_arr )
 		return E_PARAMETER;
-	for ( k = 0 ; k < num_models ; ++k )
+	for ( k = 0 ; k < num_models ; ++k ){
 		if ( max_num_states < arr_models[k].num_states )
 			max_num_states = arr_models[k].num_states;
+		if ( max_num_symbols < arr_models[k].num_symbols )
+			max_num_symbols = arr_models[k].num_symbols;
+	}
 	e_overflow = hmmp_memop_overflow(max_num_states, observ_seq.length);
 	if (e_overflow == E_MEM_OVERFLOW_L1){
 		*o_logP_arr = 0;
 		return e_overflow;
 	}
+	if ((e_overflow = hmmp_plan_memory ( hmmp_get_memory_budget(), HMMP_TASK_EVALUATE,
+										 max_num_states, max_num_symbols, observ_seq.length,
+										 num_models, observ_seq.length, HMMP_NUM_THREADS,
+										 &plan ))){
+		*o_logP_arr = 0;
+		return e_overflow;
+	}
 	prob_arr = hmmp_create_dbl_array ( num_models );
 	if ( ! prob_arr ){
 		return E_ALLOCATION;
 	}
-#pragma omp parallel private(k) firstprivate(alfa,scales) default(shared) num_threads(HMMP_NUM_THREADS)
+#pragma omp parallel private(k,ws) default(shared) num_threads(plan.num_threads)
 {
-	#pragma omp critical 
-	{
-		#pragma omp flush ( fail_flag )
-		if(!fail_flag){
-			alfa = hmmp_create_dbl_matrix(observ_seq.length*max_num_states);
-			if( ! alfa )
-				fail_flag = 1; 
-			else{
-				scales = hmmp_create_dbl_array ( observ_seq.length );
-				if(!scales)
-					fail_flag = 1; 
-			}
-		}
+	hmmp_numa_bind_thread ( );
+	ws = hmmp_workspace_acquire ( max_num_states, 1, HMMP_WS_LIKELIHOOD );
+	if ( !ws ){
+		#pragma omp atomic write
+		fail_flag = 1;
 	}
 	#pragma omp barrier
 	#pragma omp flush ( fail_flag )
 	if(!fail_flag){
-		#pragma omp for schedule(static)
+		#pragma omp for schedule(static,plan.batch_size)
 		for ( k = 0 ; k < num_models ; ++k )
-		{
-			hmmp_forward_alg(arr_models[k],observ_seq,alfa,scales);
-			prob_arr[k] = hmmp_log_of_divisors(scales,observ_seq.length);
-		}
+			hmmp_forward_likelihood_alg ( arr_models[k], observ_seq, ws->mu, prob_arr+k );
 	}
-	#pragma omp critical
-	{
-		if ( alfa ) 
-			hmmp_delete_dbl_matrix(alfa);
-		if ( scales ) 
-			hmmp_delete_dbl_array(scales);
-	}
-
+	if ( ws )
+		hmmp_workspace_release ( ws );
 }
 	if ( fail_flag ){
 		*o_logP_arr = 0;
@@ -189,55 +209,59 @@ int hmmp_evaluate_sequences(hmmp_Model model, hmmp_Sequence *observ_arr, int num
 {
 	int k, max_length = 0;
 	int e_overflow;
-	dbl_array *scales = 0, *prob_arr = 0;
-	dbl_matrix *alfa = 0;
+	dbl_array *prob_arr = 0;
+	hmmp_Workspace *ws;
+	hmmp_Model *local_model;
+	hmmp_Model_Replicas *replicas;
+	hmmp_Plan plan;
+	size_t total_length = 0;
 	char fail_flag = 0;
 	if ( ! observ_arr || !o_logP_arr )
 		return E_PARAMETER;
-	for ( k = 0 ; k < num_obs ; ++k )
+	for ( k = 0 ; k < num_obs ; ++k ){
 		if ( max_length < observ_arr[k].length )
 			max_length = observ_arr[k].length;
+		total_length += observ_arr[k].length;
+	}
 	if (e_overflow = hmmp_memop_overflow(model.num_states, max_length)){
 		*o_logP_arr = 0;
 		return e_overflow;
 	}
+	if ((e_overflow = hmmp_plan_memory ( hmmp_get_memory_budget(), HMMP_TASK_EVALUATE,
+										 model.num_states, model.num_symbols, max_length,
+										 num_obs, total_length, HMMP_NUM_THREADS, &plan ))){
+		*o_logP_arr = 0;
+		return e_overflow;
+	}
 	prob_arr = hmmp_create_dbl_array ( num_obs );
 	if ( ! prob_arr ){
 		return E_ALLOCATION;
 	}
-#pragma omp parallel firstprivate(alfa,scales) default(shared) num_threads(HMMP_NUM_THREADS)
+	replicas = hmmp_numa_create_replicas ( &model );
+	if ( ! replicas ){
+		hmmp_delete_dbl_array(prob_arr);
+		return E_ALLOCATION;
+	}
+#pragma omp parallel private(ws,local_model) default(shared) num_threads(plan.num_threads)
 {
-	#pragma omp critical 
-	{
-		#pragma omp flush ( fail_flag )
-		if(!fail_flag){
-			alfa = hmmp_create_dbl_matrix(model.num_states*max_length);
-			if( ! alfa )
-				fail_flag = 1; 
-			else{
-				scales = hmmp_create_dbl_array ( max_length );
-				if(!scales)
-					fail_flag = 1; 
-			}
-		}
-	}//end of critical
+	hmmp_numa_bind_thread ( );
+	ws = hmmp_workspace_acquire ( model.num_states, 1, HMMP_WS_LIKELIHOOD );
+	local_model = hmmp_numa_local_model ( replicas );
+	if ( !ws ){
+		#pragma omp atomic write
+		fail_flag = 1;
+	}
 	#pragma omp barrier
 	#pragma omp flush ( fail_flag )
 	if(!fail_flag){
-		#pragma omp for private(k) schedule(static) nowait
-		for ( k = 0 ; k < num_obs ; ++k ){
-			hmmp_forward_alg(model,observ_arr[k],alfa,scales);
-			prob_arr[k] = hmmp_log_of_divisors(scales,observ_arr[k].length);
-		}
-	}
-	#pragma omp critical
-	{
-		if ( alfa ) 
-			hmmp_delete_dbl_matrix(alfa);
-		if ( scales ) 
-			hmmp_delete_dbl_array(scales);
+		#pragma omp for private(k) schedule(static,plan.batch_size) nowait
+		for ( k = 0 ; k < num_obs ; ++k )
+			hmmp_forward_likelihood_alg ( *local_model, observ_arr[k], ws->mu, prob_arr+k );
 	}
+	if ( ws )
+		hmmp_workspace_release ( ws );
 }//end of parallel region
+	hmmp_numa_delete_replicas ( replicas );
 	if ( fail_flag ){
 		o_logP_arr = 0;
 		hmmp_delete_dbl_array(prob_arr);
@@ -247,116 +271,786 @@ int hmmp_evaluate_sequences(hmmp_Model model, hmmp_Sequence *observ_arr, int num
 	return E_SUCCESS;
 }
 
+/* Write one line "seq_id logP" per sequence, the probability as by hmmp_format_double(),
+*  which does not depend on the locale. */
+static int hmmp_write_logp_lines ( FILE *out, hmmp_Sequence *seq_arr, dbl_array *logP,
+								   int num_seq )
+{
+	char line[16 + HMMP_DOUBLE_CHARS];
+	int k, n;
+	for ( k = 0 ; k < num_seq ; ++k ){
+		n = sprintf ( line, "%d ", seq_arr[k].seq_id );
+		n += hmmp_format_double ( line + n, logP[k] );
+		line[n++] = '\n';
+		if ( fwrite ( line, 1, n, out ) != (size_t) n )
+			return E_FILE_WRITE;
+	}
+	return E_SUCCESS;
+}
+
+int hmmp_evaluate_file ( hmmp_Model model, char *in_filename, char *out_filename,
+						 size_t chunk_length )
+{
+	hmmp_Sequence_Stream *stream;
+	hmmp_Corpus *chunk[2];
+	dbl_array *logP;
+	FILE *out;
+	int cur = 0, num_read, num_next = 0, num_done = 0, max_levels;
+	int e_eval = E_SUCCESS;
+
+	if ( !in_filename || !out_filename )
+		return E_PARAMETER;
+	if ( chunk_length < 1 )
+		return E_ARGUMENT;
+	if ( (num_read = hmmp_open_sequence_stream ( &stream, in_filename )) < 0 )
+		return num_read;
+	if(!(out = fopen ( out_filename , "w" ))){
+		hmmp_close_sequence_stream ( stream );
+		return E_FILE_OPEN;
+	}
+	chunk[0] = hmmp_create_corpus ( 1, chunk_length );
+	chunk[1] = hmmp_create_corpus ( 1, chunk_length );
+	if ( !chunk[0] || !chunk[1] )
+		num_read = E_ALLOCATION;
+	else
+		num_read = hmmp_read_sequence_chunk ( stream, chunk[0], chunk_length );
+	// one thread reads the next chunk in a background task, while the current chunk is
+	// evaluated by the nested team of hmmp_evaluate_sequences() and written out
+	max_levels = omp_get_max_active_levels();
+	omp_set_max_active_levels ( 2 );
+#pragma omp parallel num_threads(2) default(shared)
+	#pragma omp single
+	{
+	while ( num_read > 0 ){
+		#pragma omp task default(shared)
+		num_next = hmmp_read_sequence_chunk ( stream, chunk[1-cur], chunk_length );
+		e_eval = hmmp_evaluate_sequences ( model, chunk[cur]->seq_arr, num_read, &logP );
+		if ( e_eval == E_SUCCESS ){
+			e_eval = hmmp_write_logp_lines ( out, chunk[cur]->seq_arr, logP, num_read );
+			hmmp_delete_dbl_array ( logP );
+			num_done += num_read;
+		}
+		#pragma omp taskwait
+		if ( e_eval )
+			break;
+		num_read = num_next;
+		cur = 1 - cur;
+	}
+	}
+	omp_set_max_active_levels ( max_levels );
+	if ( fclose ( out ) && !e_eval )
+		e_eval = E_FILE_WRITE;
+	if ( chunk[0] ) hmmp_delete_corpus ( chunk[0] );
+	if ( chunk[1] ) hmmp_delete_corpus ( chunk[1] );
+	hmmp_close_sequence_stream ( stream );
+	if ( e_eval )
+		return e_eval;
+	if ( num_read < 0 )
+		return num_read;
+	return num_done;
+}
+
+/* Write the results of one decoded chunk and release them. */
+static int hmmp_decode_file_write ( hmmp_Sequence_Stream *states_out, FILE *logp_out,
+									hmmp_Sequence *states, dbl_array *logPS, int num_seq )
+{
+	int ret;
+	ret = hmmp_write_sequence_chunk ( states_out, states, num_seq );
+	if ( logp_out && ret == E_SUCCESS )
+		ret = hmmp_write_logp_lines ( logp_out, states, logPS, num_seq );
+	hmmp_delete_arr_seq ( states, num_seq );
+	hmmp_delete_dbl_array ( logPS );
+	return ret;
+}
+
+int hmmp_decode_file ( hmmp_Model model, char *in_filename, char *out_filename,
+					   char *logp_filename, size_t chunk_length )
+{
+	hmmp_Sequence_Stream *stream, *states_out;
+	hmmp_Corpus *chunk[2];
+	hmmp_Sequence *states[2] = { 0, 0 };
+	dbl_array *logPS[2] = { 0, 0 };
+	FILE *logp_out = 0;
+	int cur = 0, num_read, num_next = 0, num_prev = 0, num_done = 0, num_seq, max_levels;
+	int e_decode = E_SUCCESS, e_write = E_SUCCESS;
+
+	if ( !in_filename || !out_filename )
+		return E_PARAMETER;
+	if ( chunk_length < 1 )
+		return E_ARGUMENT;
+	if ( (num_seq = hmmp_open_sequence_stream ( &stream, in_filename )) < 0 )
+		return num_seq;
+	if ( ( e_write = hmmp_create_sequence_stream ( &states_out, out_filename, num_seq ) ) ){
+		hmmp_close_sequence_stream ( stream );
+		return e_write;
+	}
+	if ( logp_filename && !(logp_out = fopen ( logp_filename , "w" )) ){
+		hmmp_close_sequence_stream ( stream );
+		hmmp_close_sequence_stream ( states_out );
+		return E_FILE_OPEN;
+	}
+	chunk[0] = hmmp_create_corpus ( 1, chunk_length );
+	chunk[1] = hmmp_create_corpus ( 1, chunk_length );
+	if ( !chunk[0] || !chunk[1] )
+		num_read = E_ALLOCATION;
+	else
+		num_read = hmmp_read_sequence_chunk ( stream, chunk[0], chunk_length );
+	// three stage pipeline: while chunk k is decoded by the nested team of hmmp_decode(),
+	// chunk k+1 is read and the states of chunk k-1 are written by background tasks
+	max_levels = omp_get_max_active_levels();
+	omp_set_max_active_levels ( 2 );
+#pragma omp parallel num_threads(3) default(shared)
+	#pragma omp single
+	{
+	while ( num_read > 0 ){
+		#pragma omp task default(shared)
+		num_next = hmmp_read_sequence_chunk ( stream, chunk[1-cur], chunk_length );
+		if ( num_prev ){
+			#pragma omp task default(shared)
+			e_write = hmmp_decode_file_write ( states_out, logp_out, states[1-cur],
+											   logPS[1-cur], num_prev );
+		}
+		e_decode = hmmp_decode ( model, chunk[cur]->seq_arr, num_read, states + cur, logPS + cur );
+		#pragma omp taskwait
+		num_done += num_prev;
+		num_prev = 0;
+		if ( e_decode || e_write ){
+			if ( !e_decode ){
+				hmmp_delete_arr_seq ( states[cur], num_read );
+				hmmp_delete_dbl_array ( logPS[cur] );
+			}
+			break;
+		}
+		num_prev = num_read;
+		num_read = num_next;
+		cur = 1 - cur;
+	}
+	}
+	omp_set_max_active_levels ( max_levels );
+	// the last chunk has nothing left to overlap with
+	if ( num_prev ){
+		e_write = hmmp_decode_file_write ( states_out, logp_out, states[1-cur],
+										   logPS[1-cur], num_prev );
+		if ( !e_write )
+			num_done += num_prev;
+	}
+	if ( logp_out && fclose ( logp_out ) && !e_write )
+		e_write = E_FILE_WRITE;
+	if ( chunk[0] ) hmmp_delete_corpus ( chunk[0] );
+	if ( chunk[1] ) hmmp_delete_corpus ( chunk[1] );
+	hmmp_close_sequence_stream ( stream );
+	// an incomplete output reports E_FILE_FORMAT, the first error is returned instead
+	num_seq = hmmp_close_sequence_stream ( states_out );
+	if ( e_decode )
+		return e_decode;
+	if ( e_write )
+		return e_write;
+	if ( num_read < 0 )
+		return num_read;
+	if ( num_seq )
+		return num_seq;
+	return num_done;
+}
+
+/* Containers used by one step of the Baum-Welch algorithm. Shared by all learning entry
+*  points, so they are allocated once and reused over all steps and sequences. With
+*  checkpoints 'alfa' and 'beta' hold one segment and the '_ckpt' matrices the segment
+*  boundaries, see hmmp_bw_stats_accumulate_checkpoint_alg(). */
+typedef struct {
+	dbl_matrix *alfa, *beta, *emission_t;
+	dbl_matrix *alfa_ckpt, *beta_ckpt;
+	dbl_array *scales_a, *scales_b;
+	hmmp_Bw_Stats *stats;
+} hmmp_Bwa_Workspace;
+
+static void hmmp_bwa_delete_workspace ( hmmp_Bwa_Workspace *ws )
+{
+	if (ws->stats) hmmp_delete_bw_stats(ws->stats);
+	if (ws->beta_ckpt) hmmp_delete_large_buffer(ws->beta_ckpt);
+	if (ws->alfa_ckpt) hmmp_delete_large_buffer(ws->alfa_ckpt);
+	if (ws->scales_b) hmmp_delete_dbl_array(ws->scales_b);
+	if (ws->scales_a) hmmp_delete_dbl_array(ws->scales_a);
+	if (ws->beta) hmmp_delete_large_buffer(ws->beta);
+	if (ws->alfa) hmmp_delete_large_buffer(ws->alfa);
+	if (ws->emission_t) hmmp_delete_dbl_matrix(ws->emission_t);
+	memset ( ws, 0, sizeof ( hmmp_Bwa_Workspace ) );
+}
+
+static int hmmp_bwa_create_workspace ( hmmp_Bwa_Workspace *ws, int num_states, 
+									   int num_symbols, int max_length, int interval )
+{
+	size_t alfa_rows = max_length, beta_rows = max_length, ckpt_rows = 0;
+	memset ( ws, 0, sizeof ( hmmp_Bwa_Workspace ) );
+	if ( interval ){
+		alfa_rows = interval;
+		beta_rows = interval + 1;
+		ckpt_rows = max_length > 0 ? ( max_length - 1 ) / interval + 1 : 1;
+		if ( !(ws->alfa_ckpt = (dbl_matrix*) hmmp_create_large_buffer (
+								sizeof ( dbl_matrix ) * ckpt_rows * num_states )) ||
+			 !(ws->beta_ckpt = (dbl_matrix*) hmmp_create_large_buffer (
+								sizeof ( dbl_matrix ) * ckpt_rows * num_states )) ){
+			hmmp_bwa_delete_workspace ( ws );
+			return E_ALLOCATION;
+		}
+	}
+	if ( !(ws->alfa = (dbl_matrix*) hmmp_create_large_buffer (
+								sizeof ( dbl_matrix ) * alfa_rows * num_states )) ||
+		 !(ws->beta = (dbl_matrix*) hmmp_create_large_buffer (
+								sizeof ( dbl_matrix ) * beta_rows * num_states )) ||
+		 !(ws->emission_t = hmmp_create_dbl_matrix ( (size_t)num_symbols * num_states )) ||
+		 !(ws->scales_a = hmmp_create_dbl_array ( max_length )) ||
+		 !(ws->scales_b = hmmp_create_dbl_array ( max_length )) ||
+		 !(ws->stats = hmmp_create_bw_stats ( num_states, num_symbols )) ){
+		hmmp_bwa_delete_workspace ( ws );
+		return E_ALLOCATION;
+	}
+	return E_SUCCESS;
+}
+
+/* Training sequences of the Baum-Welch algorithm. A shallow copy of the input array with
+*  the identical sequences collapsed into one weighted entry, so they are processed once
+*  per step. The sequence data is shared with the caller's array. The counts are
+*  scattered per time step, hmmp_bw_stats_accumulate_index_alg() is not used since it
+*  was not measured faster. */
+typedef struct {
+	hmmp_Sequence *seq_arr;
+	dbl_array *weights;
+	int num_seq;
+	int max_length;
+	int interval;	// time steps between checkpoints, 0 for full storage
+} hmmp_Bwa_Corpus;
+
+static void hmmp_bwa_delete_corpus ( hmmp_Bwa_Corpus *corpus )
+{
+	if (corpus->weights) hmmp_delete_dbl_array(corpus->weights);
+	if (corpus->seq_arr) free(corpus->seq_arr);
+	memset ( corpus, 0, sizeof ( hmmp_Bwa_Corpus ) );
+}
+
+/* 'num_workspaces' is the number of hmmp_Bwa_Workspace which will share the memory budget. */
+static int hmmp_bwa_create_corpus ( hmmp_Bwa_Corpus *corpus, hmmp_Sequence *seq_arr,
+									dbl_array *weights, int num_seq, int num_states,
+									int num_symbols, int num_workspaces )
+{
+	int k, e_overflow;
+	size_t budget, total_length = 0;
+	hmmp_Plan plan;
+	memset ( corpus, 0, sizeof ( hmmp_Bwa_Corpus ) );
+	if ( num_seq < 1 )
+		return E_ARGUMENT;
+	for ( k = 0 ; k < num_seq ; ++k ){
+		// the Backward algorithm can not read coded runs
+		if ( ( weights && weights[k] < 0.0 ) || HMMP_SEQUENCE_TYPE ( seq_arr[k] ) == HMMP_SYMBOLS_RLE )
+			return E_ARGUMENT;
+		if ( corpus->max_length < seq_arr[k].length )
+			corpus->max_length = seq_arr[k].length;
+		total_length += seq_arr[k].length;
+	}
+	if ((e_overflow = hmmp_memop_overflow(num_states, corpus->max_length)))
+		return e_overflow;
+	budget = hmmp_get_memory_budget() / num_workspaces;
+	if ( hmmp_get_memory_budget() && !budget )
+		return E_MEM_BUDGET;
+	if ((e_overflow = hmmp_plan_memory ( budget, HMMP_TASK_TRAIN, num_states, num_symbols,
+										 corpus->max_length, num_seq, total_length,
+										 HMMP_NUM_THREADS, &plan )))
+		return e_overflow;
+	corpus->interval = plan.interval;
+	corpus->seq_arr = (hmmp_Sequence*) malloc ( num_seq * sizeof ( hmmp_Sequence ) );
+	corpus->weights = hmmp_create_dbl_array ( num_seq );
+	if ( !corpus->seq_arr || !corpus->weights ){
+		hmmp_bwa_delete_corpus ( corpus );
+		return E_ALLOCATION;
+	}
+	memcpy ( corpus->seq_arr, seq_arr, num_seq * sizeof ( hmmp_Sequence ) );
+	if ( weights )
+		memcpy ( corpus->weights, weights, num_seq * sizeof ( dbl_array ) );
+	else
+		hmmp_init_dbl_dataset ( corpus->weights, num_seq, 1.0 );
+	corpus->num_seq = hmmp_dedup_sequences ( corpus->seq_arr, corpus->weights, num_seq );
+	if ( corpus->num_seq < 0 ){
+		corpus->num_seq = 0;
+		hmmp_bwa_delete_corpus ( corpus );
+		return E_ALLOCATION;
+	}
+	return E_SUCCESS;
+}
+
+/* Expectation: accumulate the expected counts of all sequences for the current model.
+*  Returns the logarithmic probability of the model given all the sequences. */
+static double hmmp_bwa_expectation ( hmmp_Model *model, hmmp_Bwa_Corpus *corpus,
+									 hmmp_Bwa_Workspace *ws, int num_threads )
+{
+	int k;
+	hmmp_bw_stats_reset ( ws->stats );
+	hmmp_transpose_matrix_copy ( ws->emission_t, model->emission, model->num_states,
+								 model->num_symbols );
+	for ( k = 0 ; k < corpus->num_seq ; ++k ){
+#pragma omp parallel num_threads(num_threads) default(shared)
+		{
+		hmmp_numa_bind_thread ( );
+		if ( corpus->interval )
+			hmmp_bw_stats_accumulate_checkpoint_alg ( ws->stats, *model, corpus->seq_arr[k],
+													  ws->emission_t, corpus->weights[k],
+													  corpus->interval, ws->alfa_ckpt,
+													  ws->beta_ckpt, ws->alfa, ws->beta,
+													  ws->scales_a, ws->scales_b );
+		else
+			hmmp_bw_stats_accumulate_alg ( ws->stats, *model, corpus->seq_arr[k],
+										   corpus->weights[k], ws->alfa, ws->beta,
+										   ws->scales_a, ws->scales_b );
+		}
+	}
+	return ws->stats->logP;
+}
+
 int hmmp_baum_welch ( hmmp_Model *model,hmmp_Sequence *seq_arr, int num_seq , int max_steps, double delta_p )
 {
-	dbl_matrix *alfa = 0, *beta = 0, *gamma, *xi = 0;
-	dbl_array *scales_a = 0, *scales_b = 0;
-	dbl_matrix *a_num = 0, *b_num = 0;
-	dbl_array *a_denom = 0, *b_denom = 0, *pi_new = 0;
+	return hmmp_baum_welch_weighted ( model, seq_arr, 0, num_seq, max_steps, delta_p );
+}
 
-	int i, j, k, t, e_overflow, max_length = 0;
-	double logP_current, pi_normalize = 0.0;
-	char flag_failed = 0;
+int hmmp_baum_welch_weighted ( hmmp_Model *model, hmmp_Sequence *seq_arr, dbl_array *weights,
+							   int num_seq, int max_steps, double delta_p )
+{
+	hmmp_Bwa_Workspace ws;
+	hmmp_Bwa_Corpus corpus;
+	int t, e_corpus;
+	double logP_current;
 
 	if (!model || !seq_arr )
 		return E_PARAMETER;
-	for ( i = 0 ; i < num_seq ; ++i )
-		if ( max_length < seq_arr[i].length )
-			max_length = seq_arr[i].length;
-	if (e_overflow = hmmp_memop_overflow(model->num_states, max_length))
-		return e_overflow;
-	pi_new = hmmp_create_dbl_array ( model->num_states );
-	if ( !pi_new ) {flag_failed = 1; goto SKIP_REST; }
-	alfa = hmmp_create_dbl_matrix ( max_length * model->num_states );
-	if ( !alfa ) {flag_failed = 1; goto SKIP_REST; }
-	beta = hmmp_create_dbl_matrix ( max_length * model->num_states );
-	if ( !beta ) {flag_failed = 1; goto SKIP_REST; }
-	gamma = hmmp_create_dbl_matrix ( max_length * model->num_states );
-	if ( !gamma ) {flag_failed = 1; goto SKIP_REST; }
-	i = (max_length-1) * model->num_states * model->num_states;
-	xi = hmmp_create_dbl_matrix ( (max_length-1) * model->num_states * model->num_states);
-	if ( !xi ) {flag_failed = 1; goto SKIP_REST; }
-	
-	scales_a = hmmp_create_dbl_array ( max_length );
-	if ( !scales_a ) {flag_failed = 1; goto SKIP_REST; }
-	scales_b = hmmp_create_dbl_array ( max_length );
-	if ( !scales_b ) {flag_failed = 1; goto SKIP_REST; }
-	
-	a_num = hmmp_create_dbl_matrix(model->num_states*model->num_states);
-	if ( !a_num ) {flag_failed = 1; goto SKIP_REST; }
-	b_num = hmmp_create_dbl_matrix(model->num_states*model->num_symbols);
-	if ( !b_num ) {flag_failed = 1; goto SKIP_REST; }
-	a_denom = hmmp_create_dbl_array(model->num_states);
-	if ( !a_denom ) {flag_failed = 1; goto SKIP_REST; }
-	b_denom = hmmp_create_dbl_array(model->num_states);
-	if ( !b_denom ) {flag_failed = 1; goto SKIP_REST; }
-SKIP_REST:
-	if(!flag_failed)
+	if ((e_corpus = hmmp_bwa_create_corpus(&corpus, seq_arr, weights, num_seq,
+											  model->num_states, model->num_symbols, 1)))
+		return e_corpus;
+	if ( hmmp_bwa_create_workspace ( &ws, model->num_states, model->num_symbols,
+									 corpus.max_length, corpus.interval ) ){
+		hmmp_bwa_delete_corpus ( &corpus );
+		return E_ALLOCATION;
+	}
 	for ( t = 0 ; t < max_steps ; ++t ){
-		logP_current = 0.0;
-		hmmp_init_dbl_dataset(pi_new,model->num_states,0.0);
-		hmmp_init_dbl_dataset(a_num,model->num_states*model->num_states,0.0);
-		hmmp_init_dbl_dataset(b_num,model->num_states*model->num_symbols,0.0);
-		hmmp_init_dbl_dataset(a_denom,model->num_states,0.0);
-		hmmp_init_dbl_dataset(b_denom,model->num_states,0.0);
-		for ( k = 0 ; k < num_seq ; ++k ){
-#pragma omp parallel num_threads(HMMP_NUM_THREADS) default(shared)
-		{
-		#pragma omp sections
-			{
-			#pragma omp section
-				{
-				hmmp_forward_alg(*model, seq_arr[k], alfa, scales_a );
-				logP_current += hmmp_log_of_divisors( scales_a, seq_arr[k].length );
+		logP_current = hmmp_bwa_expectation ( model, &corpus, &ws, HMMP_NUM_THREADS );
+		if ( hmmp_delta_logp ( model->prior, logP_current ) < delta_p ){
+			model->prior = logP_current;
+			break;
+		}
+		model->prior = logP_current;
+		if ( logP_current > 0.0-HMMP_PRECISION ){
+			model->prior = 0.0;
+			break;
+		}
+		hmmp_bw_stats_apply ( ws.stats, model );
+	}
+	hmmp_bwa_delete_workspace ( &ws );
+	hmmp_bwa_delete_corpus ( &corpus );
+	return t;
+}
+
+/* Squared distance between two sets of model parameters. */
+static double hmmp_squarem_dist2 ( hmmp_Model *a, hmmp_Model *b )
+{
+	size_t i, N, n_times_n, n_times_m;
+	double d, sum = 0.0;
+	N = a->num_states;
+	n_times_n = N * N;
+	n_times_m = N * a->num_symbols;
+	for ( i = 0 ; i < N ; ++i ){
+		d = a->initial[i] - b->initial[i];
+		sum += d*d;
+	}
+	for ( i = 0 ; i < n_times_n ; ++i ){
+		d = a->transition[i] - b->transition[i];
+		sum += d*d;
+	}
+	for ( i = 0 ; i < n_times_m ; ++i ){
+		d = a->emission[i] - b->emission[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+/* Squared norm of the second difference: (p2 - p1) - (p1 - p0). */
+static double hmmp_squarem_curv2 ( hmmp_Model *p0, hmmp_Model *p1, hmmp_Model *p2 )
+{
+	size_t i, N, n_times_n, n_times_m;
+	double d, sum = 0.0;
+	N = p0->num_states;
+	n_times_n = N * N;
+	n_times_m = N * p0->num_symbols;
+	for ( i = 0 ; i < N ; ++i ){
+		d = p2->initial[i] - 2.0*p1->initial[i] + p0->initial[i];
+		sum += d*d;
+	}
+	for ( i = 0 ; i < n_times_n ; ++i ){
+		d = p2->transition[i] - 2.0*p1->transition[i] + p0->transition[i];
+		sum += d*d;
+	}
+	for ( i = 0 ; i < n_times_m ; ++i ){
+		d = p2->emission[i] - 2.0*p1->emission[i] + p0->emission[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+/* Extrapolate: out = p0 - 2*alpha*r + alpha^2*v , where r = p1 - p0 , v = p2 - 2*p1 + p0.
+*  Returns 1 if any of the resulting parameters is not a valid probability. */
+static int hmmp_squarem_extrapolate_arr ( double *out, double *p0, double *p1, double *p2,
+										  size_t count, double alpha )
+{
+	size_t i;
+	double r, v;
+	char infeasible = 0;
+	for ( i = 0 ; i < count ; ++i ){
+		r = p1[i] - p0[i];
+		v = p2[i] - 2.0*p1[i] + p0[i];
+		out[i] = p0[i] - 2.0*alpha*r + alpha*alpha*v;
+		if ( out[i] < 0.0 || out[i] > 1.0 )
+			infeasible = 1;
+	}
+	return infeasible;
+}
+
+static int hmmp_squarem_extrapolate ( hmmp_Model *out, hmmp_Model *p0, hmmp_Model *p1,
+									  hmmp_Model *p2, double alpha )
+{
+	int infeasible = 0;
+	infeasible |= hmmp_squarem_extrapolate_arr ( out->initial, p0->initial, p1->initial,
+												 p2->initial, p0->num_states, alpha );
+	infeasible |= hmmp_squarem_extrapolate_arr ( out->transition, p0->transition, p1->transition,
+									p2->transition, (size_t)p0->num_states * p0->num_states, alpha );
+	infeasible |= hmmp_squarem_extrapolate_arr ( out->emission, p0->emission, p1->emission,
+									p2->emission, (size_t)p0->num_states * p0->num_symbols, alpha );
+	return infeasible;
+}
+
+/* Lower estimate of the regular steps needed to gain the same probability as one accepted
+*  extrapolation. The gain of regular steps decreases, so no regular step from p0 gains
+*  more than the first one: p0 -> p1. */
+static int hmmp_squarem_plain_steps ( double logP0, double logP1, double logP_ext, int max_steps )
+{
+	double steps;
+	if ( logP1 - logP0 < HMMP_PRECISION )
+		return 1;
+	steps = ( logP_ext - logP0 ) / ( logP1 - logP0 );
+	if ( steps > (double) max_steps )
+		return max_steps;
+	return steps < 1.0 ? 1 : (int) steps;
+}
+
+int hmmp_baum_welch_accel ( hmmp_Model *model, hmmp_Sequence *seq_arr, int num_seq,
+							int max_steps, double delta_p, int *o_steps_saved )
+{
+	hmmp_Bwa_Workspace ws;
+	hmmp_Bwa_Corpus corpus;
+	hmmp_Model *m1 = 0, *m2 = 0, *m_ext = 0;
+	int steps = 0, saved = 0, backtrack, e_corpus;
+	double logP0, logP1, logP_ext, alpha, r2, v2;
+
+	if ( o_steps_saved )
+		*o_steps_saved = 0;
+	if (!model || !seq_arr )
+		return E_PARAMETER;
+	if ((e_corpus = hmmp_bwa_create_corpus(&corpus, seq_arr, 0, num_seq,
+											  model->num_states, model->num_symbols, 1)))
+		return e_corpus;
+	m1 = hmmp_create_model_copy ( model );
+	m2 = hmmp_create_model_copy ( model );
+	m_ext = hmmp_create_model_copy ( model );
+	if ( !m1 || !m2 || !m_ext || hmmp_bwa_create_workspace ( &ws, model->num_states,
+											model->num_symbols, corpus.max_length,
+											corpus.interval ) ){
+		if ( m1 ) hmmp_delete_model ( m1 );
+		if ( m2 ) hmmp_delete_model ( m2 );
+		if ( m_ext ) hmmp_delete_model ( m_ext );
+		hmmp_bwa_delete_corpus ( &corpus );
+		return E_ALLOCATION;
+	}
+	while ( steps < max_steps ){
+		// plain step p0 -> p1, same stopping criteria as hmmp_baum_welch()
+		logP0 = hmmp_bwa_expectation ( model, &corpus, &ws, HMMP_NUM_THREADS );
+		++steps;
+		if ( hmmp_delta_logp ( model->prior, logP0 ) < delta_p ){
+			model->prior = logP0;
+			break;
+		}
+		model->prior = logP0;
+		if ( logP0 > 0.0-HMMP_PRECISION ){
+			model->prior = 0.0;
+			break;
+		}
+		hmmp_bw_stats_apply ( ws.stats, m1 );
+		if ( steps == max_steps ){
+			hmmp_model_copy ( model, m1 );
+			model->prior = logP0;
+			break;
+		}
+		// plain step p1 -> p2
+		logP1 = hmmp_bwa_expectation ( m1, &corpus, &ws, HMMP_NUM_THREADS );
+		++steps;
+		if ( hmmp_delta_logp ( logP0, logP1 ) < delta_p || logP1 > 0.0-HMMP_PRECISION ){
+			hmmp_model_copy ( model, m1 );
+			model->prior = logP1 > 0.0-HMMP_PRECISION ? 0.0 : logP1;
+			break;
+		}
+		hmmp_bw_stats_apply ( ws.stats, m2 );
+		if ( steps == max_steps ){
+			hmmp_model_copy ( model, m2 );
+			model->prior = logP1;
+			break;
+		}
+		// extrapolation p0 , p1 , p2 -> p' with step length 'alpha' <= -1
+		r2 = hmmp_squarem_dist2 ( m1, model );
+		v2 = hmmp_squarem_curv2 ( model, m1, m2 );
+		alpha = v2 > 0.0 ? -sqrt ( r2 / v2 ) : -1.0;
+		for ( backtrack = 0 ; alpha < -1.0 ; ++backtrack ){
+			if ( !hmmp_squarem_extrapolate ( m_ext, model, m1, m2, alpha ) )
+				break;
+			// step back towards p2 until all parameters are valid probabilities
+			alpha = backtrack < 8 ? ( alpha - 1.0 ) / 2.0 : -1.0;
+		}
+		if ( alpha >= -1.0 ){
+			// the extrapolation collapsed to p2, continue with a plain step from there
+			hmmp_model_copy ( model, m2 );
+			model->prior = logP1;
+			continue;
+		}
+		hmmp_normalize_arr ( m_ext->initial, m_ext->num_states );
+		hmmp_normalize_rows ( m_ext->transition, m_ext->num_states, m_ext->num_states );
+		hmmp_normalize_rows ( m_ext->emission, m_ext->num_states, m_ext->num_symbols );
+		logP_ext = hmmp_bwa_expectation ( m_ext, &corpus, &ws, HMMP_NUM_THREADS );
+		++steps;
+		if ( logP_ext >= logP1 ){
+			// accepted, the stabilizing step p' -> p0 uses the counts of the evaluation
+			hmmp_bw_stats_apply ( ws.stats, model );
+			model->prior = logP_ext;
+			saved += hmmp_squarem_plain_steps ( logP0, logP1, logP_ext, max_steps ) - 2;
+		}
+		else{
+			// rejected, fall back to the plain EM result p2
+			hmmp_model_copy ( model, m2 );
+			model->prior = logP1;
+			--saved;
+		}
+	}
+	hmmp_bwa_delete_workspace ( &ws );
+	hmmp_bwa_delete_corpus ( &corpus );
+	hmmp_delete_model ( m1 );
+	hmmp_delete_model ( m2 );
+	hmmp_delete_model ( m_ext );
+	if ( o_steps_saved )
+		*o_steps_saved = saved;
+	return steps;
+}
+
+/* Progress of one restart in hmmp_baum_welch_multistart(). */
+typedef struct {
+	hmmp_Bwa_Workspace ws;
+	double gain_max[2];	// largest single step gain in the last two rounds
+	int num_rounds;
+	int steps;
+	char running;	// 0 - converged or terminated
+	char killed;	// terminated as unlikely to win
+} hmmp_Bwa_Restart;
+
+/* Optimistic projection of the final probability of a restart: the remaining steps are
+*  assumed to gain as much as the best single step of its last two rounds. */
+static double hmmp_restart_projection ( hmmp_Model *model, hmmp_Bwa_Restart *r, int steps_left )
+{
+	double gain;
+	if ( r->num_rounds < 2 )
+		return HMMP_DBL_MAX;
+	gain = r->gain_max[0] > r->gain_max[1] ? r->gain_max[0] : r->gain_max[1];
+	return model->prior + gain * steps_left;
+}
+
+int hmmp_baum_welch_multistart ( hmmp_Model **o_best, hmmp_Sequence *seq_arr, int num_seq,
+								 int num_restarts, int num_states, int num_symbols, int seed,
+								 int max_steps, double delta_p, int check_every )
+{
+	hmmp_Model *models = 0;
+	hmmp_Bwa_Restart *restarts = 0;
+	hmmp_Bwa_Corpus corpus;
+	int k, t, e_corpus, best = -1;
+	int num_running, inner_threads, outer_threads, max_levels;
+	double logP_current, logP_lead;
+	char fail_flag = 0;
+
+	if ( !o_best || !seq_arr )
+		return E_PARAMETER;
+	*o_best = 0;
+	if ( num_restarts < 1 || check_every < 1 )
+		return E_ARGUMENT;
+	if ((e_corpus = hmmp_bwa_create_corpus(&corpus, seq_arr, 0, num_seq, num_states,
+										   num_symbols, num_restarts)))
+		return e_corpus;
+	models = hmmp_gen_random_models ( num_restarts, num_states, num_symbols, seed );
+	if ( !models ){
+		hmmp_bwa_delete_corpus ( &corpus );
+		return E_ALLOCATION;
+	}
+	restarts = (hmmp_Bwa_Restart*) calloc ( num_restarts, sizeof ( hmmp_Bwa_Restart ) );
+	if ( !restarts ){
+		hmmp_delete_arr_models ( models, num_restarts );
+		hmmp_bwa_delete_corpus ( &corpus );
+		return E_ALLOCATION;
+	}
+	for ( k = 0 ; k < num_restarts ; ++k ){
+		if ( hmmp_bwa_create_workspace ( &restarts[k].ws, num_states, num_symbols,
+										 corpus.max_length, corpus.interval ) ){
+			fail_flag = 1;
+			break;
+		}
+		restarts[k].running = 1;
+	}
+	max_levels = omp_get_max_active_levels();
+	num_running = fail_flag ? 0 : num_restarts;
+	while ( num_running ){
+		// the thread budget is split between the restarts which are still running
+		outer_threads = num_running < HMMP_NUM_THREADS ? num_running : HMMP_NUM_THREADS;
+		inner_threads = HMMP_NUM_THREADS / outer_threads;
+		if ( inner_threads < 1 )
+			inner_threads = 1;
+		omp_set_max_active_levels ( inner_threads > 1 ? 2 : 1 );
+#pragma omp parallel for private(k,t,logP_current) schedule(dynamic,1) num_threads(outer_threads)
+		for ( k = 0 ; k < num_restarts ; ++k ){
+			if ( !restarts[k].running )
+				continue;
+			restarts[k].gain_max[1] = restarts[k].gain_max[0];
+			restarts[k].gain_max[0] = 0.0;
+			for ( t = 0 ; t < check_every && restarts[k].steps < max_steps ; ++t ){
+				logP_current = hmmp_bwa_expectation ( models+k, &corpus,
+													  &restarts[k].ws, inner_threads );
+				if ( hmmp_delta_logp ( models[k].prior, logP_current ) < delta_p ||
+					 logP_current > 0.0-HMMP_PRECISION ){
+					models[k].prior = logP_current > 0.0-HMMP_PRECISION ? 0.0 : logP_current;
+					restarts[k].running = 0;
+					break;
 				}
-			#pragma omp section
-				{ hmmp_backward_alg(*model, seq_arr[k], beta,scales_b ); }
+				if ( restarts[k].steps && restarts[k].gain_max[0] < logP_current - models[k].prior )
+					restarts[k].gain_max[0] = logP_current - models[k].prior;
+				models[k].prior = logP_current;
+				hmmp_bw_stats_apply ( restarts[k].ws.stats, models+k );
+				++restarts[k].steps;
 			}
-			#pragma omp single
-			{ hmmp_backward_rescale(beta,model->num_states,seq_arr[k].length,scales_a,scales_b);}
-			hmmp_bwa_gamma_alg(gamma,alfa,beta,scales_a,model->num_states,seq_arr[k].length);
-			hmmp_bwa_xi_alg(xi,alfa,beta,*model,seq_arr[k]);
-			#pragma omp barrier
-			hmmp_bwa_reest_alg(*model,seq_arr[k],xi,gamma,a_num,b_num,a_denom,b_denom);
+			if ( restarts[k].steps >= max_steps )
+				restarts[k].running = 0;
+			++restarts[k].num_rounds;
 		}
-			for ( i = 0 ; i < model->num_states ; ++ i ){
-				pi_new[i] += gamma[i*seq_arr[k].length];
+		// terminate the restarts that can not reach the leading probability
+		logP_lead = -HMMP_DBL_MAX;
+		for ( k = 0 ; k < num_restarts ; ++k )
+			if ( !restarts[k].killed && logP_lead < models[k].prior )
+				logP_lead = models[k].prior;
+		num_running = 0;
+		for ( k = 0 ; k < num_restarts ; ++k ){
+			if ( restarts[k].running && hmmp_restart_projection ( models+k, restarts+k,
+								max_steps - restarts[k].steps ) < logP_lead ){
+				restarts[k].running = 0;
+				restarts[k].killed = 1;
 			}
+			if ( restarts[k].running )
+				++num_running;
+			else
+				hmmp_bwa_delete_workspace ( &restarts[k].ws );
 		}
+	}
+	omp_set_max_active_levels ( max_levels );
+	if ( !fail_flag ){
+		for ( k = 0 ; k < num_restarts ; ++k )
+			if ( !restarts[k].killed && ( best < 0 || models[best].prior < models[k].prior ) )
+				best = k;
+		*o_best = hmmp_create_model_copy ( models+best );
+		if ( !*o_best )
+			fail_flag = 1;
+	}
+	for ( k = 0 ; k < num_restarts ; ++k )
+		hmmp_bwa_delete_workspace ( &restarts[k].ws );
+	t = fail_flag ? E_ALLOCATION : restarts[best].steps;
+	free ( restarts );
+	hmmp_delete_arr_models ( models, num_restarts );
+	hmmp_bwa_delete_corpus ( &corpus );
+	return t;
+}
+
+int hmmp_baum_welch_checkpoint ( hmmp_Model *model, hmmp_Sequence *seq_arr, int num_seq,
+								 int max_steps, double delta_p, char *checkpoint_file,
+								 int checkpoint_every )
+{
+	hmmp_Bwa_Workspace ws;
+	hmmp_Bwa_Corpus corpus;
+	hmmp_Model *snapshot;
+	int t = 0, converged = 0, e_corpus, max_levels;
+	int snapshot_step = 0, e_write = E_SUCCESS;
+	double logP_current;
+
+	if (!model || !seq_arr || !checkpoint_file )
+		return E_PARAMETER;
+	if ( checkpoint_every < 1 )
+		return E_ARGUMENT;
+	if ((e_corpus = hmmp_bwa_create_corpus(&corpus, seq_arr, 0, num_seq,
+											  model->num_states, model->num_symbols, 1)))
+		return e_corpus;
+	snapshot = hmmp_create_model_copy ( model );
+	if ( !snapshot ){
+		hmmp_bwa_delete_corpus ( &corpus );
+		return E_ALLOCATION;
+	}
+	// resume from the latest checkpoint, the snapshot protects the model from a broken file
+	if ( hmmp_load_checkpoint ( snapshot, checkpoint_file, &t, &converged ) == E_SUCCESS )
+		hmmp_model_copy ( model, snapshot );
+	else
+		t = converged = 0;
+	if ( converged || t >= max_steps ){
+		hmmp_delete_model ( snapshot );
+		hmmp_bwa_delete_corpus ( &corpus );
+		return t;
+	}
+	if ( hmmp_bwa_create_workspace ( &ws, model->num_states, model->num_symbols,
+									 corpus.max_length, corpus.interval ) ){
+		hmmp_delete_model ( snapshot );
+		hmmp_bwa_delete_corpus ( &corpus );
+		return E_ALLOCATION;
+	}
+	// one thread runs the learning, the other writes the checkpoints in background tasks
+	max_levels = omp_get_max_active_levels();
+	omp_set_max_active_levels ( 2 );
+#pragma omp parallel num_threads(2) default(shared)
+	#pragma omp single
+	{
+	for ( ; t < max_steps ; ++t ){
+		logP_current = hmmp_bwa_expectation ( model, &corpus, &ws, HMMP_NUM_THREADS );
 		if ( hmmp_delta_logp ( model->prior, logP_current ) < delta_p ){
 			model->prior = logP_current;
+			converged = 1;
 			break;
 		}
 		model->prior = logP_current;
 		if ( logP_current > 0.0-HMMP_PRECISION ){
 			model->prior = 0.0;
+			converged = 1;
 			break;
 		}
-		for ( i = 0 ; i < model->num_states ; ++i )
-			model->initial[i] = pi_new[i];
-		hmmp_normalize_arr( model->initial, model->num_states );
-
-		for ( i = 0 ; i < model->num_states ; ++i ){
-			for ( j = 0 ; j < model->num_states ; ++j ){
-				model->transition[i*model->num_states+j] = a_num[i*model->num_states+j] / a_denom[i];
-			}
-			for ( j = 0 ; j < model->num_symbols ; ++j ){
-				model->emission[i*model->num_symbols+j] = b_num[i*model->num_symbols+j] / b_denom[i];
+		hmmp_bw_stats_apply ( ws.stats, model );
+		if ( (t+1) % checkpoint_every == 0 && t+1 < max_steps ){
+			// the previous checkpoint must be written before the snapshot is reused
+			#pragma omp taskwait
+			hmmp_model_copy ( snapshot, model );
+			snapshot_step = t+1;
+			#pragma omp task default(shared)
+			{
+				if ( hmmp_save_checkpoint ( checkpoint_file, snapshot, snapshot_step, 0 ) )
+					e_write = E_FILE_WRITE;
 			}
 		}
 	}
-	if (b_denom) hmmp_delete_dbl_array(b_denom);
-	if (a_denom) hmmp_delete_dbl_array(a_denom);
-	if (b_num) hmmp_delete_dbl_matrix(b_num);
-	if (a_num) hmmp_delete_dbl_matrix(a_num);
-	if (scales_b) hmmp_delete_dbl_array(scales_b);
-	if (scales_a) hmmp_delete_dbl_array(scales_a);
-	if (xi) hmmp_delete_dbl_matrix(xi);
-	if (gamma) hmmp_delete_dbl_matrix(gamma);
-	if (beta) hmmp_delete_dbl_matrix(beta);
-	if (alfa) hmmp_delete_dbl_matrix(alfa);
-	if (pi_new) hmmp_delete_dbl_array(pi_new);
-	if (flag_failed)
-		return E_ALLOCATION;
+	#pragma omp taskwait
+	}
+	omp_set_max_active_levels ( max_levels );
+	if ( hmmp_save_checkpoint ( checkpoint_file, model, t, converged ) )
+		e_write = E_FILE_WRITE;
+	hmmp_bwa_delete_workspace ( &ws );
+	hmmp_bwa_delete_corpus ( &corpus );
+	hmmp_delete_model ( snapshot );
+	if ( e_write )
+		return e_write;
 	return t;
-}
\ No newline at end of file
+}
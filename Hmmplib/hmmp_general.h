@@ -47,6 +47,10 @@
 *	Multi-core domain decomposition parallelism is implemented using OpenMP.
 *	To specify the desired number of threads for the algorithm change
 *	the global variable HMMP_NUM_THREADS.
+*	The buffers of the threads are kept between calls, see hmmp_workspace.h.
+*	Thread pinning and model replication on NUMA machines are set in hmmp_numa.h.
+*	Under a memory budget the Viterbi backtracking is checkpointed or fewer threads are
+*	used, see hmmp_plan.h.
 *	
 *	**Note:** After using the results of the function, use the appropriate functions from
 *	hmmp_memop.h to delete ( deallocate ) the data structures holding the reuslts.
@@ -75,6 +79,10 @@ int hmmp_decode(hmmp_Model model, hmmp_Sequence *observ_array, int num_obs,
 *	Multi-core domain decomposition parallelism is implemented using OpenMP.
 *	To specify the desired number of threads for the algorithm change
 *	the global variable HMMP_NUM_THREADS.
+*	The buffers of the threads are kept between calls, see hmmp_workspace.h.
+*	Thread pinning and model replication on NUMA machines are set in hmmp_numa.h.
+*	Only the last time step of the forward variables is kept, the memory budget of
+*	hmmp_plan.h can only reduce the number of threads.
 *	
 *	**Note:** After using the results of the function, use the appropriate functions from
 *	hmmp_memop.h to delete ( deallocate ) the data structures holding the reuslts.
@@ -101,6 +109,10 @@ int hmmp_evaluate_models(hmmp_Model *arr_models, int num_models,
 *	Multi-core domain decomposition parallelism is implemented using OpenMP.
 *	To specify the desired number of threads for the algorithm change
 *	the global variable HMMP_NUM_THREADS.
+*	The buffers of the threads are kept between calls, see hmmp_workspace.h.
+*	Thread pinning and model replication on NUMA machines are set in hmmp_numa.h.
+*	Only the last time step of the forward variables is kept, the memory budget of
+*	hmmp_plan.h can only reduce the number of threads.
 *	
 *	**Note:** After using the results of the function, use the appropriate functions from
 *	hmmp_memop.h to delete ( deallocate ) the data structures holding the reuslts.
@@ -116,6 +128,67 @@ int hmmp_evaluate_models(hmmp_Model *arr_models, int num_models,
 int hmmp_evaluate_sequences(hmmp_Model model, hmmp_Sequence *observ_arr, int num_obs,
 							dbl_array **o_logP );
 
+/// Use Hmmplib for evaluation of all sequences of a file larger than the memory.
+/**
+*	Same results as hmmp_evaluate_sequences() for every sequence of the file, but the
+*	sequences are read in chunks of at most 'chunk_length' symbols and the probabilities
+*	are written out after each chunk. While one chunk is evaluated in parallel, the next
+*	one is read by another thread, so reading and evaluation overlap. The memory holds two
+*	chunks at any time, regardless of the size of the file. The threads evaluating a chunk
+*	return their workspaces to the pool ( hmmp_workspace.h ) and the next chunk reuses
+*	them, so the peak memory does not grow with the number of chunks. A sequence longer
+*	than 'chunk_length' is read as a chunk of its own.
+*
+*	The input can be in the text format of hmmp_save_sequences() or the packed binary
+*	format of hmmp_save_corpus_binary(). The output is a text file with one line per
+*	sequence, in the order of the input: the seq_id and the logarithmic probability,
+*	written as by hmmp_format_double() regardless of the locale.
+*	\code {.txt}
+*		1 -153.61762098554195
+*		2 -98.43181071526831
+*	\endcode
+*	The thread reading the file comes in addition to the HMMP_NUM_THREADS threads of the
+*	evaluation. On an error the lines of the chunks completed so far are kept.
+*
+*	@param[in] model		The model to operate with
+*	@param[in] in_filename	Name of the file with the sequences
+*	@param[in] out_filename	Name of the file to receive the probabilities
+*	@param[in] chunk_length	Number of symbols read at once
+*	@return Number of evaluated sequences or @ref hmmp_Error Error code.
+*/
+int hmmp_evaluate_file ( hmmp_Model model, char *in_filename, char *out_filename,
+						 size_t chunk_length );
+
+/// Use Hmmplib for decoding of all sequences of a file larger than the memory.
+/**
+*	Same results as hmmp_decode() for every sequence of the file, but the sequences are
+*	read in chunks of at most 'chunk_length' symbols as in hmmp_evaluate_file(). The work
+*	is a three stage pipeline: while one chunk is decoded in parallel, the next chunk is
+*	read and the state sequences of the previous chunk are written by two other threads,
+*	so the time approaches the longest of reading, decoding and writing instead of their
+*	sum. The memory holds two chunks and two chunks of state sequences at any time. The
+*	backtracking buffers of the decoding threads are returned to the workspace pool after
+*	each chunk and reused by the next one, so they are allocated once for the longest
+*	sequence and not once per chunk.
+*
+*	The state sequences are written to 'out_filename' in the text format of
+*	hmmp_save_sequences(), in the order of the input and with the seq_id of their
+*	observable sequence. If 'logp_filename' is not 0, the logarithmic probabilities of the
+*	state sequences are written to it as the lines of hmmp_evaluate_file().
+*	The two threads reading and writing come in addition to the HMMP_NUM_THREADS threads
+*	of the decoding. On an error the chunks completed so far are kept, but the state file
+*	can not be loaded since it holds fewer sequences than announced.
+*
+*	@param[in] model			The model to operate with
+*	@param[in] in_filename		Name of the file with the observable sequences
+*	@param[in] out_filename		Name of the file to receive the state sequences
+*	@param[in] logp_filename	Name of the file to receive the probabilities, or 0
+*	@param[in] chunk_length		Number of symbols read at once
+*	@return Number of decoded sequences or @ref hmmp_Error Error code.
+*/
+int hmmp_decode_file ( hmmp_Model model, char *in_filename, char *out_filename,
+					   char *logp_filename, size_t chunk_length );
+
 
 /// Use Hmmplib for learning with a single model and multiple sequences.
 /**
@@ -140,6 +213,13 @@ int hmmp_evaluate_sequences(hmmp_Model model, hmmp_Sequence *observ_arr, int num
 *
 *	To specify the desired number of threads for the algorithm change
 *	the global variable HMMP_NUM_THREADS ( 2 to (number of cores) recommended ).
+*
+*	Identical sequences in the array are processed only once per step, with their
+*	counts multiplied by the number of occurrences ( see hmmp_baum_welch_weighted() ).
+*	The array itself is not modified.
+*	When the forward and backward variables of the longest sequence do not fit in the
+*	memory budget of hmmp_plan.h, they are checkpointed ( see
+*	hmmp_bw_stats_accumulate_checkpoint_alg() ). The other learning functions do the same.
 *	
 *	**Note:** The model parameters will change after executing this function.
 *
@@ -153,4 +233,140 @@ int hmmp_evaluate_sequences(hmmp_Model model, hmmp_Sequence *observ_arr, int num
 */
 int hmmp_baum_welch ( hmmp_Model *model,hmmp_Sequence *seq_arr, int num_seq , int max_steps, double delta_p );
 
+/// Use Hmmplib for learning from weighted sequences.
+/**
+*	Same as hmmp_baum_welch(), but each sequence contributes to the expected counts
+*	( and to the probability of the model stored in model->prior ) in proportion
+*	to its weight. A sequence with weight 'w' is equivalent to 'w' copies of it in the
+*	array, but it is evaluated only once per step. Weights need not be integers, so
+*	they can also express the importance of the sequences.
+*
+*	Identical sequences are collapsed into one entry before learning and their weights
+*	are added up ( see hmmp_dedup_sequences() ). The array and the weights are not modified.
+*
+*	@param[in,out] model The address of the model to operate on ( model paramaters will change )
+*	@param[in] seq_arr	Adress of an array of observable sequences to operate with
+*	@param[in] weights	Adress of an array with a non-negative weight for each sequence,
+*						or 0 for weight 1.0 of all sequences
+*	@param[in] num_seq	Number of observable sequences in the array
+*	@param[in] max_steps Maximum number of times to repeat the Baum-Welch algorithm
+*	@param[in] delta_p	Minimum differance between the old and the new probability of the model,
+						above which, the algorithm will keep executing. See hmmp_delta_logp().
+*	@return Number of steps executed, or @ref hmmp_Error error code.
+*			E_ARGUMENT for an empty array or a negative weight.
+*/
+int hmmp_baum_welch_weighted ( hmmp_Model *model, hmmp_Sequence *seq_arr, dbl_array *weights,
+							   int num_seq, int max_steps, double delta_p );
+
+/// Use Hmmplib for learning with accelerated convergence of the Baum-Welch algorithm.
+/**
+*	The Baum-Welch algorithm is an EM ( Expectation Maximization ) method and converges
+*	linearly, so many steps are spent on small improvements near the local maximum.
+*	This function uses squared extrapolation ( SQUAREM ) over two successive steps:
+*	from the model parameters p0 and the results of two regular steps p1 and p2 it
+*	extrapolates along the direction of convergence with a step length estimated from
+*	the differences ( p1-p0 ) and ( p2-2*p1+p0 ). The extrapolated parameters are clipped
+*	back towards p2 until they are valid probabilities.
+*
+*	The probability of the model never decreases: when the extrapolated model has a lower
+*	probability than p1, the extrapolation is discarded and the learning continues with
+*	the result of the regular step p2. An accepted extrapolation is followed by a regular
+*	step, which reuses the sums obtained while evaluating it.
+*
+*	The stopping criteria, the parallelism and the meaning of model->prior are the same
+*	as in hmmp_baum_welch(). Each evaluation over all sequences ( a forward and a backward
+*	pass ) counts as one step.
+*
+*	@param[in,out] model The address of the model to operate on ( model paramaters will change )
+*	@param[in] seq_arr	Adress of an array of observable sequences to operate with
+*	@param[in] num_seq	Number of observable sequences in the array
+*	@param[in] max_steps Maximum number of steps ( passes over all sequences )
+*	@param[in] delta_p	Minimum differance between the old and the new probability of the model,
+						above which, the algorithm will keep executing. See hmmp_delta_logp().
+*	@param[out] o_steps_saved Optional ( can be 0 ). Receives an estimate of the number of
+*						regular steps saved by the accepted extrapolations, minus the steps
+*						lost on rejected ones. The estimate is conservative: it assumes
+*						that every replaced regular step would have gained as much as
+*						the first regular step of its extrapolation.
+*	@return Number of steps completed or @ref hmmp_Error Error code.
+*/
+int hmmp_baum_welch_accel ( hmmp_Model *model, hmmp_Sequence *seq_arr, int num_seq,
+							int max_steps, double delta_p, int *o_steps_saved );
+
+/// Use Hmmplib for learning from multiple random initializations, keeping the best model.
+/**
+*	The Baum-Welch algorithm converges to a local maximum which depends on the initial
+*	model parameters. This function trains 'num_restarts' random models created with
+*	hmmp_gen_random_models() concurrently and returns a copy of the one with the highest
+*	probability. The model_id of the result is the index of the winning restart.
+*
+*	The restarts share a budget of HMMP_NUM_THREADS threads. The running restarts are
+*	trained in rounds of 'check_every' steps. Each round the thread budget is split
+*	between them: one restart per thread while there are more restarts than threads,
+*	otherwise the threads left over are given to the parallel regions of each restart
+*	( nested parallelism is enabled for the duration of the call ).
+*
+*	After every round the final probability of each running restart is projected
+*	optimistically: every one of its remaining steps is assumed to gain as much as the
+*	best single step of its last two rounds. EM gains tend to decrease, so a restart whose
+*	projection is still below the current probability of the leading restart is unlikely
+*	to win. It is terminated, and its threads and memory are released for the survivors.
+*	Restarts are never terminated before completing two rounds.
+*
+*	The stopping criteria for each restart are the same as in hmmp_baum_welch().
+*
+*	**Note:** Every restart holds its own Baum-Welch containers until it is finished.
+*	Use hmmp_delete_model() to delete the resulting model.
+*
+*	@param[out] o_best	Address of a pointer to receive the address of the best model
+*	@param[in] seq_arr	Adress of an array of observable sequences to operate with
+*	@param[in] num_seq	Number of observable sequences in the array
+*	@param[in] num_restarts	Number of random initializations to train
+*	@param[in] num_states	Number of states for every model
+*	@param[in] num_symbols	Number of symbols for every model
+*	@param[in] seed		Integer seed for the random initialization
+*	@param[in] max_steps Maximum number of steps for each restart
+*	@param[in] delta_p	Minimum differance between the old and the new probability of a model,
+						above which, its training will keep executing. See hmmp_delta_logp().
+*	@param[in] check_every Number of steps between comparisons of the restarts
+*	@return Number of steps completed by the best restart or @ref hmmp_Error Error code.
+*/
+int hmmp_baum_welch_multistart ( hmmp_Model **o_best, hmmp_Sequence *seq_arr, int num_seq,
+								 int num_restarts, int num_states, int num_symbols, int seed,
+								 int max_steps, double delta_p, int check_every );
+
+/// Use Hmmplib for learning with periodic checkpoints of the learning process.
+/**
+*	Same as hmmp_baum_welch(), but every 'checkpoint_every' steps the model, its prior and
+*	the number of completed steps are saved to 'checkpoint_file' with hmmp_save_checkpoint().
+*	The model is copied to a snapshot and the file is written by a background task, so the
+*	learning continues while the checkpoint is written. A final checkpoint is written when
+*	the learning stops, marked as converged if the stopping criteria were met.
+*
+*	If 'checkpoint_file' already holds a valid checkpoint for a model with the same number
+*	of states and symbols, the learning resumes from it: the model parameters and prior are
+*	replaced with the saved ones and the saved steps count towards 'max_steps'. When the
+*	checkpoint is marked as converged, or 'max_steps' are already completed, the model is
+*	loaded and returned without learning. Delete the checkpoint file to start a new
+*	learning process.
+*
+*	One extra thread is used for writing the checkpoints and nested parallelism is enabled
+*	for the duration of the call.
+*
+*	@param[in,out] model The address of the model to operate on ( model paramaters will change )
+*	@param[in] seq_arr	Adress of an array of observable sequences to operate with
+*	@param[in] num_seq	Number of observable sequences in the array
+*	@param[in] max_steps Maximum number of steps, including the steps before resuming
+*	@param[in] delta_p	Minimum differance between the old and the new probability of the model,
+						above which, the algorithm will keep executing. See hmmp_delta_logp().
+*	@param[in] checkpoint_file String containing the name and relative location of the
+*						checkpoint file
+*	@param[in] checkpoint_every Number of steps between checkpoints
+*	@return Total number of steps completed or @ref hmmp_Error Error code.
+*			E_FILE_WRITE if any of the checkpoints could not be written.
+*/
+int hmmp_baum_welch_checkpoint ( hmmp_Model *model, hmmp_Sequence *seq_arr, int num_seq,
+								 int max_steps, double delta_p, char *checkpoint_file,
+								 int checkpoint_every );
+
 #endif
\ No newline at end of file
@@ -27,6 +27,7 @@
 hmmp_Model *hmmp_gen_from_seq ( hmmp_Sequence *seq )
 {
 	hmmp_Model *m;
+	hmmp_Rle_Cursor c;
 	int i;
 	if(!seq)
 		return 0;
@@ -35,22 +36,22 @@ hmmp_Model *hmmp_gen_from_seq ( hmmp_Sequence *seq )
 		return 0;
 	for ( i = 0 ; i < m->num_states ; ++i )
 		m->initial[i] = 0;
-	for ( i = 0 ; i < m->num_states * m->num_states; ++i )
-		m->transition[i] = 0;
-	for ( i = 0 ; i < m->num_states * m->num_symbols ; ++i )
-		m->emission[i] = 0;
+	hmmp_init_dbl_dataset ( m->transition, (size_t)m->num_states * m->num_states, 0.0 );
+	hmmp_init_dbl_dataset ( m->emission, (size_t)m->num_states * m->num_symbols, 0.0 );
 	m->initial[0] = 1;
 	for ( i = 0 ; i < m->num_states-1; ++i )
-		m->transition[(i+1)*m->num_states + i ] = 1;
+		m->transition[(size_t)(i+1)*m->num_states + i ] = 1;
+	hmmp_rle_seek ( &c, *seq, 0 );
 	for ( i = 0 ; i < m->num_symbols ; ++i )
-		m->emission[i*m->num_symbols + seq->sequence[i]] = 1;
+		m->emission[(size_t)i*m->num_symbols + HMMP_NEXT_SYMBOL ( *seq, i, c )] = 1;
 	m->prior = 1.0;
 	return m;
 }
 
 hmmp_Model *hmmp_gen_random_models ( int count, int num_states, int num_symbols, int seed )
 {
-	int i, j;
+	int i;
+	size_t j;
 	hmmp_Model *arr;
 	srand(seed);
 //allocate all models, and all matrices
@@ -63,13 +64,13 @@ hmmp_Model *hmmp_gen_random_models ( int count, int num_states, int num_symbols,
 		arr[i].num_states = num_states;
 		arr[i].num_symbols = num_symbols;
 		arr[i].prior = 0.0;
-		for ( j = 0 ; j < num_states ; ++j ){
+		for ( j = 0 ; j < (size_t)num_states ; ++j ){
 			arr[i].initial[j] = 1/(double)(1+rand()%(num_states*num_symbols));
 		}
-		for ( j = 0 ; j < num_states*num_states ; ++j ){
+		for ( j = 0 ; j < (size_t)num_states*num_states ; ++j ){
 			arr[i].transition[j] = 1/(double)(1+rand()%(num_states*num_symbols));
 		}
-		for ( j = 0 ; j < num_states*num_symbols ; ++j ){
+		for ( j = 0 ; j < (size_t)num_states*num_symbols ; ++j ){
 			arr[i].emission[j] = 1/(double)(1+rand()%(num_states*num_symbols));
 		}
 		hmmp_normalize_arr(arr[i].initial,num_states);
@@ -40,6 +40,26 @@
 /** @file hmmp_general.h @brief Contains all the library high-level entry points.*/
 #include "hmmp_general.h"
 
+/** @file hmmp_bwstats.h
+*	@brief Expected counts of the Baum-Welch algorithm for distributed learning.*/
+#include "hmmp_bwstats.h"
+
+/** @file hmmp_workspace.h
+*	@brief Per-thread workspaces reused by the inference entry points.*/
+#include "hmmp_workspace.h"
+
+/** @file hmmp_numa.h
+*	@brief Thread pinning and memory placement on NUMA machines.*/
+#include "hmmp_numa.h"
+
+/** @file hmmp_plan.h
+*	@brief Memory budget and the choice of the algorithm variants.*/
+#include "hmmp_plan.h"
+
+/** @file hmmp_numconv.h
+*	@brief Locale independent conversions between numbers and text for the file I/O.*/
+#include "hmmp_numconv.h"
+
 /** @file hmmp_generate.h @brief Generating random or 1 sequence models. Initialization */
 #include "hmmp_generate.h" // DONE COMMENTING FOR DOXYGEN!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
@@ -1,3 +1,6 @@
+#ifdef __linux__
+#define _GNU_SOURCE	// posix_memalign(), MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE
+#endif
 /*  This file is part of Hmmplib.
 *	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
 *   Copyright (C) 2017  Iskren Tarkalanov
@@ -21,42 +24,227 @@
 #include "hmmp_datatypes.h"
 #include "hmmp_dataproc.h"
 #include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
-hmmp_Model *hmmp_create_model ( int num_states, int num_symbols )
+void *hmmp_aligned_alloc ( size_t size )
+{
+	void *p;
+	if ( !size )
+		size = HMMP_ALIGNMENT;
+#ifdef _WIN32
+	p = _aligned_malloc ( size, HMMP_ALIGNMENT );
+#else
+	if ( posix_memalign ( &p, HMMP_ALIGNMENT, size ) )
+		p = 0;
+#endif
+	return p;
+}
+int hmmp_aligned_free ( void *p )
+{
+	if ( !p )
+		return E_PARAMETER;
+#ifdef _WIN32
+	_aligned_free ( p );
+#else
+	free ( p );
+#endif
+	return E_SUCCESS;
+}
+
+/* A large buffer starts with this header, padded to HMMP_ALIGNMENT bytes, so deleting it
+*  knows how it was obtained. */
+typedef struct {
+	size_t mapped;	// bytes of the mapping, 0 if the buffer is in the heap
+	int pages;		// HMMP_PAGES_...
+} hmmp_Large_Header;
+
+static size_t hmmp_huge_threshold = 0;
+
+int hmmp_set_huge_page_threshold ( size_t num_bytes )
+{
+	hmmp_huge_threshold = num_bytes;
+	return E_SUCCESS;
+}
+
+void *hmmp_create_large_buffer ( size_t num_bytes )
+{
+	hmmp_Large_Header *header = 0;
+	size_t size;
+	if ( num_bytes > SIZE_MAX - 2 * (size_t) HMMP_HUGE_PAGE_SIZE )
+		return 0;
+	size = num_bytes + HMMP_ALIGNMENT;
+#if defined(__linux__) && defined(MAP_ANONYMOUS)
+	if ( hmmp_huge_threshold && num_bytes >= hmmp_huge_threshold ){
+		void *p;
+		size = ( size + HMMP_HUGE_PAGE_SIZE - 1 ) & ~( (size_t) HMMP_HUGE_PAGE_SIZE - 1 );
+#ifdef MAP_HUGETLB
+		p = mmap ( 0, size, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+		if ( p != MAP_FAILED ){
+			header = (hmmp_Large_Header*) p;
+			header->pages = HMMP_PAGES_HUGETLB;
+		}
+#endif
+		// no reserved huge pages, ask for transparent ones on a regular mapping. It is
+		// mapped one huge page larger and trimmed to start on a huge page boundary, so
+		// its first and last huge pages are whole.
+		if ( !header ){
+			p = mmap ( 0, size + HMMP_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+					   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+			if ( p != MAP_FAILED ){
+				char *start = (char*) ( ( (uintptr_t) p + HMMP_HUGE_PAGE_SIZE - 1 ) &
+										~( (uintptr_t) HMMP_HUGE_PAGE_SIZE - 1 ) );
+				size_t head = start - (char*) p;
+				int pages = HMMP_PAGES_REGULAR;
+				if ( head )
+					munmap ( p, head );
+				munmap ( start + size, HMMP_HUGE_PAGE_SIZE - head );
+#ifdef MADV_HUGEPAGE
+				// before the header is written, so the first page is touched with the hint
+				if ( !madvise ( start, size, MADV_HUGEPAGE ) )
+					pages = HMMP_PAGES_THP;
+#endif
+				header = (hmmp_Large_Header*) start;
+				header->pages = pages;
+			}
+		}
+		if ( header )
+			header->mapped = size;
+		else
+			size = num_bytes + HMMP_ALIGNMENT;
+	}
+#endif
+	if ( !header ){
+		header = (hmmp_Large_Header*) hmmp_aligned_alloc ( size );
+		if ( !header )
+			return 0;
+		header->mapped = 0;
+		header->pages = HMMP_PAGES_REGULAR;
+	}
+	return (char*) header + HMMP_ALIGNMENT;
+}
+
+int hmmp_delete_large_buffer ( void *buffer )
+{
+	hmmp_Large_Header *header;
+	if ( !buffer )
+		return E_PARAMETER;
+	header = (hmmp_Large_Header*) ( (char*) buffer - HMMP_ALIGNMENT );
+#ifdef __linux__
+	if ( header->mapped ){
+		munmap ( header, header->mapped );
+		return E_SUCCESS;
+	}
+#endif
+	hmmp_aligned_free ( header );
+	return E_SUCCESS;
+}
+
+#ifdef __linux__
+/* Check in /proc/self/smaps if the mapping holding 'p' has transparent huge pages. */
+static int hmmp_thp_backed ( void *p )
+{
+	FILE *file;
+	char line[512];
+	unsigned long begin, end, kb;
+	int inside = 0, backed = 0;
+	if ( !(file = fopen ( "/proc/self/smaps", "r" )) )
+		return 0;
+	while ( fgets ( line, sizeof ( line ), file ) ){
+		if ( sscanf ( line, "%lx-%lx ", &begin, &end ) == 2 ){
+			if ( inside )
+				break;
+			inside = (uintptr_t) p >= begin && (uintptr_t) p < end;
+		}
+		else if ( inside && sscanf ( line, "AnonHugePages: %lu", &kb ) == 1 ){
+			backed = kb > 0;
+			break;
+		}
+	}
+	fclose ( file );
+	return backed;
+}
+#endif
+
+int hmmp_large_buffer_pages ( void *buffer )
+{
+	int pages;
+	if ( !buffer )
+		return E_PARAMETER;
+	pages = ( (hmmp_Large_Header*) ( (char*) buffer - HMMP_ALIGNMENT ) )->pages;
+#ifdef __linux__
+	// transparent huge pages are only assigned when the pages are touched, if at all
+	if ( pages == HMMP_PAGES_THP && !hmmp_thp_backed ( buffer ) )
+		pages = HMMP_PAGES_REGULAR;
+#endif
+	return pages;
+}
+
+/* Bytes rounded up to the next multiple of the alignment. */
+static size_t hmmp_align_size ( size_t size )
+{
+	return ( size + HMMP_ALIGNMENT - 1 ) & ~( (size_t) HMMP_ALIGNMENT - 1 );
+}
+/* Size of the parameters of one model: initial | transition | emission, each array
+*  starting at an aligned address. */
+static size_t hmmp_model_params_size ( int num_states, int num_symbols )
+{
+	return hmmp_align_size ( sizeof(dbl_array) * num_states ) +
+		   hmmp_align_size ( sizeof(dbl_matrix) * num_states * num_states ) +
+		   hmmp_align_size ( sizeof(dbl_matrix) * num_states * num_symbols );
+}
+/* Place the parameters of one model at the aligned address 'block'. Returns the address
+*  following them. */
+static char *hmmp_model_params_place ( hmmp_Model *model, char *block,
+									   int num_states, int num_symbols )
+{
+	model->model_id = 0;
+	model->num_states = num_states;
+	model->num_symbols = num_symbols;
+	model->prior = 0.0;
+	model->initial = (dbl_array*) block;
+	block += hmmp_align_size ( sizeof(dbl_array) * num_states );
+	model->transition = (dbl_matrix*) block;
+	block += hmmp_align_size ( sizeof(dbl_matrix) * num_states * num_states );
+	model->emission = (dbl_matrix*) block;
+	block += hmmp_align_size ( sizeof(dbl_matrix) * num_states * num_symbols );
+	return block;
+}
+static int hmmp_model_size_overflow ( int num_states, int num_symbols )
 {
-	hmmp_Model *model;
 	int e_overflow = 0;
-	unsigned int overflow[3];
+	size_t overflow[3];
+	if ( num_states < 1 || num_symbols < 1 )
+		return 1;
 	overflow[0] = num_states;
 	overflow[1] = num_symbols;
 	overflow[2] = sizeof(dbl_matrix);
 	e_overflow |= hmmp_multiplication_overflow(overflow, 3);
 	overflow[1] = num_states;
 	e_overflow |= hmmp_multiplication_overflow(overflow, 3);
-	if ( e_overflow )
-		return 0;
-	model = ( hmmp_Model*)malloc(sizeof(hmmp_Model));
-	if(!model)
-		return 0;
-//init
-	model->model_id = 0;
-	model->num_states = num_states;
-	model->num_symbols = num_symbols;
-	if (!(model->initial = (dbl_array*) malloc ( sizeof(dbl_array) * num_states ))){
-		free(model);
-		return 0;
-	}
-	if (!(model->transition = ( dbl_matrix*) malloc ( sizeof(dbl_matrix) * num_states * num_states))){
-		free(model->initial);
-		free(model);
+	return e_overflow;
+}
+
+hmmp_Model *hmmp_create_model ( int num_states, int num_symbols )
+{
+	hmmp_Model *model;
+	char *block;
+	if ( hmmp_model_size_overflow ( num_states, num_symbols ) )
 		return 0;
-	}
-	if (!(model->emission = (dbl_matrix*) malloc ( sizeof(dbl_matrix) * num_states * num_symbols ))){
-		free(model->initial);
-		free(model->transition);
-		free(model);
+	// one block: model | initial | transition | emission
+	block = (char*) hmmp_aligned_alloc ( hmmp_align_size ( sizeof(hmmp_Model) ) +
+										 hmmp_model_params_size ( num_states, num_symbols ) );
+	if ( !block )
 		return 0;
-	}
+	model = (hmmp_Model*) block;
+	hmmp_model_params_place ( model, block + hmmp_align_size ( sizeof(hmmp_Model) ),
+							  num_states, num_symbols );
 	return model;
 }
 hmmp_Model *hmmp_create_model_copy ( hmmp_Model *source )
@@ -78,64 +266,60 @@ int hmmp_delete_model ( hmmp_Model *model )
 	model->num_states=0;
 	model->num_symbols=0;
 	model->prior=0.0;
-	free(model->initial);
-	free(model->transition);
-	free(model->emission);
-	free(model);
+	model->initial=0;
+	model->transition=0;
+	model->emission=0;
+	hmmp_aligned_free(model);
 	return E_SUCCESS;
 }
-hmmp_Model *hmmp_create_arr_models ( int count, int num_states, int num_symbols )
+hmmp_Model *hmmp_create_arr_models_dims ( int count, int_array *num_states,
+										  int_array *num_symbols )
 {
 	int i;
 	hmmp_Model *arr;
-	int e_overflow = 0;
-	unsigned int overflow[3];
-	overflow[0] = num_states;
-	overflow[1] = num_symbols;
-	overflow[2] = sizeof(dbl_matrix);
-	e_overflow |= hmmp_multiplication_overflow(overflow, 3);
-	overflow[1] = num_states;
-	e_overflow |= hmmp_multiplication_overflow(overflow, 3);
+	char *block;
+	size_t size, params;
+	size_t overflow[2];
+	if ( count < 1 || !num_states || !num_symbols )
+		return 0;
 	overflow[0] = count;
 	overflow[1] = sizeof(hmmp_Model);
-	e_overflow |= hmmp_multiplication_overflow(overflow, 2);
-	if ( e_overflow )
+	if ( hmmp_multiplication_overflow(overflow, 2) )
 		return 0;
-//allocate all models, and all matrices
-	arr = (hmmp_Model*)malloc(sizeof(hmmp_Model)*count);
+	size = hmmp_align_size ( sizeof(hmmp_Model) * count );
+	for ( i = 0 ; i < count ; ++i ){
+		if ( hmmp_model_size_overflow ( num_states[i], num_symbols[i] ) )
+			return 0;
+		params = hmmp_model_params_size ( num_states[i], num_symbols[i] );
+		if ( size > SIZE_MAX - params )
+			return 0;
+		size += params;
+	}
+	// one slab: models | parameters of model 0 | parameters of model 1 | ...
+	arr = (hmmp_Model*) hmmp_aligned_alloc ( size );
 	if(!arr)
 		return 0;
-	arr = (hmmp_Model*)malloc(sizeof(hmmp_Model)*count);
-	if(!arr)
+	block = (char*) arr + hmmp_align_size ( sizeof(hmmp_Model) * count );
+	for ( i = 0 ; i < count ; ++i )
+		block = hmmp_model_params_place ( arr+i, block, num_states[i], num_symbols[i] );
+	return arr;
+}
+hmmp_Model *hmmp_create_arr_models ( int count, int num_states, int num_symbols )
+{
+	int i;
+	hmmp_Model *arr;
+	int_array *dims;
+	if ( count < 1 )
 		return 0;
-	for ( i = 0 ; i < count ; ++i ){
-		arr[i].num_states = num_states;
-		arr[i].num_symbols = num_symbols;
-		arr[i].initial = (dbl_array*)malloc(sizeof(dbl_array)*num_states);
-		if(!(arr[i].initial))
-			break;
-		arr[i].transition = (dbl_matrix*)malloc(sizeof(dbl_matrix)*num_states*num_states);
-		if(!(arr[i].transition)){
-			free(arr[i].initial);
-			break;
-		}
-		arr[i].emission = (dbl_matrix*)malloc(sizeof(dbl_matrix)*num_states*num_symbols);
-		if(!(arr[i].emission)){
-			free(arr[i].initial);
-			free(arr[i].transition);
-			break;
-		}
-	}
-	if(i!=count){
-		while(i+1){
-			free(arr[i].initial);
-			free(arr[i].transition);
-			free(arr[i].emission);
-			--i;
-		}
-		free(arr);
+	dims = hmmp_create_int_array ( 2*count );
+	if ( !dims )
 		return 0;
+	for ( i = 0 ; i < count ; ++i ){
+		dims[i] = num_states;
+		dims[count+i] = num_symbols;
 	}
+	arr = hmmp_create_arr_models_dims ( count, dims, dims+count );
+	hmmp_delete_int_array ( dims );
 	return arr;
 }
 int hmmp_delete_arr_models(hmmp_Model *arr, int count)
@@ -145,15 +329,15 @@ int hmmp_delete_arr_models(hmmp_Model *arr, int count)
 		return E_PARAMETER;
 	for ( i = 0 ; i < count ; ++i ){
 		arr[i].model_id=-1;
-		free(arr[i].initial);
-		free(arr[i].transition);
-		free(arr[i].emission);
+		arr[i].initial=0;
+		arr[i].transition=0;
+		arr[i].emission=0;
 	}
-	free(arr);
+	hmmp_aligned_free(arr);
 	return E_SUCCESS;
 }
 
-dbl_array *hmmp_create_dbl_array(unsigned num_elements)
+dbl_array *hmmp_create_dbl_array(size_t num_elements)
 {
 	dbl_array *arr;
 	arr = ( dbl_array * ) malloc ( sizeof(dbl_array) * num_elements );
@@ -164,7 +348,7 @@ int hmmp_delete_dbl_array(dbl_array* arr)
 	free(arr);
 	return E_SUCCESS;
 }
-dbl_matrix *hmmp_create_dbl_matrix(unsigned num_elements)
+dbl_matrix *hmmp_create_dbl_matrix(size_t num_elements)
 {
 	dbl_matrix *mat;
 	mat = ( dbl_matrix * ) malloc ( sizeof(dbl_matrix)*num_elements);
@@ -177,7 +361,7 @@ int hmmp_delete_dbl_matrix(dbl_matrix* mat)
 	free(mat);
 	return E_SUCCESS;
 }
-int_array *hmmp_create_int_array(unsigned num_elements)
+int_array *hmmp_create_int_array(size_t num_elements)
 {
 	int_array *arr;
 	arr = (int_array*) malloc ( sizeof(int_array) * num_elements );
@@ -190,7 +374,7 @@ int hmmp_delete_int_array(int_array* arr)
 	free(arr);
 	return E_SUCCESS;
 }
-int_matrix *hmmp_create_int_matrix(unsigned num_elements)
+int_matrix *hmmp_create_int_matrix(size_t num_elements)
 {
 	int_matrix *arr;
 	arr = (int_matrix*) malloc ( sizeof(int_matrix) * num_elements );
@@ -203,23 +387,214 @@ int hmmp_delete_int_matrix(int_matrix* mat)
 	free(mat);
 	return E_SUCCESS;
 }
+size_t hmmp_symbol_size ( int symbol_type )
+{
+	switch ( symbol_type ){
+	case HMMP_SYMBOLS_INT:		return sizeof ( int_array );
+	case HMMP_SYMBOLS_UINT8:	return sizeof ( uint8_t );
+	case HMMP_SYMBOLS_UINT16:	return sizeof ( uint16_t );
+	}
+	return 0;
+}
 hmmp_Sequence *hmmp_create_sequence( int length )
+{
+	return hmmp_create_sequence_typed ( length, HMMP_SYMBOLS_INT );
+}
+hmmp_Sequence *hmmp_create_sequence_typed ( int length, int symbol_type )
 {
 	hmmp_Sequence *seq;
+	size_t size = hmmp_symbol_size ( symbol_type );
+	if ( !size || length < 0 )
+		return 0;
 	seq = ( hmmp_Sequence* ) malloc ( sizeof(hmmp_Sequence) );
-	seq->sequence = hmmp_create_int_array(length);
-	if(!(seq->sequence)){
+	if ( !seq )
+		return 0;
+	hmmp_sequence_init ( seq );
+	seq->symbols = (uint8_t*) malloc ( size * ( length ? length : 1 ) );
+	if(!(seq->symbols)){
 		free(seq);
 		return 0;
 	}
 	seq->length = length;
+	seq->symbol_type = symbol_type;
+	if ( symbol_type == HMMP_SYMBOLS_INT ){
+		seq->sequence = (int_array*) seq->symbols;
+		seq->symbols = 0;
+	}
 	return seq;
 }
+int hmmp_sequence_init ( hmmp_Sequence *o_seq )
+{
+	hmmp_Sequence empty = HMMP_SEQUENCE_INIT;
+	if ( !o_seq )
+		return E_PARAMETER;
+	*o_seq = empty;
+	return E_SUCCESS;
+}
+int hmmp_sequence_view ( hmmp_Sequence *o_seq, const hmmp_Sequence_View *view, int seq_id,
+						 int cardinality )
+{
+	int symbol_type;
+	if ( !o_seq || !view || ( !view->data && view->length ) )
+		return E_PARAMETER;
+	switch ( view->width ){
+	case 0: symbol_type = HMMP_SYMBOLS_RLE; break;
+	case 1: symbol_type = HMMP_SYMBOLS_UINT8; break;
+	case 2: symbol_type = HMMP_SYMBOLS_UINT16; break;
+	case 4: symbol_type = HMMP_SYMBOLS_INT; break;
+	default: return E_ARGUMENT;
+	}
+	// every symbol aligned for its type, coded runs are read in order
+	if ( view->length < 0 || ( view->width ? view->stride % view->width ||
+							   (uintptr_t) view->data % view->width : view->stride ) )
+		return E_ARGUMENT;
+	hmmp_sequence_init ( o_seq );
+	o_seq->seq_id = seq_id;
+	o_seq->length = view->length;
+	o_seq->cardinality = cardinality;
+	if ( view->stride && view->stride != view->width ){
+		o_seq->symbols = (uint8_t*) view;
+		o_seq->symbol_type = HMMP_SYMBOLS_VIEW;
+	}
+	else if ( symbol_type == HMMP_SYMBOLS_INT )
+		o_seq->sequence = (int_array*) view->data;
+	else {
+		o_seq->symbols = (uint8_t*) view->data;
+		o_seq->symbol_type = symbol_type;
+	}
+	return E_SUCCESS;
+}
+/* Append 'value' as a varint: 7 bits per byte, low bits first, the high bit set on all
+*  bytes but the last. Only counts the bytes if 'p' is 0. */
+static size_t hmmp_varint_put ( uint8_t *p, unsigned int value )
+{
+	size_t n = 1;
+	for ( ; value >= 0x80 ; value >>= 7, ++n )
+		if ( p )
+			*p++ = (uint8_t) ( value | 0x80 );
+	if ( p )
+		*p = (uint8_t) value;
+	return n;
+}
+
+static unsigned int hmmp_varint_get ( const uint8_t **io_p )
+{
+	const uint8_t *p = *io_p;
+	unsigned int value = 0;
+	int shift = 0;
+	do {
+		value |= (unsigned int) ( *p & 0x7F ) << shift;
+		shift += 7;
+	} while ( *p++ & 0x80 );
+	*io_p = p;
+	return value;
+}
+
+/* Append one run, only counts the bytes if 'p' is 0. */
+static size_t hmmp_rle_put ( uint8_t *p, int symbol, int run )
+{
+	size_t n = hmmp_varint_put ( p, (unsigned int) symbol );
+	return n + hmmp_varint_put ( p ? p + n : 0, (unsigned int) ( run - 1 ) );
+}
+
+size_t hmmp_rle_encode ( hmmp_Sequence seq, uint8_t *o_bytes )
+{
+	hmmp_Rle_Cursor c;
+	size_t n = 0;
+	int t, run = 0, symbol = 0, next;
+	hmmp_rle_seek ( &c, seq, 0 );
+	for ( t = 0 ; t < seq.length ; ++t ){
+		next = HMMP_NEXT_SYMBOL ( seq, t, c );
+		if ( run && next != symbol ){
+			n += hmmp_rle_put ( o_bytes ? o_bytes + n : 0, symbol, run );
+			run = 0;
+		}
+		symbol = next;
+		++run;
+	}
+	if ( run )
+		n += hmmp_rle_put ( o_bytes ? o_bytes + n : 0, symbol, run );
+	return n;
+}
+
+int hmmp_rle_advance ( hmmp_Rle_Cursor *cursor )
+{
+	cursor->symbol = (int) hmmp_varint_get ( &cursor->p );
+	cursor->remaining = (int) hmmp_varint_get ( &cursor->p );
+	return cursor->symbol;
+}
+
+int hmmp_rle_seek ( hmmp_Rle_Cursor *o_cursor, hmmp_Sequence seq, int t )
+{
+	int run;
+	if ( !o_cursor )
+		return E_PARAMETER;
+	o_cursor->p = seq.symbols;
+	o_cursor->symbol = 0;
+	o_cursor->remaining = 0;
+	if ( HMMP_SEQUENCE_TYPE ( seq ) != HMMP_SYMBOLS_RLE || t < 1 )
+		return E_SUCCESS;
+	if ( t >= seq.length )
+		return E_ARGUMENT;
+	// whole runs are skipped, the run holding 't' is left with its symbols from 't' on
+	for ( ;; ){
+		hmmp_rle_advance ( o_cursor );
+		run = o_cursor->remaining + 1;
+		if ( t < run )
+			break;
+		t -= run;
+	}
+	o_cursor->remaining = run - t;
+	// HMMP_RLE_NEXT() returns the symbol while 'remaining' is positive
+	return E_SUCCESS;
+}
+
+hmmp_Sequence *hmmp_create_sequence_rle ( hmmp_Sequence seq )
+{
+	hmmp_Sequence *rle;
+	size_t bytes;
+	if ( seq.length < 0 )
+		return 0;
+	bytes = hmmp_rle_encode ( seq, 0 );
+	if ( !(rle = ( hmmp_Sequence* ) malloc ( sizeof(hmmp_Sequence) )) )
+		return 0;
+	hmmp_sequence_init ( rle );
+	if ( !(rle->symbols = (uint8_t*) malloc ( bytes ? bytes : 1 )) ){
+		free ( rle );
+		return 0;
+	}
+	hmmp_rle_encode ( seq, rle->symbols );
+	rle->seq_id = seq.seq_id;
+	rle->length = seq.length;
+	rle->cardinality = seq.cardinality;
+	rle->symbol_type = HMMP_SYMBOLS_RLE;
+	return rle;
+}
+
+int hmmp_sequence_decode ( hmmp_Sequence seq, int t_begin, int count, int_array *o_symbols )
+{
+	hmmp_Rle_Cursor c;
+	int t;
+	if ( !o_symbols || ( !seq.sequence && !seq.symbols && seq.length ) )
+		return E_PARAMETER;
+	if ( t_begin < 0 || count < 0 || count > seq.length - t_begin )
+		return E_ARGUMENT;
+	if ( !count )
+		return E_SUCCESS;
+	hmmp_rle_seek ( &c, seq, t_begin );
+	for ( t = 0 ; t < count ; ++t )
+		o_symbols[t] = HMMP_NEXT_SYMBOL ( seq, t_begin + t, c );
+	return E_SUCCESS;
+}
+
 int hmmp_delete_sequence(hmmp_Sequence *seq)
 {
 	if ( !seq )
 		return E_PARAMETER;
-	free(seq->sequence);
+	if ( seq->sequence )
+		free(seq->sequence);
+	else
+		free(seq->symbols);
 	seq->cardinality=0;
 	seq->length=0;
 	seq->seq_id=-1;
@@ -227,42 +602,55 @@ int hmmp_delete_sequence(hmmp_Sequence *seq)
 	return E_SUCCESS;
 }
 
-hmmp_Sequence *hmmp_create_arr_seq(int count, int length, int num_symbols)
+hmmp_Sequence *hmmp_create_arr_seq_lengths(int count, int_array *lengths, int num_symbols)
 {
 	int i;
 	hmmp_Sequence *arr;
-	int e_overflow = 0;
-	unsigned int overflow[2];
-	overflow[0] = count;
-	overflow[1] = sizeof(hmmp_Sequence);
-	e_overflow |= hmmp_multiplication_overflow(overflow, 2);
-	overflow[0] = length;
-	overflow[1] = sizeof(int_array);
-	e_overflow |= hmmp_multiplication_overflow(overflow, 2);
-	if ( e_overflow )
+	if ( count < 1 || !lengths )
+		return 0;
+	for ( i = 0 ; i < count ; ++i )
+		if ( lengths[i] < 0 )
+			return 0;
+	if ( (size_t) count > SIZE_MAX / sizeof(hmmp_Sequence) )
 		return 0;
 	//allocate all sequences
 	arr = (hmmp_Sequence*)malloc(sizeof(hmmp_Sequence)*count);
 	if(!arr)
 		return 0;
 	for ( i = 0 ; i < count ; ++i ){
-		arr[i].sequence = (int_array*)malloc(sizeof(int_array)*length);
+		arr[i].sequence = (int_array*)malloc(sizeof(int_array)*(lengths[i] ? (size_t)lengths[i] : 1));
 		if(!(arr[i].sequence))
 			break;
+		arr[i].symbols = 0;
+		arr[i].symbol_type = HMMP_SYMBOLS_INT;
 		arr[i].seq_id = i;
-		arr[i].length = length;
+		arr[i].length = lengths[i];
 		arr[i].cardinality = num_symbols;
 	}
 	if(i!=count){
-		while(i+1){
+		while(i--)
 			free(arr[i].sequence);
-			--i;
-		}
 		free(arr);
 		return 0;
 	}
 	return arr;
 }
+hmmp_Sequence *hmmp_create_arr_seq(int count, int length, int num_symbols)
+{
+	int i;
+	hmmp_Sequence *arr;
+	int_array *lengths;
+	if ( count < 1 )
+		return 0;
+	lengths = hmmp_create_int_array ( count );
+	if ( !lengths )
+		return 0;
+	for ( i = 0 ; i < count ; ++i )
+		lengths[i] = length;
+	arr = hmmp_create_arr_seq_lengths ( count, lengths, num_symbols );
+	hmmp_delete_int_array ( lengths );
+	return arr;
+}
 int hmmp_delete_arr_seq(hmmp_Sequence *arr, int count)
 {
 	int i;
@@ -277,8 +665,315 @@ int hmmp_delete_arr_seq(hmmp_Sequence *arr, int count)
 	return E_SUCCESS;
 }
 
+/* Point a sequence to its symbols at 'p', stored as 'symbol_type'. */
+static void hmmp_sequence_bind ( hmmp_Sequence *seq, int symbol_type, uint8_t *p )
+{
+	seq->sequence = symbol_type == HMMP_SYMBOLS_INT ? (int_array*) p : 0;
+	seq->symbols = symbol_type == HMMP_SYMBOLS_INT ? 0 : p;
+	seq->symbol_type = symbol_type;
+}
+
+hmmp_Corpus *hmmp_create_corpus ( int max_seq, size_t max_length )
+{
+	return hmmp_create_corpus_typed ( max_seq, max_length, HMMP_SYMBOLS_INT );
+}
+hmmp_Corpus *hmmp_create_corpus_typed ( int max_seq, size_t max_length, int symbol_type )
+{
+	hmmp_Corpus *corpus;
+	size_t size = hmmp_symbol_size ( symbol_type );
+	if ( !size )
+		return 0;
+	if ( max_seq < 1 )
+		max_seq = 1;
+	if ( max_length < 1 )
+		max_length = 1;
+	if ( max_length > SIZE_MAX / size ||
+		 (size_t) max_seq > SIZE_MAX / sizeof(hmmp_Sequence) - 1 )
+		return 0;
+	corpus = (hmmp_Corpus*) calloc ( 1, sizeof(hmmp_Corpus) );
+	if ( !corpus )
+		return 0;
+	corpus->symbols = (int_array*) malloc ( size * max_length );
+	corpus->offsets = (size_t*) malloc ( sizeof(size_t) * ( max_seq + 1 ) );
+	corpus->seq_arr = (hmmp_Sequence*) malloc ( sizeof(hmmp_Sequence) * max_seq );
+	if ( !corpus->symbols || !corpus->offsets || !corpus->seq_arr ){
+		hmmp_delete_corpus ( corpus );
+		return 0;
+	}
+	corpus->max_seq = max_seq;
+	corpus->max_length = max_length;
+	corpus->symbol_type = symbol_type;
+	corpus->offsets[0] = 0;
+	return corpus;
+}
+int hmmp_delete_corpus ( hmmp_Corpus *corpus )
+{
+	if ( !corpus )
+		return E_PARAMETER;
+	free ( corpus->seq_arr );
+	free ( corpus->offsets );
+	free ( corpus->symbols );
+	free ( corpus );
+	return E_SUCCESS;
+}
+int hmmp_corpus_clear ( hmmp_Corpus *corpus )
+{
+	if ( !corpus )
+		return E_PARAMETER;
+	corpus->num_seq = 0;
+	corpus->total_length = 0;
+	corpus->offsets[0] = 0;
+	return E_SUCCESS;
+}
+int_array *hmmp_corpus_add_sequence ( hmmp_Corpus *corpus, int seq_id, int length,
+									  int cardinality )
+{
+	int k, max_seq;
+	size_t max_length, size;
+	void *p;
+	if ( !corpus || length < 0 )
+		return 0;
+	// coded runs have no fixed size, a compressed corpus can not grow
+	if ( !(size = hmmp_symbol_size ( corpus->symbol_type )) )
+		return 0;
+	// grow geometrically, so adding a sequence is amortized O(1)
+	if ( corpus->num_seq == corpus->max_seq ){
+		if ( corpus->max_seq > ( INT_MAX - 1 ) / 2 )
+			return 0;
+		max_seq = 2 * corpus->max_seq;
+		if ( !(p = realloc ( corpus->offsets, sizeof(size_t) * ( max_seq + 1 ) )) )
+			return 0;
+		corpus->offsets = (size_t*) p;
+		if ( !(p = realloc ( corpus->seq_arr, sizeof(hmmp_Sequence) * max_seq )) )
+			return 0;
+		corpus->seq_arr = (hmmp_Sequence*) p;
+		corpus->max_seq = max_seq;
+	}
+	if ( corpus->total_length + length > corpus->max_length ){
+		max_length = 2 * corpus->max_length;
+		if ( max_length < corpus->total_length + length )
+			max_length = corpus->total_length + length;
+		if ( max_length > SIZE_MAX / size )
+			return 0;
+		if ( !(p = realloc ( corpus->symbols, size * max_length )) )
+			return 0;
+		corpus->symbols = (int_array*) p;
+		corpus->max_length = max_length;
+		// the buffer may have moved, rebind the views
+		for ( k = 0 ; k < corpus->num_seq ; ++k )
+			hmmp_sequence_bind ( corpus->seq_arr + k, corpus->symbol_type,
+								 (uint8_t*) corpus->symbols + corpus->offsets[k] * size );
+	}
+	k = corpus->num_seq++;
+	corpus->seq_arr[k].seq_id = seq_id;
+	corpus->seq_arr[k].length = length;
+	corpus->seq_arr[k].cardinality = cardinality;
+	hmmp_sequence_bind ( corpus->seq_arr + k, corpus->symbol_type,
+						 (uint8_t*) corpus->symbols + corpus->offsets[k] * size );
+	corpus->offsets[k+1] = corpus->offsets[k] + length;
+	corpus->total_length += length;
+	return (int_array*) ( (uint8_t*) corpus->symbols + corpus->offsets[k] * size );
+}
+
+int hmmp_corpus_narrow ( hmmp_Corpus *corpus )
+{
+	int_array *ints;
+	uint16_t *words;
+	uint8_t *bytes;
+	size_t i, size;
+	int k, symbol_type, min_symbol = 0, max_symbol = 0;
+	void *p;
+
+	if ( !corpus )
+		return E_PARAMETER;
+	if ( corpus->symbol_type == HMMP_SYMBOLS_UINT8 || corpus->symbol_type == HMMP_SYMBOLS_RLE ||
+		 !corpus->total_length )
+		return E_SUCCESS;
+	if ( corpus->symbol_type == HMMP_SYMBOLS_UINT16 ){
+		words = (uint16_t*) corpus->symbols;
+		for ( i = 0 ; i < corpus->total_length ; ++i )
+			if ( words[i] > max_symbol )
+				max_symbol = words[i];
+	}
+	else
+		for ( i = 0 ; i < corpus->total_length ; ++i ){
+			if ( corpus->symbols[i] > max_symbol )
+				max_symbol = corpus->symbols[i];
+			if ( corpus->symbols[i] < min_symbol )
+				min_symbol = corpus->symbols[i];
+		}
+	if ( min_symbol < 0 || max_symbol > UINT16_MAX )
+		return E_SUCCESS;
+	symbol_type = max_symbol > UINT8_MAX ? HMMP_SYMBOLS_UINT16 : HMMP_SYMBOLS_UINT8;
+	if ( symbol_type == corpus->symbol_type )
+		return E_SUCCESS;
+	// in place and in order: symbol 'i' is written at or before the bytes it is read from
+	bytes = (uint8_t*) corpus->symbols;
+	words = (uint16_t*) corpus->symbols;
+	ints = corpus->symbols;
+	if ( corpus->symbol_type == HMMP_SYMBOLS_UINT16 )
+		for ( i = 0 ; i < corpus->total_length ; ++i )
+			bytes[i] = (uint8_t) words[i];
+	else if ( symbol_type == HMMP_SYMBOLS_UINT8 )
+		for ( i = 0 ; i < corpus->total_length ; ++i )
+			bytes[i] = (uint8_t) ints[i];
+	else
+		for ( i = 0 ; i < corpus->total_length ; ++i )
+			words[i] = (uint16_t) ints[i];
+	size = hmmp_symbol_size ( symbol_type );
+	// a failed shrink keeps the larger buffer
+	if ( ( p = realloc ( corpus->symbols, size * corpus->total_length ) ) ){
+		corpus->symbols = (int_array*) p;
+		corpus->max_length = corpus->total_length;
+	}
+	else
+		corpus->max_length = corpus->max_length * hmmp_symbol_size ( corpus->symbol_type ) / size;
+	corpus->symbol_type = symbol_type;
+	for ( k = 0 ; k < corpus->num_seq ; ++k )
+		hmmp_sequence_bind ( corpus->seq_arr + k, symbol_type,
+							 (uint8_t*) corpus->symbols + corpus->offsets[k] * size );
+	return E_SUCCESS;
+}
+
+int hmmp_corpus_compress ( hmmp_Corpus *corpus )
+{
+	uint8_t *runs;
+	size_t *bytes, total = 0;
+	int k;
+
+	if ( !corpus )
+		return E_PARAMETER;
+	if ( corpus->symbol_type == HMMP_SYMBOLS_RLE || !corpus->num_seq )
+		return E_SUCCESS;
+	if ( !(bytes = (size_t*) malloc ( sizeof ( size_t ) * corpus->num_seq )) )
+		return E_ALLOCATION;
+#pragma omp parallel for num_threads(HMMP_NUM_THREADS) schedule(dynamic,16)
+	for ( k = 0 ; k < corpus->num_seq ; ++k )
+		bytes[k] = hmmp_rle_encode ( corpus->seq_arr[k], 0 );
+	for ( k = 0 ; k < corpus->num_seq ; ++k )
+		total += bytes[k];
+	// runs which are not smaller than the symbols are not worth decoding
+	if ( total >= corpus->total_length * hmmp_symbol_size ( corpus->symbol_type ) ){
+		free ( bytes );
+		return E_SUCCESS;
+	}
+	if ( !(runs = (uint8_t*) malloc ( total ? total : 1 )) ){
+		free ( bytes );
+		return E_ALLOCATION;
+	}
+	for ( k = 0 ; k < corpus->num_seq ; ++k )
+		corpus->offsets[k+1] = corpus->offsets[k] + bytes[k];
+	free ( bytes );
+#pragma omp parallel for num_threads(HMMP_NUM_THREADS) schedule(dynamic,16)
+	for ( k = 0 ; k < corpus->num_seq ; ++k ){
+		hmmp_rle_encode ( corpus->seq_arr[k], runs + corpus->offsets[k] );
+		hmmp_sequence_bind ( corpus->seq_arr + k, HMMP_SYMBOLS_RLE, runs + corpus->offsets[k] );
+	}
+	free ( corpus->symbols );
+	corpus->symbols = (int_array*) runs;
+	corpus->total_length = total;
+	corpus->max_length = total;
+	corpus->symbol_type = HMMP_SYMBOLS_RLE;
+	return E_SUCCESS;
+}
+
+hmmp_Bw_Stats *hmmp_create_bw_stats ( int num_states, int num_symbols )
+{
+	hmmp_Bw_Stats *stats;
+	int e_overflow = 0;
+	size_t overflow[3];
+	if ( num_states < 1 || num_symbols < 1 )
+		return 0;
+	overflow[0] = num_states;
+	overflow[1] = (size_t)num_states + num_symbols + 3;
+	overflow[2] = sizeof(double);
+	e_overflow |= hmmp_multiplication_overflow(overflow, 3);
+	if ( e_overflow )
+		return 0;
+	stats = (hmmp_Bw_Stats*)malloc(sizeof(hmmp_Bw_Stats));
+	if(!stats)
+		return 0;
+	// one block: a_num | b_num | a_denom | b_denom | pi_new
+	stats->a_num = (dbl_matrix*)malloc(sizeof(double)*num_states*((size_t)num_states+num_symbols+3));
+	if(!(stats->a_num)){
+		free(stats);
+		return 0;
+	}
+	stats->b_num = stats->a_num + (size_t)num_states*num_states;
+	stats->a_denom = stats->b_num + (size_t)num_states*num_symbols;
+	stats->b_denom = stats->a_denom + num_states;
+	stats->pi_new = stats->b_denom + num_states;
+	stats->num_states = num_states;
+	stats->num_symbols = num_symbols;
+	stats->num_seq = 0;
+	stats->logP = 0.0;
+	return stats;
+}
+int hmmp_delete_bw_stats ( hmmp_Bw_Stats *stats )
+{
+	if(!stats)
+		return E_PARAMETER;
+	free(stats->a_num);
+	stats->num_states=0;
+	stats->num_symbols=0;
+	free(stats);
+	return E_SUCCESS;
+}
+
+hmmp_Symbol_Index *hmmp_create_symbol_index ( hmmp_Sequence *seq, int num_symbols )
+{
+	hmmp_Symbol_Index *index;
+	int k, t;
+	size_t overflow[2];
+	if ( !seq || ( !seq->sequence && !seq->symbols ) || num_symbols < 1 || seq->length < 0 ||
+		 HMMP_SEQUENCE_TYPE ( *seq ) == HMMP_SYMBOLS_RLE )
+		return 0;
+	overflow[0] = (size_t)num_symbols + 1 + seq->length;
+	overflow[1] = sizeof(int_array);
+	if ( hmmp_multiplication_overflow(overflow, 2) )
+		return 0;
+	for ( t = 0 ; t < seq->length ; ++t )
+		if ( HMMP_SYMBOL ( *seq, t ) < 0 || HMMP_SYMBOL ( *seq, t ) >= num_symbols )
+			return 0;
+	index = ( hmmp_Symbol_Index* ) malloc ( sizeof(hmmp_Symbol_Index) );
+	if ( !index )
+		return 0;
+	// offsets and positions share one block
+	index->offsets = hmmp_create_int_array ( (size_t)num_symbols + 1 + seq->length );
+	if ( !index->offsets ){
+		free(index);
+		return 0;
+	}
+	index->positions = index->offsets + num_symbols + 1;
+	index->length = seq->length;
+	index->num_symbols = num_symbols;
+	// counting sort of the time steps by symbol
+	for ( k = 0 ; k <= num_symbols ; ++k )
+		index->offsets[k] = 0;
+	for ( t = 0 ; t < seq->length ; ++t )
+		++index->offsets[HMMP_SYMBOL ( *seq, t )+1];
+	for ( k = 0 ; k < num_symbols ; ++k )
+		index->offsets[k+1] += index->offsets[k];
+	for ( t = 0 ; t < seq->length ; ++t )
+		index->positions[index->offsets[HMMP_SYMBOL ( *seq, t )]++] = t;
+	// the placement advanced each offset to the start of the next symbol
+	for ( k = num_symbols ; k > 0 ; --k )
+		index->offsets[k] = index->offsets[k-1];
+	index->offsets[0] = 0;
+	return index;
+}
+
+int hmmp_delete_symbol_index ( hmmp_Symbol_Index *index )
+{
+	if ( !index )
+		return E_PARAMETER;
+	hmmp_delete_int_array ( index->offsets );
+	free ( index );
+	return E_SUCCESS;
+}
+
 int hmmp_memop_overflow(int num_states, int seq_length){
-	unsigned int ovrfl[4];
+	size_t ovrfl[4];
 	ovrfl[0] = num_states;
 	ovrfl[1] = sizeof(double);
 	ovrfl[2] = seq_length;
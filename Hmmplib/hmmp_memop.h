@@ -27,11 +27,90 @@
 *	and their usage.
 */
 #include "hmmp_datatypes.h"
+#include <stddef.h>
+
+/// Alignment in bytes of the model parameters ( one cache line ).
+#define HMMP_ALIGNMENT 64
+
+/// Allocate a block of memory aligned at HMMP_ALIGNMENT bytes.
+/**
+*	@param[in] size Size of the block in bytes.
+*	@return Address of the block in heap. Zero 0 ( NULL ) on failure.
+*	@see hmmp_aligned_free()
+*/
+void *hmmp_aligned_alloc ( size_t size );
+
+/// Free a block allocated with hmmp_aligned_alloc().
+/**
+*	@param[in] p Address of the block.
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_aligned_free ( void *p );
+
+/// Size of a huge page in bytes.
+#define HMMP_HUGE_PAGE_SIZE ( 2 * 1024 * 1024 )
+/// Large buffer backed by regular pages.
+#define HMMP_PAGES_REGULAR	0
+/// Large buffer backed by reserved huge pages ( MAP_HUGETLB ).
+#define HMMP_PAGES_HUGETLB	1
+/// Large buffer backed by transparent huge pages ( MADV_HUGEPAGE ).
+#define HMMP_PAGES_THP		2
+
+/// Set the size from which large buffers are backed by huge pages.
+/**
+*	The state-by-time buffers of the algorithms ( 'alfa', 'beta', 'backtrack' ) are
+*	walked with strides of a whole time step, so on regular 4 KB pages nearly every
+*	time step is a TLB miss once they span gigabytes. Buffers created with
+*	hmmp_create_large_buffer() of at least 'num_bytes' bytes are mapped with 2 MB pages:
+*	reserved huge pages are tried first, then transparent huge pages are requested for
+*	a regular mapping, then the buffer falls back to the heap.
+*
+*	Huge pages are only used on Linux. The default threshold is 0, which disables them.
+*
+*	@param[in] num_bytes	Smallest buffer size backed by huge pages, 0 to disable.
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_set_huge_page_threshold ( size_t num_bytes );
+
+/// Create a large buffer, backed by huge pages if it reaches the threshold.
+/**
+*	The buffer is aligned at HMMP_ALIGNMENT bytes.
+*	@param[in] num_bytes	Size of the buffer in bytes.
+*	@return Address of the buffer. Zero 0 ( NULL ) on failure.
+*	@see hmmp_set_huge_page_threshold(), hmmp_delete_large_buffer()
+*/
+void *hmmp_create_large_buffer ( size_t num_bytes );
+
+/// Delete a buffer created with hmmp_create_large_buffer().
+/**
+*	@param[in] buffer Address of the buffer.
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_delete_large_buffer ( void *buffer );
+
+/// Kind of pages backing a buffer created with hmmp_create_large_buffer().
+/**
+*	Transparent huge pages are assigned by the kernel when the buffer is first touched,
+*	and not at all if they are disabled. For a buffer with transparent huge pages
+*	requested, /proc/self/smaps is read and HMMP_PAGES_THP is only returned if its mapping
+*	holds huge pages, so call it after the buffer was written.
+*
+*	@param[in] buffer Address of the buffer.
+*	@return HMMP_PAGES_REGULAR, HMMP_PAGES_HUGETLB or HMMP_PAGES_THP.
+*			@ref hmmp_Error Error code on failure.
+*/
+int hmmp_large_buffer_pages ( void *buffer );
+
 /// Create an empty model.
 /**
 *	In order to use the model it has to be initialized. Function declarations for 
 *	initialization can be found in hmmp_generate.h and hmmp_file.h.
 *	Always delete model after use with the model delete function listed below.
+*
+*	The model and its parameters are allocated as one block. The initial, transition
+*	and emission arrays each start at a HMMP_ALIGNMENT byte boundary, the matrices
+*	remain densely row-major as described in @ref datafilelayout "Data Layout".
+*	The parameter arrays can not be freed or replaced individually.
 *	@param[in] num_states	Number of possible states in the model.
 *	@param[in] num_symbols	Number of possible symbols emitted by the model.
 *
@@ -69,10 +148,28 @@ hmmp_Model *hmmp_create_model_copy ( hmmp_Model *source );
 *	@param[in] num_symbols	Number of possible symbols emitted by the models.
 *	@return		Address of the new model in heap. Zero 0 ( NULL ) on failure.
 *
+*	All models and their parameters are allocated as one slab, with the parameter
+*	arrays aligned as in hmmp_create_model().
+*
 *	@see hmmp_delete_arr_models()
 */
 hmmp_Model *hmmp_create_arr_models ( int count, int num_states, int num_symbols );
 
+/// Create an array of emtpy models with different numbers of states and symbols.
+/**
+*	Same as hmmp_create_arr_models(), but model 'i' has num_states[i] states and
+*	num_symbols[i] symbols.
+*	
+*	@param[in] count		Number of models to be created.
+*	@param[in] num_states	Array with the number of states of each model.
+*	@param[in] num_symbols	Array with the number of symbols of each model.
+*	@return		Address of the new model in heap. Zero 0 ( NULL ) on failure.
+*
+*	@see hmmp_delete_arr_models()
+*/
+hmmp_Model *hmmp_create_arr_models_dims ( int count, int_array *num_states,
+										  int_array *num_symbols );
+
 /// Delete an array of previously created models.
 /** 
 *	@param[in]	arr		Address of the array to be deleted.
@@ -87,7 +184,7 @@ int hmmp_delete_arr_models(hmmp_Model *arr, int count);
 *	@return Address of the new array in heap. Zero 0 ( NULL ) on failure.
 *	@see hmmp_delete_dbl_array()
 */
-dbl_array *hmmp_create_dbl_array(unsigned num_elements);
+dbl_array *hmmp_create_dbl_array(size_t num_elements);
 
 /// Delete an array ( vector ) of real double precision floating-point numbers.
 /** 
@@ -106,7 +203,7 @@ int hmmp_delete_dbl_array(dbl_array* arr);
 *	@return Address of the new matrix in heap. Zero 0 ( NULL ) on failure.
 *	@see hmmp_delete_dbl_matrix()
 */
-dbl_matrix *hmmp_create_dbl_matrix(unsigned num_elements);
+dbl_matrix *hmmp_create_dbl_matrix(size_t num_elements);
 
 /// Delete a previously created matrix of real double precision floating-point numbers.
 /** 
@@ -122,7 +219,7 @@ int hmmp_delete_dbl_matrix(dbl_matrix* mat);
 *	@return Address of the new array in heap. Zero 0 ( NULL ) on failure.
 *	@see hmmp_delete_int_array()
 */
-int_array *hmmp_create_int_array(unsigned num_elements);
+int_array *hmmp_create_int_array(size_t num_elements);
 
 /// Delete a previously created array (vector) of integers.
 /** 
@@ -142,7 +239,7 @@ int hmmp_delete_int_array(int_array* arr);
 *	@return Address of the new matrix in heap. Zero 0 ( NULL ) on failure.
 *	@see hmmp_delete_int_matrix()
 */
-int_matrix *hmmp_create_int_matrix(unsigned num_elements);
+int_matrix *hmmp_create_int_matrix(size_t num_elements);
 
 /// Delete a previously created matrix of integers.
 /** 
@@ -166,6 +263,120 @@ int hmmp_delete_int_matrix(int_matrix* mat);
 */
 hmmp_Sequence *hmmp_create_sequence( int length );
 
+/// Create an empty sequence with symbols of the given storage type.
+/**
+*	Same as hmmp_create_sequence(), with symbols stored as int, uint8_t or uint16_t.
+*	All the algorithms read the narrow types directly, see HMMP_SYMBOL().
+*
+*	@param[in] length		Desired lenth of the new sequence
+*	@param[in] symbol_type	HMMP_SYMBOLS_INT, HMMP_SYMBOLS_UINT8 or HMMP_SYMBOLS_UINT16
+*	@return	Address of the new sequence in heap. Zero 0 ( NULL ) on failure.
+*	@see hmmp_delete_sequence()
+*/
+hmmp_Sequence *hmmp_create_sequence_typed ( int length, int symbol_type );
+
+/// Initialize a sequence as empty, with int symbols.
+/**
+*	Same as assigning HMMP_SEQUENCE_INIT. Use it for a sequence declared on the stack or
+*	allocated with malloc() before filling it in by hand.
+*
+*	@param[out] o_seq	Address of the sequence to initialize
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_sequence_init ( hmmp_Sequence *o_seq );
+
+/// Make a sequence which reads its symbols from memory owned by the caller.
+/**
+*	Nothing is allocated or copied, the sequence reads the symbols described by 'view'
+*	directly from view->data, which must stay valid and unchanged while the sequence is
+*	used. The symbols are unsigned bytes, unsigned 16 bit or int values, view->stride bytes
+*	apart, so a column of an array of records or every other element of an array can be
+*	read in place. Consecutive symbols are pointed to directly; otherwise the sequence
+*	reads them through 'view' ( HMMP_SYMBOLS_VIEW ), which must then outlive it too.
+*	The sequence is passed to the algorithms like any other sequence, never delete it with
+*	hmmp_delete_sequence(). With view->width 0 the data are the runs of hmmp_rle_encode(),
+*	e.g. a sequence of a packed file mapped with hmmp_map_corpus(), and view->stride must
+*	be 0. Example:
+*	\code{.c}
+*		hmmp_Sequence_View view = { (const uint8_t*) &records[0].symbol, num_records,
+*									sizeof ( records[0].symbol ), sizeof ( records[0] ) };
+*		hmmp_Sequence seq;
+*		hmmp_sequence_view ( &seq, &view, 1, 20 );
+*	\endcode
+*
+*	@param[out] o_seq		Address of the sequence to initialize
+*	@param[in] view			The symbols: view->data aligned to view->width, which is 1, 2
+*							or 4 ( 0 for coded runs ), and view->stride a multiple of it
+*							( 0 or the width for consecutive symbols, negative to read
+*							backwards )
+*	@param[in] seq_id		ID of the sequence
+*	@param[in] cardinality	Number of different possible symbols
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_sequence_view ( hmmp_Sequence *o_seq, const hmmp_Sequence_View *view, int seq_id,
+						 int cardinality );
+
+/// Size in bytes of one symbol of a storage type.
+/**
+*	@param[in] symbol_type	HMMP_SYMBOLS_INT, HMMP_SYMBOLS_UINT8 or HMMP_SYMBOLS_UINT16
+*	@return	Size of one symbol, 0 for HMMP_SYMBOLS_RLE or an unknown type.
+*/
+size_t hmmp_symbol_size ( int symbol_type );
+
+/// Code the symbols of a sequence as runs of equal symbols.
+/**
+*	Each run is two varints: the symbol, then the length of the run minus one. A varint
+*	holds 7 bits per byte, low bits first, with the high bit set on all bytes but the last.
+*	A run of up to 128 symbols below 128 takes 2 bytes.
+*
+*	@param[in] seq			The sequence to code, of any storage type
+*	@param[out] o_bytes		Address of a buffer to receive the runs, or 0 to only count them
+*	@return	Number of bytes of the runs.
+*/
+size_t hmmp_rle_encode ( hmmp_Sequence seq, uint8_t *o_bytes );
+
+/// Decode the next run at a cursor and return its first symbol, used by HMMP_RLE_NEXT().
+/**
+*	@param[in,out] cursor	The cursor to advance
+*	@return	The first symbol of the run.
+*/
+int hmmp_rle_advance ( hmmp_Rle_Cursor *cursor );
+
+/// Position a cursor on symbol 't' of a sequence.
+/**
+*	The symbols from 't' on are then read with HMMP_NEXT_SYMBOL(). Only a sequence of type
+*	HMMP_SYMBOLS_RLE uses the cursor, the runs before 't' are skipped one by one.
+*
+*	@param[out] o_cursor	The cursor to position
+*	@param[in] seq			The sequence to read
+*	@param[in] t			Index of the next symbol to read
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_rle_seek ( hmmp_Rle_Cursor *o_cursor, hmmp_Sequence seq, int t );
+
+/// Create a copy of a sequence compressed into runs of equal symbols.
+/**
+*	The new sequence is of type HMMP_SYMBOLS_RLE, see hmmp_rle_encode(). Evaluation and
+*	decoding read it directly, the Forward and Viterbi kernels decode one run at a time.
+*	The algorithms reading the symbols backwards ( the Backward algorithm and Baum-Welch
+*	learning ) do not accept it, use hmmp_sequence_decode() for them.
+*
+*	@param[in] seq	The sequence to compress, of any storage type
+*	@return	Address of the new sequence in heap. Zero 0 ( NULL ) on failure.
+*	@see hmmp_delete_sequence()
+*/
+hmmp_Sequence *hmmp_create_sequence_rle ( hmmp_Sequence seq );
+
+/// Decode consecutive symbols of a sequence of any storage type to int.
+/**
+*	@param[in] seq			The sequence to read
+*	@param[in] t_begin		Index of the first symbol
+*	@param[in] count		Number of symbols
+*	@param[out] o_symbols	Address of an array to receive 'count' symbols
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_sequence_decode ( hmmp_Sequence seq, int t_begin, int count, int_array *o_symbols );
+
 /// Safely delete a sequence.
 /**
 *	@param[in]	seq	Adress of the previously created sequence to be deleted.
@@ -187,14 +398,166 @@ int hmmp_delete_sequence(hmmp_Sequence *seq);
 */
 hmmp_Sequence *hmmp_create_arr_seq(int count, int length, int num_symbols);
 
+/// Create an array of empty sequences with different lengths
+/**
+*	Same as hmmp_create_arr_seq(), but sequence 'i' has the length lengths[i].
+*	To keep the symbols of many sequences in one block use a corpus, see
+*	hmmp_create_corpus().
+*	
+*	@param[in] count		Number of sequences to be created
+*	@param[in] lengths		Array with the length of each sequence
+*	@param[in] num_symbols	Number of different possible symbols each sequence
+*	@return		Address of the resulting array of sequences. Zero 0 ( NULL ) on failure
+*
+*	@see hmmp_delete_arr_seq()
+*/
+hmmp_Sequence *hmmp_create_arr_seq_lengths(int count, int_array *lengths, int num_symbols);
+
 /// Delete an array of previously created sequences.
 /** 
+*	The symbols of every sequence and the array are freed. Never use it for the
+*	sequences of a corpus ( corpus->seq_arr ), delete the corpus instead.
+*
 *	@param[in]	arr		Address of the array to be deleted.
 *	@param[in]	count	Number of sequences in the array to be deleted.
 *	@return	0 Success.
 */
 int hmmp_delete_arr_seq(hmmp_Sequence *arr, int count);
 
+/// Create an empty corpus of sequences.
+/**
+*	The corpus grows automatically when sequences are added with
+*	hmmp_corpus_add_sequence(), the capacities only avoid the growing when the size of the
+*	corpus is known in advance.
+*
+*	@param[in] max_seq		Initial capacity for the number of sequences
+*	@param[in] max_length	Initial capacity for the total number of symbols
+*	@return	Address of the new corpus in heap. Zero 0 ( NULL ) on failure.
+*
+*	@see hmmp_delete_corpus()
+*/
+hmmp_Corpus *hmmp_create_corpus ( int max_seq, size_t max_length );
+
+/// Create an empty corpus of sequences with symbols of the given storage type.
+/**
+*	Same as hmmp_create_corpus(), with the symbols of all sequences stored as int,
+*	uint8_t or uint16_t. The sequences of corpus->seq_arr have the same type.
+*
+*	@param[in] max_seq		Initial capacity for the number of sequences
+*	@param[in] max_length	Initial capacity for the total number of symbols
+*	@param[in] symbol_type	HMMP_SYMBOLS_INT, HMMP_SYMBOLS_UINT8 or HMMP_SYMBOLS_UINT16
+*	@return	Address of the new corpus in heap. Zero 0 ( NULL ) on failure.
+*
+*	@see hmmp_delete_corpus()
+*/
+hmmp_Corpus *hmmp_create_corpus_typed ( int max_seq, size_t max_length, int symbol_type );
+
+/// Delete a corpus with all its sequences.
+/**
+*	@param[in] corpus Address of the previously created corpus to be deleted.
+*	@return @ref hmmp_Error Error code.
+*	@see hmmp_create_corpus()
+*/
+int hmmp_delete_corpus ( hmmp_Corpus *corpus );
+
+/// Remove all sequences from a corpus and keep its buffers.
+/**
+*	The corpus can be filled again with hmmp_corpus_add_sequence() without allocating,
+*	as long as it does not grow over its previous size.
+*
+*	@param[in,out] corpus	The corpus to clear
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_corpus_clear ( hmmp_Corpus *corpus );
+
+/// Append an uninitialized sequence to a corpus.
+/**
+*	The symbols of the new sequence follow the symbols of the previous one. When the corpus
+*	has to grow its buffers may move: the views in corpus->seq_arr are updated, but
+*	pointers to symbols obtained earlier become invalid.
+*
+*	@param[in,out] corpus	The corpus to add the sequence to
+*	@param[in] seq_id		ID of the new sequence
+*	@param[in] length		Length of the new sequence
+*	@param[in] cardinality	Number of different possible symbols of the sequence
+*	@return	Address of the symbols of the new sequence, to be filled by the caller. For a
+*			corpus of narrow symbols it points to corpus->symbol_type symbols.
+*			Zero 0 ( NULL ) on failure or for a compressed corpus, the corpus is left
+*			unchanged.
+*/
+int_array *hmmp_corpus_add_sequence ( hmmp_Corpus *corpus, int seq_id, int length,
+									  int cardinality );
+
+/// Store the symbols of a corpus in the narrowest type that holds them.
+/**
+*	The symbols are converted in place to uint8_t if they are all below 256, to uint16_t
+*	if they are all below 65536, and the buffer is shrunk. Otherwise, or if a symbol is
+*	negative, the corpus is left unchanged. The views in corpus->seq_arr are updated, the
+*	algorithms read the narrow symbols directly.
+*
+*	@param[in,out] corpus	The corpus to narrow
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_corpus_narrow ( hmmp_Corpus *corpus );
+
+/// Compress the sequences of a corpus into runs of equal symbols.
+/**
+*	All sequences become HMMP_SYMBOLS_RLE, see hmmp_create_sequence_rle(), and the symbols
+*	are replaced by the coded runs. Meant for corpora with long runs of the same symbol:
+*	if the runs would not be smaller than the symbols the corpus is left unchanged.
+*	A compressed corpus can not grow.
+*
+*	@param[in,out] corpus	The corpus to compress
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_corpus_compress ( hmmp_Corpus *corpus );
+
+/// Create an empty container for the expected counts of the Baum-Welch algorithm.
+/**
+*	All the count arrays are allocated in a single block. Use hmmp_bw_stats_reset() to
+*	initialize the counts before accumulating.
+*	Always delete the container after use with the delete function listed below.
+*
+*	@param[in] num_states	Number of states of the trained model.
+*	@param[in] num_symbols	Number of symbols of the trained model.
+*	@return	Address of the new container in heap. Zero 0 ( NULL ) on failure or when a
+*			dimension is below 1.
+*
+*	@see hmmp_delete_bw_stats()
+*/
+hmmp_Bw_Stats *hmmp_create_bw_stats ( int num_states, int num_symbols );
+
+/// Delete a container of expected counts.
+/**
+*	@param[in] stats Address of the previously created container to be deleted.
+*	@return @ref hmmp_Error Error code.
+*	@see hmmp_create_bw_stats()
+*/
+int hmmp_delete_bw_stats ( hmmp_Bw_Stats *stats );
+
+/// Create the index of the time steps of a sequence grouped by symbol.
+/**
+*	The index is built with a counting sort in O(T + M) and can be reused as long as the
+*	sequence does not change. It is used by hmmp_bwa_fused_reest_index_alg().
+*
+*	@param[in] seq			The sequence to be indexed
+*	@param[in] num_symbols	Number of observable symbols ( M )
+*	@return	Address of the new index in heap. Zero 0 ( NULL ) on failure, for a sequence
+*			of type HMMP_SYMBOLS_RLE or when the sequence contains a symbol outside
+*			[0, num_symbols).
+*
+*	@see hmmp_delete_symbol_index()
+*/
+hmmp_Symbol_Index *hmmp_create_symbol_index ( hmmp_Sequence *seq, int num_symbols );
+
+/// Delete an index of a sequence.
+/**
+*	@param[in] index Address of the previously created index to be deleted.
+*	@return @ref hmmp_Error Error code.
+*	@see hmmp_create_symbol_index()
+*/
+int hmmp_delete_symbol_index ( hmmp_Symbol_Index *index );
+
 /// Check if overflow will occur in the multiplication of argument of memory allocation functions
 /** 
 *	When working with models with large state spaces and/or testing against very long sequences
@@ -215,6 +578,8 @@ int hmmp_delete_arr_seq(hmmp_Sequence *arr, int count);
 *	'ret' will be 0 or 'False' when overflow can not occur with **proper usage** of the 
 *	allocation functions.
 *	
+*	The allocation functions take size_t and the algorithms index the buffers with size_t,
+*	so the limit is the address space of the platform, not the range of int.
 *
 *	@param[in]	num_states	Number of states in the used model
 *	@param[in]	seq_length	Length of the sequence you test the model against
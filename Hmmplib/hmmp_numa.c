@@ -0,0 +1,261 @@
+#ifdef __linux__
+#define _GNU_SOURCE	// sched_setaffinity(), sched_getcpu() and the CPU_* macros
+#endif
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#include "hmmp_numa.h"
+#include "hmmp_datatypes.h"
+#include "hmmp_memop.h"
+#include "hmmp_workspace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#define HMMP_NUMA_MAX_NODES 256
+
+static int hmmp_numa_ready = 0;
+static int hmmp_numa_nodes = 1;
+static int hmmp_numa_policy = HMMP_AFFINITY_NONE;
+static int hmmp_numa_replicate = 0;
+// incremented on every change of the policy, each thread compares it with its own copy
+static int hmmp_numa_generation = 0;
+static int hmmp_thread_generation = 0;
+#pragma omp threadprivate(hmmp_thread_generation)
+
+#ifdef __linux__
+static cpu_set_t hmmp_numa_initial_set;		// CPUs of the process before any pinning
+static int hmmp_numa_num_cpus = 0;			// number of CPUs in 'initial_set'
+static int hmmp_numa_cpu_node[CPU_SETSIZE];	// node of each CPU, -1 if not available
+static int hmmp_numa_order[CPU_SETSIZE];	// CPUs in the order of the affinity policy
+
+/* Read a sysfs CPU list like "0-3,8-11" and assign its available CPUs to 'node'.
+*  Returns the number of CPUs assigned. */
+static int hmmp_numa_parse_cpulist ( FILE *file, int node )
+{
+	int first, last, cpu, sep, count = 0;
+	while ( fscanf ( file, "%d", &first ) == 1 ){
+		last = first;
+		sep = fgetc ( file );
+		if ( sep == '-' ){
+			if ( fscanf ( file, "%d", &last ) != 1 )
+				break;
+			sep = fgetc ( file );
+		}
+		for ( cpu = first < 0 ? 0 : first ; cpu <= last && cpu < CPU_SETSIZE ; ++cpu ){
+			if ( CPU_ISSET ( cpu, &hmmp_numa_initial_set ) && hmmp_numa_cpu_node[cpu] < 0 ){
+				hmmp_numa_cpu_node[cpu] = node;
+				++count;
+			}
+		}
+		if ( sep != ',' )
+			break;
+	}
+	return count;
+}
+#endif
+
+static void hmmp_numa_init ( void )
+{
+#ifdef __linux__
+	char path[64];
+	FILE *file;
+	int node, cpu;
+#endif
+	#pragma omp critical ( hmmp_numa )
+	{
+	if ( !hmmp_numa_ready ){
+#ifdef __linux__
+		if ( sched_getaffinity ( 0, sizeof ( cpu_set_t ), &hmmp_numa_initial_set ) )
+			CPU_ZERO ( &hmmp_numa_initial_set );
+		for ( cpu = 0 ; cpu < CPU_SETSIZE ; ++cpu )
+			hmmp_numa_cpu_node[cpu] = -1;
+		// nodes without available CPUs are skipped, so the node indices are dense
+		hmmp_numa_nodes = 0;
+		for ( node = 0 ; node < HMMP_NUMA_MAX_NODES ; ++node ){
+			sprintf ( path, "/sys/devices/system/node/node%d/cpulist", node );
+			if ( !(file = fopen ( path, "r" )) )
+				continue;
+			if ( hmmp_numa_parse_cpulist ( file, hmmp_numa_nodes ) )
+				++hmmp_numa_nodes;
+			fclose ( file );
+		}
+		if ( !hmmp_numa_nodes )
+			hmmp_numa_nodes = 1;
+		hmmp_numa_num_cpus = 0;
+		for ( cpu = 0 ; cpu < CPU_SETSIZE ; ++cpu ){
+			if ( !CPU_ISSET ( cpu, &hmmp_numa_initial_set ) )
+				continue;
+			if ( hmmp_numa_cpu_node[cpu] < 0 )
+				hmmp_numa_cpu_node[cpu] = 0;
+			++hmmp_numa_num_cpus;
+		}
+#endif
+		hmmp_numa_ready = 1;
+	}
+	}
+}
+
+int hmmp_numa_set_affinity ( int policy )
+{
+#ifdef __linux__
+	int node, cpu, round, count, placed;
+#endif
+	if ( policy < HMMP_AFFINITY_NONE || policy > HMMP_AFFINITY_SCATTER )
+		return E_ARGUMENT;
+#ifdef __linux__
+	hmmp_numa_init ();
+	if ( policy != HMMP_AFFINITY_NONE && !hmmp_numa_num_cpus )
+		return E_UNSUPPORTED;
+	count = 0;
+	if ( policy == HMMP_AFFINITY_COMPACT ){
+		for ( node = 0 ; node < hmmp_numa_nodes ; ++node )
+			for ( cpu = 0 ; cpu < CPU_SETSIZE ; ++cpu )
+				if ( CPU_ISSET ( cpu, &hmmp_numa_initial_set ) && hmmp_numa_cpu_node[cpu] == node )
+					hmmp_numa_order[count++] = cpu;
+	}
+	else if ( policy == HMMP_AFFINITY_SCATTER ){
+		// in each round take the next CPU of every node
+		for ( round = 0 ; count < hmmp_numa_num_cpus ; ++round ){
+			for ( node = 0 ; node < hmmp_numa_nodes ; ++node ){
+				placed = 0;
+				for ( cpu = 0 ; cpu < CPU_SETSIZE ; ++cpu ){
+					if ( !CPU_ISSET ( cpu, &hmmp_numa_initial_set ) || hmmp_numa_cpu_node[cpu] != node )
+						continue;
+					if ( placed++ == round ){
+						hmmp_numa_order[count++] = cpu;
+						break;
+					}
+				}
+			}
+		}
+	}
+	if ( policy == hmmp_numa_policy )
+		return E_SUCCESS;
+	hmmp_numa_policy = policy;
+	++hmmp_numa_generation;
+	// the buffers of the threads were placed on their previous nodes
+	hmmp_workspace_trim ();
+	return E_SUCCESS;
+#else
+	if ( policy != HMMP_AFFINITY_NONE )
+		return E_UNSUPPORTED;
+	return E_SUCCESS;
+#endif
+}
+
+int hmmp_numa_set_replication ( int enable )
+{
+	hmmp_numa_replicate = enable ? 1 : 0;
+	return E_SUCCESS;
+}
+
+int hmmp_numa_num_nodes ( void )
+{
+	if ( !hmmp_numa_ready )
+		hmmp_numa_init ();
+	return hmmp_numa_nodes;
+}
+
+int hmmp_numa_node ( void )
+{
+#ifdef __linux__
+	int cpu;
+	if ( !hmmp_numa_ready )
+		hmmp_numa_init ();
+	cpu = sched_getcpu ();
+	if ( cpu < 0 || cpu >= CPU_SETSIZE || hmmp_numa_cpu_node[cpu] < 0 )
+		return 0;
+	return hmmp_numa_cpu_node[cpu];
+#else
+	return 0;
+#endif
+}
+
+void hmmp_numa_bind_thread ( void )
+{
+#ifdef __linux__
+	cpu_set_t set;
+	if ( hmmp_thread_generation == hmmp_numa_generation || omp_get_level () > 1 )
+		return;
+	hmmp_thread_generation = hmmp_numa_generation;
+	if ( hmmp_numa_policy == HMMP_AFFINITY_NONE )
+		set = hmmp_numa_initial_set;
+	else {
+		CPU_ZERO ( &set );
+		CPU_SET ( hmmp_numa_order[omp_get_thread_num () % hmmp_numa_num_cpus], &set );
+	}
+	sched_setaffinity ( 0, sizeof ( cpu_set_t ), &set );
+#endif
+}
+
+hmmp_Model_Replicas *hmmp_numa_create_replicas ( hmmp_Model *model )
+{
+	hmmp_Model_Replicas *replicas;
+	int num_nodes;
+	if ( !model )
+		return 0;
+	replicas = (hmmp_Model_Replicas*) calloc ( 1, sizeof ( hmmp_Model_Replicas ) );
+	if ( !replicas )
+		return 0;
+	replicas->source = model;
+	num_nodes = hmmp_numa_num_nodes ();
+	if ( hmmp_numa_replicate && num_nodes > 1 ){
+		replicas->replica = (hmmp_Model**) calloc ( num_nodes, sizeof ( hmmp_Model* ) );
+		if ( !replicas->replica ){
+			free ( replicas );
+			return 0;
+		}
+		replicas->num_nodes = num_nodes;
+	}
+	return replicas;
+}
+
+hmmp_Model *hmmp_numa_local_model ( hmmp_Model_Replicas *replicas )
+{
+	hmmp_Model *model;
+	int node;
+	if ( !replicas->num_nodes )
+		return replicas->source;
+	node = hmmp_numa_node ();
+	#pragma omp critical ( hmmp_numa_replicas )
+	{
+		// the copy is written by this thread, so its pages are placed on this node
+		if ( !replicas->replica[node] )
+			replicas->replica[node] = hmmp_create_model_copy ( replicas->source );
+		model = replicas->replica[node];
+	}
+	return model ? model : replicas->source;
+}
+
+int hmmp_numa_delete_replicas ( hmmp_Model_Replicas *replicas )
+{
+	int node;
+	if ( !replicas )
+		return E_PARAMETER;
+	for ( node = 0 ; node < replicas->num_nodes ; ++node )
+		if ( replicas->replica[node] )
+			hmmp_delete_model ( replicas->replica[node] );
+	free ( replicas->replica );
+	free ( replicas );
+	return E_SUCCESS;
+}
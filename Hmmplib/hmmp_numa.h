@@ -0,0 +1,123 @@
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#ifndef HMMP_NUMA_H
+#define HMMP_NUMA_H
+/** @file
+*	This file contains the NUMA placement of the inference entry points hmmp_decode(),
+*	hmmp_evaluate_models(), hmmp_evaluate_sequences() and of the Baum-Welch training.
+*
+*	Memory is placed on the node of the thread touching it first. The workspaces
+*	( hmmp_workspace.h ) are first touched by the thread allocating them and a thread
+*	prefers a workspace of its own node, so they stay local as long as the threads do not
+*	move to another node. Two
+*	optional policies make that hold on multi-socket machines:
+*		- Affinity: every thread of the OpenMP team is pinned to one CPU, either filling
+*		  one node after the other ( HMMP_AFFINITY_COMPACT ) or spreading the threads
+*		  round-robin over the nodes ( HMMP_AFFINITY_SCATTER ).
+*		- Replication: the model read by all threads is copied once per node, so the
+*		  threads read their node's copy instead of crossing the interconnect.
+*
+*	Both are off by default. The topology is read from /sys/devices/system/node, only
+*	the CPUs the process is allowed to run on are used. Pinning is available on Linux
+*	only, elsewhere every node query reports a single node.
+*/
+#include "hmmp_datatypes.h"
+
+/// Threads are not pinned, the operating system places them.
+#define HMMP_AFFINITY_NONE		0
+/// Threads are pinned to consecutive CPUs, filling one node after the other.
+#define HMMP_AFFINITY_COMPACT	1
+/// Threads are pinned round-robin over the nodes.
+#define HMMP_AFFINITY_SCATTER	2
+
+/// Set the affinity policy for the threads of the library.
+/**
+*	The policy is applied by each thread at the start of the next parallel region of the
+*	library, thread 'k' of the team is pinned to the k-th CPU of the policy order. 
+*	HMMP_AFFINITY_NONE restores the CPU set the process started with. Changing the policy
+*	releases the buffers of the workspaces ( hmmp_workspace_trim() ), so they are allocated
+*	again on the new nodes of their threads.
+*	**Must not be called while any thread executes a function of the library.**
+*
+*	@param[in] policy	HMMP_AFFINITY_NONE, HMMP_AFFINITY_COMPACT or HMMP_AFFINITY_SCATTER
+*	@return @ref hmmp_Error Error code. E_UNSUPPORTED if threads can not be pinned on this
+*			platform.
+*/
+int hmmp_numa_set_affinity ( int policy );
+
+/// Turn the per-node replication of the models on or off.
+/**
+*	Affects the calls of hmmp_numa_create_replicas() made afterwards. Replication has
+*	no effect on a machine with one node.
+*
+*	@param[in] enable	1 to replicate the models, 0 to share one copy.
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_numa_set_replication ( int enable );
+
+/// Number of NUMA nodes with CPUs available to the process.
+/**
+*	@return Number of nodes, 1 if the topology is not known.
+*/
+int hmmp_numa_num_nodes ( void );
+
+/// NUMA node of the CPU the calling thread runs on.
+/**
+*	@return Index of the node, from 0 to hmmp_numa_num_nodes()-1.
+*/
+int hmmp_numa_node ( void );
+
+/// Apply the affinity policy to the calling thread.
+/**
+*	Called by the library at the start of each parallel region. Does nothing if the
+*	thread already follows the current policy or is not a thread of the outermost team.
+*/
+void hmmp_numa_bind_thread ( void );
+
+/// Create empty per-node replicas of a model.
+/**
+*	The copies are created on first use by hmmp_numa_local_model(). The source model
+*	must not change while the replicas exist.
+*
+*	@param[in] model Address of the model to be replicated.
+*	@return Address of the new replicas in heap. Zero 0 ( NULL ) on failure.
+*	@see hmmp_numa_delete_replicas()
+*/
+hmmp_Model_Replicas *hmmp_numa_create_replicas ( hmmp_Model *model );
+
+/// Get the copy of the model on the node of the calling thread.
+/**
+*	The first thread of a node to call the function creates the node's copy, so the
+*	copy is placed on that node. If the copy can not be created the source model is
+*	returned.
+*
+*	@param[in] replicas Address of the replicas.
+*	@return Address of the model to be read by the calling thread.
+*/
+hmmp_Model *hmmp_numa_local_model ( hmmp_Model_Replicas *replicas );
+
+/// Delete the replicas of a model. The source model is not deleted.
+/**
+*	@param[in] replicas Address of the replicas to be deleted.
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_numa_delete_replicas ( hmmp_Model_Replicas *replicas );
+
+#endif
@@ -0,0 +1,513 @@
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#include "hmmp_numconv.h"
+#include "hmmp_datatypes.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <locale.h>
+#include <stdio.h>
+
+// longest number passed to the C library
+#define HMMP_NUMCONV_MAX_TOKEN 511
+
+static const double hmmp_pow10[23] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#if LDBL_MANT_DIG == 64
+// all exact in the 64 bit mantissa of the extended precision
+static const long double hmmp_pow10_ext[28] = {
+	1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L,
+	1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L,
+	1e26L, 1e27L
+};
+#endif
+
+static int hmmp_is_space ( char c )
+{
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+int hmmp_parse_int ( const char **io_p, const char *end, int *o_value )
+{
+	const char *p = *io_p;
+	long long value = 0;
+	int negative = 0;
+
+	while ( p < end && hmmp_is_space ( *p ) )
+		++p;
+	if ( p < end && ( *p == '-' || *p == '+' ) )
+		negative = *p++ == '-';
+	if ( p == end || *p < '0' || *p > '9' )
+		return E_FILE_FORMAT;
+	for ( ; p < end && *p >= '0' && *p <= '9' ; ++p ){
+		value = value * 10 + ( *p - '0' );
+		if ( value > (long long) INT_MAX + 1 )
+			return E_FILE_FORMAT;
+	}
+	if ( negative )
+		value = -value;
+	if ( value > INT_MAX )
+		return E_FILE_FORMAT;
+	*o_value = (int) value;
+	*io_p = p;
+	return E_SUCCESS;
+}
+
+/* Convert the number at 'p' with the C library. The decimal separator is replaced by the
+*  one of the current locale, so the result does not depend on it. */
+static int hmmp_parse_double_libc ( const char **io_p, const char *end, double *o_value )
+{
+	char token[HMMP_NUMCONV_MAX_TOKEN + 1], *token_end, point;
+	const char *p = *io_p;
+	size_t len = 0;
+
+	point = localeconv()->decimal_point[0];
+	while ( p + len < end && !hmmp_is_space ( p[len] ) && len < HMMP_NUMCONV_MAX_TOKEN ){
+		token[len] = p[len] == '.' ? point : p[len];
+		++len;
+	}
+	token[len] = 0;
+	*o_value = strtod ( token, &token_end );
+	if ( token_end == token )
+		return E_FILE_FORMAT;
+	*io_p = p + ( token_end - token );
+	return E_SUCCESS;
+}
+
+int hmmp_parse_double ( const char **io_p, const char *end, double *o_value )
+{
+	const char *p, *start, *exp_start;
+	uint64_t mantissa = 0;
+	int digits = 0, exp10 = 0, exp_value, negative = 0, exp_negative, any_digit = 0;
+	char truncated = 0;
+	double value;
+#if LDBL_MANT_DIG == 64
+	long double extended, fraction;
+	uint64_t bits;
+	int exp2;
+#endif
+
+	p = *io_p;
+	while ( p < end && hmmp_is_space ( *p ) )
+		++p;
+	start = p;
+	if ( p < end && ( *p == '-' || *p == '+' ) )
+		negative = *p++ == '-';
+	// up to 19 significant digits fit in the 64 bit mantissa
+	for ( ; p < end && *p >= '0' && *p <= '9' ; ++p, any_digit = 1 ){
+		if ( digits < 19 ){
+			mantissa = mantissa * 10 + ( *p - '0' );
+			if ( mantissa )
+				++digits;
+		}
+		else {
+			++exp10;
+			truncated |= *p != '0';
+		}
+	}
+	if ( p < end && *p == '.' ){
+		for ( ++p ; p < end && *p >= '0' && *p <= '9' ; ++p, any_digit = 1 ){
+			if ( digits < 19 ){
+				mantissa = mantissa * 10 + ( *p - '0' );
+				if ( mantissa )
+					++digits;
+				--exp10;
+			}
+			else
+				truncated |= *p != '0';
+		}
+	}
+	if ( !any_digit ){
+		// inf, nan, hexadecimal and other forms
+		*io_p = start;
+		return hmmp_parse_double_libc ( io_p, end, o_value );
+	}
+	if ( p < end && ( *p == 'e' || *p == 'E' ) && p + 1 < end ){
+		exp_start = p++;
+		exp_negative = 0;
+		if ( *p == '-' || *p == '+' )
+			exp_negative = *p++ == '-';
+		if ( p < end && *p >= '0' && *p <= '9' ){
+			for ( exp_value = 0 ; p < end && *p >= '0' && *p <= '9' ; ++p )
+				if ( exp_value < 100000 )
+					exp_value = exp_value * 10 + ( *p - '0' );
+			exp10 += exp_negative ? -exp_value : exp_value;
+		}
+		else
+			p = exp_start;	// not an exponent, as in strtod()
+	}
+	if ( !mantissa ){
+		*o_value = negative ? -0.0 : 0.0;
+		*io_p = p;
+		return E_SUCCESS;
+	}
+	if ( !truncated ){
+		// exact operands and one rounding ( Clinger's fast path )
+		if ( mantissa <= ( (uint64_t) 1 << 53 ) && exp10 >= -22 && exp10 <= 22 ){
+			value = (double) mantissa;
+			value = exp10 < 0 ? value / hmmp_pow10[-exp10] : value * hmmp_pow10[exp10];
+			*o_value = negative ? -value : value;
+			*io_p = p;
+			return E_SUCCESS;
+		}
+#if LDBL_MANT_DIG == 64
+		// the same with the extended precision, one rounding to 64 bits and one to double;
+		// the second one is safe unless the result is next to a halfway point of double
+		if ( exp10 >= -27 && exp10 <= 27 ){
+			extended = exp10 < 0 ? (long double) mantissa / hmmp_pow10_ext[-exp10] :
+								   (long double) mantissa * hmmp_pow10_ext[exp10];
+			fraction = frexpl ( extended, &exp2 );
+			bits = (uint64_t) ldexpl ( fraction, 64 );
+			if ( extended >= DBL_MIN && extended <= DBL_MAX &&
+				 ( ( bits & 0x7FF ) < 0x3FF || ( bits & 0x7FF ) > 0x401 ) ){
+				value = (double) extended;
+				*o_value = negative ? -value : value;
+				*io_p = p;
+				return E_SUCCESS;
+			}
+		}
+#endif
+	}
+	*io_p = start;
+	return hmmp_parse_double_libc ( io_p, end, o_value );
+}
+
+/* Formatting: Grisu3 of F. Loitsch, "Printing Floating-Point Numbers Quickly and
+*  Accurately with Integers", with the shortest correctly rounded output of the C library
+*  for the values it rejects. */
+
+// 64 bit floating point number f * 2^e, normalized when the top bit of f is set
+typedef struct {
+	uint64_t f;
+	int e;
+} hmmp_Fp;
+
+// 10^k rounded to 64 bits, for k = -348, -340, ..., 340
+static const struct {
+	uint64_t f;
+	short e;
+	short k;
+} hmmp_cached_pow10[87] = {
+	{ UINT64_C(0xFA8FD5A0081C0288), -1220, -348 }, { UINT64_C(0xBAAEE17FA23EBF76), -1193, -340 },
+	{ UINT64_C(0x8B16FB203055AC76), -1166, -332 }, { UINT64_C(0xCF42894A5DCE35EA), -1140, -324 },
+	{ UINT64_C(0x9A6BB0AA55653B2D), -1113, -316 }, { UINT64_C(0xE61ACF033D1A45DF), -1087, -308 },
+	{ UINT64_C(0xAB70FE17C79AC6CA), -1060, -300 }, { UINT64_C(0xFF77B1FCBEBCDC4F), -1034, -292 },
+	{ UINT64_C(0xBE5691EF416BD60C), -1007, -284 }, { UINT64_C(0x8DD01FAD907FFC3C), -980, -276 },
+	{ UINT64_C(0xD3515C2831559A83), -954, -268 }, { UINT64_C(0x9D71AC8FADA6C9B5), -927, -260 },
+	{ UINT64_C(0xEA9C227723EE8BCB), -901, -252 }, { UINT64_C(0xAECC49914078536D), -874, -244 },
+	{ UINT64_C(0x823C12795DB6CE57), -847, -236 }, { UINT64_C(0xC21094364DFB5637), -821, -228 },
+	{ UINT64_C(0x9096EA6F3848984F), -794, -220 }, { UINT64_C(0xD77485CB25823AC7), -768, -212 },
+	{ UINT64_C(0xA086CFCD97BF97F4), -741, -204 }, { UINT64_C(0xEF340A98172AACE5), -715, -196 },
+	{ UINT64_C(0xB23867FB2A35B28E), -688, -188 }, { UINT64_C(0x84C8D4DFD2C63F3B), -661, -180 },
+	{ UINT64_C(0xC5DD44271AD3CDBA), -635, -172 }, { UINT64_C(0x936B9FCEBB25C996), -608, -164 },
+	{ UINT64_C(0xDBAC6C247D62A584), -582, -156 }, { UINT64_C(0xA3AB66580D5FDAF6), -555, -148 },
+	{ UINT64_C(0xF3E2F893DEC3F126), -529, -140 }, { UINT64_C(0xB5B5ADA8AAFF80B8), -502, -132 },
+	{ UINT64_C(0x87625F056C7C4A8B), -475, -124 }, { UINT64_C(0xC9BCFF6034C13053), -449, -116 },
+	{ UINT64_C(0x964E858C91BA2655), -422, -108 }, { UINT64_C(0xDFF9772470297EBD), -396, -100 },
+	{ UINT64_C(0xA6DFBD9FB8E5B88F), -369, -92 }, { UINT64_C(0xF8A95FCF88747D94), -343, -84 },
+	{ UINT64_C(0xB94470938FA89BCF), -316, -76 }, { UINT64_C(0x8A08F0F8BF0F156B), -289, -68 },
+	{ UINT64_C(0xCDB02555653131B6), -263, -60 }, { UINT64_C(0x993FE2C6D07B7FAC), -236, -52 },
+	{ UINT64_C(0xE45C10C42A2B3B06), -210, -44 }, { UINT64_C(0xAA242499697392D3), -183, -36 },
+	{ UINT64_C(0xFD87B5F28300CA0E), -157, -28 }, { UINT64_C(0xBCE5086492111AEB), -130, -20 },
+	{ UINT64_C(0x8CBCCC096F5088CC), -103, -12 }, { UINT64_C(0xD1B71758E219652C), -77, -4 },
+	{ UINT64_C(0x9C40000000000000), -50, 4 }, { UINT64_C(0xE8D4A51000000000), -24, 12 },
+	{ UINT64_C(0xAD78EBC5AC620000), 3, 20 }, { UINT64_C(0x813F3978F8940984), 30, 28 },
+	{ UINT64_C(0xC097CE7BC90715B3), 56, 36 }, { UINT64_C(0x8F7E32CE7BEA5C70), 83, 44 },
+	{ UINT64_C(0xD5D238A4ABE98068), 109, 52 }, { UINT64_C(0x9F4F2726179A2245), 136, 60 },
+	{ UINT64_C(0xED63A231D4C4FB27), 162, 68 }, { UINT64_C(0xB0DE65388CC8ADA8), 189, 76 },
+	{ UINT64_C(0x83C7088E1AAB65DB), 216, 84 }, { UINT64_C(0xC45D1DF942711D9A), 242, 92 },
+	{ UINT64_C(0x924D692CA61BE758), 269, 100 }, { UINT64_C(0xDA01EE641A708DEA), 295, 108 },
+	{ UINT64_C(0xA26DA3999AEF774A), 322, 116 }, { UINT64_C(0xF209787BB47D6B85), 348, 124 },
+	{ UINT64_C(0xB454E4A179DD1877), 375, 132 }, { UINT64_C(0x865B86925B9BC5C2), 402, 140 },
+	{ UINT64_C(0xC83553C5C8965D3D), 428, 148 }, { UINT64_C(0x952AB45CFA97A0B3), 455, 156 },
+	{ UINT64_C(0xDE469FBD99A05FE3), 481, 164 }, { UINT64_C(0xA59BC234DB398C25), 508, 172 },
+	{ UINT64_C(0xF6C69A72A3989F5C), 534, 180 }, { UINT64_C(0xB7DCBF5354E9BECE), 561, 188 },
+	{ UINT64_C(0x88FCF317F22241E2), 588, 196 }, { UINT64_C(0xCC20CE9BD35C78A5), 614, 204 },
+	{ UINT64_C(0x98165AF37B2153DF), 641, 212 }, { UINT64_C(0xE2A0B5DC971F303A), 667, 220 },
+	{ UINT64_C(0xA8D9D1535CE3B396), 694, 228 }, { UINT64_C(0xFB9B7CD9A4A7443C), 720, 236 },
+	{ UINT64_C(0xBB764C4CA7A44410), 747, 244 }, { UINT64_C(0x8BAB8EEFB6409C1A), 774, 252 },
+	{ UINT64_C(0xD01FEF10A657842C), 800, 260 }, { UINT64_C(0x9B10A4E5E9913129), 827, 268 },
+	{ UINT64_C(0xE7109BFBA19C0C9D), 853, 276 }, { UINT64_C(0xAC2820D9623BF429), 880, 284 },
+	{ UINT64_C(0x80444B5E7AA7CF85), 907, 292 }, { UINT64_C(0xBF21E44003ACDD2D), 933, 300 },
+	{ UINT64_C(0x8E679C2F5E44FF8F), 960, 308 }, { UINT64_C(0xD433179D9C8CB841), 986, 316 },
+	{ UINT64_C(0x9E19DB92B4E31BA9), 1013, 324 }, { UINT64_C(0xEB96BF6EBADF77D9), 1039, 332 },
+	{ UINT64_C(0xAF87023B9BF0EE6B), 1066, 340 }
+};
+
+// the exponent of the scaled values, so the digits before the binary point fit in 32 bits
+#define HMMP_FP_MIN_EXP ( -60 )
+#define HMMP_FP_MAX_EXP ( -32 )
+
+// rounded upper 64 bits of the product
+static hmmp_Fp hmmp_fp_multiply ( hmmp_Fp x, hmmp_Fp y )
+{
+	uint64_t a = x.f >> 32, b = x.f & 0xFFFFFFFF, c = y.f >> 32, d = y.f & 0xFFFFFFFF;
+	uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	uint64_t mid = ( bd >> 32 ) + ( ad & 0xFFFFFFFF ) + ( bc & 0xFFFFFFFF ) + ( (uint64_t) 1 << 31 );
+	hmmp_Fp r;
+	r.f = ac + ( ad >> 32 ) + ( bc >> 32 ) + ( mid >> 32 );
+	r.e = x.e + y.e + 64;
+	return r;
+}
+
+static hmmp_Fp hmmp_fp_normalize ( hmmp_Fp x )
+{
+	while ( !( x.f & UINT64_C(0xFFC0000000000000) ) ){
+		x.f <<= 10;
+		x.e -= 10;
+	}
+	while ( !( x.f & UINT64_C(0x8000000000000000) ) ){
+		x.f <<= 1;
+		--x.e;
+	}
+	return x;
+}
+
+/* Move the last digit towards the value while the result stays inside the interval, and
+*  check that it is the closest one and safely inside despite the error of the scaling. */
+static int hmmp_grisu_round_weed ( char *digits, int length, uint64_t distance_high_w,
+								   uint64_t unsafe_interval, uint64_t rest, uint64_t ten_kappa,
+								   uint64_t unit )
+{
+	uint64_t small_distance = distance_high_w - unit;
+	uint64_t big_distance = distance_high_w + unit;
+
+	while ( rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+			( rest + ten_kappa < small_distance ||
+			  small_distance - rest >= rest + ten_kappa - small_distance ) ){
+		--digits[length-1];
+		rest += ten_kappa;
+	}
+	if ( rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+		 ( rest + ten_kappa < big_distance ||
+		   big_distance - rest > rest + ten_kappa - big_distance ) )
+		return 0;
+	return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+/* Digits of the scaled value w, inside the scaled interval ( low, high ). Returns 0 when
+*  the shortest digits can not be guaranteed. */
+static int hmmp_grisu_digits ( hmmp_Fp low, hmmp_Fp w, hmmp_Fp high, char *digits,
+							   int *o_length, int *o_kappa )
+{
+	uint64_t unit = 1;
+	uint64_t too_low = low.f - unit, too_high = high.f + unit;
+	uint64_t unsafe_interval = too_high - too_low;
+	int shift = -w.e;
+	uint64_t one = (uint64_t) 1 << shift;
+	uint32_t integrals = (uint32_t) ( too_high >> shift );
+	uint64_t fractionals = too_high & ( one - 1 ), rest;
+	uint32_t divisor = 1;
+	int kappa = 1, length = 0, digit;
+
+	while ( (uint64_t) divisor * 10 <= integrals ){
+		divisor *= 10;
+		++kappa;
+	}
+	while ( kappa > 0 ){
+		digits[length++] = '0' + integrals / divisor;
+		integrals %= divisor;
+		--kappa;
+		rest = ( (uint64_t) integrals << shift ) + fractionals;
+		if ( rest < unsafe_interval ){
+			*o_length = length;
+			*o_kappa = kappa;
+			return hmmp_grisu_round_weed ( digits, length, too_high - w.f, unsafe_interval,
+										   rest, (uint64_t) divisor << shift, unit );
+		}
+		divisor /= 10;
+	}
+	for ( ;; ){
+		fractionals *= 10;
+		unit *= 10;
+		unsafe_interval *= 10;
+		digit = (int) ( fractionals >> shift );
+		digits[length++] = '0' + digit;
+		fractionals &= one - 1;
+		--kappa;
+		if ( fractionals < unsafe_interval ){
+			*o_length = length;
+			*o_kappa = kappa;
+			return hmmp_grisu_round_weed ( digits, length, ( too_high - w.f ) * unit,
+										   unsafe_interval, fractionals, one, unit );
+		}
+	}
+}
+
+/* Shortest digits of a positive finite double with Grisu3. Returns 0 for the values it
+*  can not decide. */
+static int hmmp_grisu3 ( double value, char *digits, int *o_length, int *o_exp10 )
+{
+	uint64_t bits, mantissa;
+	int exp2, i, lowest, kappa;
+	hmmp_Fp w, low, high, c;
+
+	memcpy ( &bits, &value, sizeof ( bits ) );
+	mantissa = bits & ( ( (uint64_t) 1 << 52 ) - 1 );
+	exp2 = (int) ( bits >> 52 ) & 0x7FF;
+	if ( exp2 ){
+		mantissa |= (uint64_t) 1 << 52;
+		exp2 -= 1075;
+	}
+	else
+		exp2 = -1074;
+	// the interval of the numbers rounding to the value, narrower below powers of two
+	high.f = ( mantissa << 1 ) + 1;
+	high.e = exp2 - 1;
+	high = hmmp_fp_normalize ( high );
+	if ( mantissa == (uint64_t) 1 << 52 && exp2 > -1074 ){
+		low.f = ( mantissa << 2 ) - 1;
+		low.e = exp2 - 2;
+	}
+	else{
+		low.f = ( mantissa << 1 ) - 1;
+		low.e = exp2 - 1;
+	}
+	low.f <<= low.e - high.e;
+	low.e = high.e;
+	w.f = mantissa;
+	w.e = exp2;
+	w = hmmp_fp_normalize ( w );
+
+	// cached power bringing the scaled exponent into [HMMP_FP_MIN_EXP, HMMP_FP_MAX_EXP]
+	lowest = HMMP_FP_MIN_EXP - ( w.e + 64 );
+	i = (int) ceil ( ( ( lowest + 63 ) * 0.30102999566398114 + 348 ) / 8 );
+	if ( i < 0 )
+		i = 0;
+	if ( i > 86 )
+		i = 86;
+	while ( i > 0 && hmmp_cached_pow10[i-1].e >= lowest )
+		--i;
+	while ( i < 86 && hmmp_cached_pow10[i].e < lowest )
+		++i;
+	c.f = hmmp_cached_pow10[i].f;
+	c.e = hmmp_cached_pow10[i].e;
+
+	if ( !hmmp_grisu_digits ( hmmp_fp_multiply ( low, c ), hmmp_fp_multiply ( w, c ),
+							  hmmp_fp_multiply ( high, c ), digits, o_length, &kappa ) )
+		return 0;
+	*o_exp10 = kappa - hmmp_cached_pow10[i].k;
+	return 1;
+}
+
+/* Shortest digits of a positive finite double with the C library: the correctly rounded
+*  15 digits are the shortest ones if anything up to 15 digits reads back, and so on for
+*  16 and 17. */
+static int hmmp_shortest_digits_libc ( double value, char *digits, int *o_exp10 )
+{
+	char text[64], token[40];
+	const char *p, *q;
+	double check;
+	int precision, length, exp10;
+
+	for ( precision = 15 ; ; ++precision ){
+		snprintf ( text, sizeof ( text ), "%.*e", precision - 1, value );
+		// the digits and the exponent, whatever the decimal separator of the locale
+		length = 0;
+		for ( p = text ; *p && *p != 'e' ; ++p )
+			if ( *p >= '0' && *p <= '9' )
+				digits[length++] = *p;
+		exp10 = (int) strtol ( p + 1, 0, 10 ) - ( length - 1 );
+		while ( length > 1 && digits[length-1] == '0' ){
+			--length;
+			++exp10;
+		}
+		if ( precision == 17 )
+			break;
+		memcpy ( token, digits, length );
+		snprintf ( token + length, sizeof ( token ) - length, "E%d", exp10 );
+		q = token;
+		if ( !hmmp_parse_double ( &q, token + strlen ( token ), &check ) && check == value )
+			break;
+	}
+	*o_exp10 = exp10;
+	return length;
+}
+
+int hmmp_format_double ( char *buffer, double value )
+{
+	char digits[20];
+	char *p = buffer;
+	int length, exp10, point, i;
+
+	if ( signbit ( value ) ){
+		*p++ = '-';
+		value = -value;
+	}
+	if ( isnan ( value ) || isinf ( value ) ){
+		memcpy ( p, isnan ( value ) ? "NAN" : "INF", 4 );
+		return (int) ( p - buffer ) + 3;
+	}
+	if ( value == 0 ){
+		memcpy ( p, "0", 2 );
+		return (int) ( p - buffer ) + 1;
+	}
+	if ( !hmmp_grisu3 ( value, digits, &length, &exp10 ) )
+		length = hmmp_shortest_digits_libc ( value, digits, &exp10 );
+
+	// the value is 0.digits * 10^point
+	point = length + exp10;
+	if ( length <= point && point <= 21 ){
+		memcpy ( p, digits, length );
+		p += length;
+		for ( i = length ; i < point ; ++i )
+			*p++ = '0';
+	}
+	else if ( 0 < point && point <= 21 ){
+		memcpy ( p, digits, point );
+		p += point;
+		*p++ = '.';
+		memcpy ( p, digits + point, length - point );
+		p += length - point;
+	}
+	else if ( -4 < point && point <= 0 ){
+		*p++ = '0';
+		*p++ = '.';
+		for ( i = point ; i < 0 ; ++i )
+			*p++ = '0';
+		memcpy ( p, digits, length );
+		p += length;
+	}
+	else{
+		*p++ = digits[0];
+		if ( length > 1 ){
+			*p++ = '.';
+			memcpy ( p, digits + 1, length - 1 );
+			p += length - 1;
+		}
+		exp10 = point - 1;
+		*p++ = 'E';
+		*p++ = exp10 < 0 ? '-' : '+';
+		if ( exp10 < 0 )
+			exp10 = -exp10;
+		if ( exp10 >= 100 )
+			*p++ = '0' + exp10 / 100;
+		*p++ = '0' + exp10 / 10 % 10;
+		*p++ = '0' + exp10 % 10;
+	}
+	*p = 0;
+	return (int) ( p - buffer );
+}
@@ -0,0 +1,74 @@
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#ifndef HMMP_NUMCONV_H
+#define HMMP_NUMCONV_H
+/** @file
+*	This file contains the conversions between numbers and text used by the file I/O
+*	functions of hmmp_file.h.
+*
+*	The conversions do not depend on the locale: the decimal separator is always '.'.
+*	The parsed values are identical to the ones of the C library in the "C" locale. Numbers
+*	which can be converted exactly with hardware floating point are handled directly,
+*	the rare others are passed to the C library. Doubles are written with the fewest
+*	digits that read back to the same value.
+*/
+#include "hmmp_datatypes.h"
+
+/// Size of a buffer large enough for any number written by hmmp_format_double()
+#define HMMP_DOUBLE_CHARS 32
+
+/// Parse a decimal integer.
+/**
+*	Leading whitespace is skipped, as by the "%d" conversion of scanf().
+*
+*	@param[in,out] io_p	Address of the pointer to the text, moved after the number on success
+*	@param[in] end		End of the text
+*	@param[out] o_value	Address of a variable to receive the number
+*	@return @ref hmmp_Error Error code. E_FILE_FORMAT if there is no number or it overflows.
+*/
+int hmmp_parse_int ( const char **io_p, const char *end, int *o_value );
+
+/// Parse a decimal floating point number.
+/**
+*	Leading whitespace is skipped, as by the "%lf" conversion of scanf(). The result is
+*	the correctly rounded value of the text, bit-exactly the one of strtod().
+*
+*	@param[in,out] io_p	Address of the pointer to the text, moved after the number on success
+*	@param[in] end		End of the text
+*	@param[out] o_value	Address of a variable to receive the number
+*	@return @ref hmmp_Error Error code. E_FILE_FORMAT if there is no number.
+*/
+int hmmp_parse_double ( const char **io_p, const char *end, double *o_value );
+
+/// Write the shortest decimal text of a double that reads back to the same value.
+/**
+*	Among the shortest texts the closest to the value is chosen. Values with a decimal
+*	exponent from -4 to 20 are written in regular notation, like "0.25" or "1500", the
+*	others in scientific notation, like "1.5E-07". Infinities and NaNs are written as
+*	"INF" and "NAN". hmmp_parse_double() and strtod() read the text back bit-exactly.
+*
+*	@param[out] buffer	Address of at least @ref HMMP_DOUBLE_CHARS characters to receive
+*						the zero terminated text
+*	@param[in] value	The number
+*	@return Number of characters written, without the terminating zero.
+*/
+int hmmp_format_double ( char *buffer, double value );
+
+#endif
@@ -0,0 +1,161 @@
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#include "hmmp_plan.h"
+#include "hmmp_datatypes.h"
+#include <stdint.h>
+#include <math.h>
+
+static size_t hmmp_memory_budget = 0;
+
+int hmmp_set_memory_budget ( size_t budget )
+{
+	hmmp_memory_budget = budget;
+	return E_SUCCESS;
+}
+
+size_t hmmp_get_memory_budget ( void )
+{
+	return hmmp_memory_budget;
+}
+
+/* Checkpoint interval with the smallest memory. The training keeps the forward and the
+*  backward variables at T/K checkpoints and 2K segment rows, the decoding shares one
+*  workspace buffer between 2T/K checkpoints and K backtracking rows. */
+static int hmmp_plan_interval ( int task, int max_length )
+{
+	int interval;
+	if ( task == HMMP_TASK_DECODE )
+		interval = (int) ceil ( sqrt ( 2.0 * max_length ) );
+	else
+		interval = (int) ceil ( sqrt ( (double) max_length ) );
+	if ( interval > max_length )
+		interval = max_length;
+	return interval < 1 ? 1 : interval;
+}
+
+size_t hmmp_plan_peak_bytes ( int task, int variant, int interval, int num_states,
+							  int num_symbols, int max_length, int num_seq,
+							  size_t total_length, int num_threads )
+{
+	// computed in floating point, so huge inputs saturate instead of wrapping around
+	double N = num_states, M = num_symbols, T = max_length, K = interval;
+	double S = 0.0, L, shared = 0.0, per_thread = 0.0, peak;
+
+	(void) total_length;	// no working memory grows with it since training runs without indexes
+	if ( num_states < 1 || num_symbols < 1 || num_seq < 0 || num_threads < 1 )
+		return SIZE_MAX;
+	if ( T < 1.0 )
+		T = 1.0;
+	if ( variant == HMMP_VARIANT_CHECKPOINT ){
+		if ( interval < 1 )
+			return SIZE_MAX;
+		S = floor ( ( T - 1.0 ) / K ) + 1.0;
+	}
+	switch ( task ){
+	case HMMP_TASK_EVALUATE:
+		if ( variant == HMMP_VARIANT_FULL )
+			per_thread = N*T*sizeof ( dbl_matrix ) + T*sizeof ( dbl_array );
+		else if ( variant == HMMP_VARIANT_LIKELIHOOD )
+			per_thread = 2.0*N*sizeof ( dbl_matrix );
+		else
+			return SIZE_MAX;
+		break;
+	case HMMP_TASK_DECODE:
+		// logarithmic copy of the model
+		shared = N*( N + M + 1.0 )*sizeof ( dbl_matrix ) + sizeof ( hmmp_Model );
+		if ( variant == HMMP_VARIANT_FULL )
+			per_thread = N*T*sizeof ( int_matrix ) + 2.0*N*sizeof ( dbl_matrix );
+		else if ( variant == HMMP_VARIANT_CHECKPOINT ){
+			// workspace buffers of length max( 2S, K ), see hmmp_decode()
+			L = 2.0*S > K ? 2.0*S : K;
+			per_thread = N*L*( sizeof ( dbl_matrix ) + sizeof ( int_matrix ) ) +
+						 L*sizeof ( dbl_array ) + 2.0*N*sizeof ( dbl_matrix );
+		}
+		else
+			return SIZE_MAX;
+		break;
+	case HMMP_TASK_TRAIN:
+		// transposed emission, expected counts and the deduplicated sequence array
+		shared = N*M*sizeof ( dbl_matrix ) + N*( N + M + 3.0 )*sizeof ( dbl_matrix ) +
+				 num_seq*( sizeof ( hmmp_Sequence ) + sizeof ( dbl_array ) );
+		if ( variant == HMMP_VARIANT_FULL )
+			shared += 2.0*N*T*sizeof ( dbl_matrix ) + 2.0*T*sizeof ( dbl_array );
+		else if ( variant == HMMP_VARIANT_CHECKPOINT )
+			shared += 2.0*S*N*sizeof ( dbl_matrix ) + ( 2.0*K + 1.0 )*N*sizeof ( dbl_matrix ) +
+					  2.0*T*sizeof ( dbl_array );
+		else
+			return SIZE_MAX;
+		break;
+	default:
+		return SIZE_MAX;
+	}
+	peak = shared + per_thread*num_threads;
+	if ( peak >= (double) SIZE_MAX )
+		return SIZE_MAX;
+	return (size_t) peak;
+}
+
+int hmmp_plan_memory ( size_t budget, int task, int num_states, int num_symbols,
+					   int max_length, int num_seq, size_t total_length, int num_threads,
+					   hmmp_Plan *o_plan )
+{
+	// variants from the fastest to the most frugal
+	static const int evaluate_variants[] = { HMMP_VARIANT_LIKELIHOOD };
+	static const int storage_variants[] = { HMMP_VARIANT_FULL, HMMP_VARIANT_CHECKPOINT };
+	const int *variants;
+	int num_variants, v, threads;
+	hmmp_Plan plan;
+
+	if ( !o_plan )
+		return E_PARAMETER;
+	if ( task == HMMP_TASK_EVALUATE ){
+		variants = evaluate_variants;
+		num_variants = 1;
+	}
+	else if ( task == HMMP_TASK_DECODE || task == HMMP_TASK_TRAIN ){
+		variants = storage_variants;
+		num_variants = 2;
+	}
+	else
+		return E_ARGUMENT;
+	if ( num_threads < 1 )
+		num_threads = 1;
+	plan.task = task;
+	// the training runs every sequence on all threads, its memory does not depend on them
+	for ( threads = num_threads ; threads >= 1 ; threads = task == HMMP_TASK_TRAIN ? 0 : threads - 1 ){
+		for ( v = 0 ; v < num_variants ; ++v ){
+			plan.variant = variants[v];
+			plan.interval = plan.variant == HMMP_VARIANT_CHECKPOINT ?
+							hmmp_plan_interval ( task, max_length ) : 0;
+			plan.num_threads = threads;
+			plan.batch_size = task == HMMP_TASK_TRAIN || num_seq < 1 ?
+							  1 : ( num_seq + threads - 1 ) / threads;
+			plan.peak_bytes = hmmp_plan_peak_bytes ( task, plan.variant, plan.interval,
+													 num_states, num_symbols, max_length,
+													 num_seq, total_length, threads );
+			if ( plan.peak_bytes != SIZE_MAX && ( !budget || plan.peak_bytes <= budget ) ){
+				*o_plan = plan;
+				return E_SUCCESS;
+			}
+		}
+	}
+	*o_plan = plan;
+	return E_MEM_BUDGET;
+}
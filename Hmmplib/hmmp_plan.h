@@ -0,0 +1,118 @@
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#ifndef HMMP_PLAN_H
+#define HMMP_PLAN_H
+/** @file
+*	This file contains the planner choosing how the entry points use the memory.
+*
+*	Each entry point has several variants with the same results and different memory
+*	needs:
+*		- Full storage keeps the N x T variables of a sequence ( forward variables of the
+*		  evaluation, Viterbi backtracking of the decoding, forward and backward variables
+*		  of the Baum-Welch training ). Fastest.
+*		- Checkpointed storage keeps the variables only every 'interval' time steps and
+*		  recomputes one segment at a time, which costs one more pass over the sequence.
+*		  Used by hmmp_decode() and the Baum-Welch training.
+*		- Likelihood-only keeps two rows of the forward variables. Used by
+*		  hmmp_evaluate_models() and hmmp_evaluate_sequences(), which need nothing else.
+*
+*	The entry points call hmmp_plan_memory() with the budget set by
+*	hmmp_set_memory_budget() and run the plan it returns. The budget is unlimited by
+*	default, then the evaluation runs likelihood-only and everything else with full
+*	storage. When the full storage does not fit, the checkpointed variant is used, then
+*	the number of threads is reduced. If nothing fits the entry point returns
+*	E_MEM_BUDGET instead of running out of memory.
+*
+*	The predicted peak covers the working memory of the algorithm: the per-thread
+*	buffers, copies of the model and counts. The input sequences and models and
+*	the returned results are not included.
+*/
+#include "hmmp_datatypes.h"
+#include <stddef.h>
+
+/// Plan for hmmp_evaluate_models() and hmmp_evaluate_sequences().
+#define HMMP_TASK_EVALUATE		0
+/// Plan for hmmp_decode().
+#define HMMP_TASK_DECODE		1
+/// Plan for the Baum-Welch training functions.
+#define HMMP_TASK_TRAIN			2
+
+/// All the variables of a sequence are kept.
+#define HMMP_VARIANT_FULL		0
+/// The variables are kept at checkpoints and recomputed one segment at a time.
+#define HMMP_VARIANT_CHECKPOINT	1
+/// Only the last time step of the forward variables is kept.
+#define HMMP_VARIANT_LIKELIHOOD	2
+
+/// Set the memory budget of the entry points.
+/**
+*	@param[in] budget	Bytes of working memory the entry points may use, 0 for no limit.
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_set_memory_budget ( size_t budget );
+
+/// The memory budget of the entry points.
+/**
+*	@return Bytes of working memory the entry points may use, 0 for no limit.
+*/
+size_t hmmp_get_memory_budget ( void );
+
+/// Predicted peak of the working memory of one variant.
+/**
+*	@param[in] task			HMMP_TASK_EVALUATE, HMMP_TASK_DECODE or HMMP_TASK_TRAIN
+*	@param[in] variant		HMMP_VARIANT_FULL, HMMP_VARIANT_CHECKPOINT or HMMP_VARIANT_LIKELIHOOD
+*	@param[in] interval		Time steps between checkpoints, used by HMMP_VARIANT_CHECKPOINT
+*	@param[in] num_states	Number of states ( N ), the largest one for many models
+*	@param[in] num_symbols	Number of symbols ( M )
+*	@param[in] max_length	Length of the longest sequence ( T )
+*	@param[in] num_seq		Number of sequences ( or models for hmmp_evaluate_models() )
+*	@param[in] total_length	Sum of the lengths of all sequences, currently not used
+*	@param[in] num_threads	Number of threads
+*	@return Number of bytes. SIZE_MAX if the variant is not available for the task or
+*			the size overflows.
+*/
+size_t hmmp_plan_peak_bytes ( int task, int variant, int interval, int num_states,
+							  int num_symbols, int max_length, int num_seq,
+							  size_t total_length, int num_threads );
+
+/// Choose the variant and the number of threads of an entry point for a memory budget.
+/**
+*	The variants are tried from the fastest to the most frugal, the first one fitting in
+*	the budget is returned. The checkpoint interval minimizes the memory of the
+*	checkpointed variant, about sqrt( T ) for the training and sqrt( 2T ) for decoding.
+*	The number of threads is reduced only if no variant fits with 'num_threads'.
+*
+*	@param[in] budget		Bytes of working memory available, 0 for no limit
+*	@param[in] task			HMMP_TASK_EVALUATE, HMMP_TASK_DECODE or HMMP_TASK_TRAIN
+*	@param[in] num_states	Number of states ( N ), the largest one for many models
+*	@param[in] num_symbols	Number of symbols ( M )
+*	@param[in] max_length	Length of the longest sequence ( T )
+*	@param[in] num_seq		Number of sequences ( or models for hmmp_evaluate_models() )
+*	@param[in] total_length	Sum of the lengths of all sequences
+*	@param[in] num_threads	Number of threads available
+*	@param[out] o_plan		The chosen plan. When nothing fits, the most frugal plan with
+*							its peak, so the caller can report the memory needed.
+*	@return @ref hmmp_Error Error code. E_MEM_BUDGET if no plan fits in the budget.
+*/
+int hmmp_plan_memory ( size_t budget, int task, int num_states, int num_symbols,
+					   int max_length, int num_seq, size_t total_length, int num_threads,
+					   hmmp_Plan *o_plan );
+
+#endif
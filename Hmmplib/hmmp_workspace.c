@@ -0,0 +1,187 @@
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#include "hmmp_workspace.h"
+#include "hmmp_datatypes.h"
+#include "hmmp_memop.h"
+#include "hmmp_numa.h"
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+// all the workspaces, a call claims a free one and returns it with hmmp_workspace_release()
+static hmmp_Workspace *hmmp_ws_pool = 0;
+
+static void hmmp_workspace_free_buffers ( hmmp_Workspace *ws )
+{
+	if ( ws->alfa ) hmmp_delete_large_buffer ( ws->alfa );
+	if ( ws->scales ) hmmp_delete_dbl_array ( ws->scales );
+	if ( ws->backtrack ) hmmp_delete_large_buffer ( ws->backtrack );
+	if ( ws->mu ) hmmp_delete_dbl_matrix ( ws->mu );
+	ws->alfa = ws->mu = 0;
+	ws->scales = 0;
+	ws->backtrack = 0;
+}
+
+/* Allocate the missing buffers of the selected kinds with the size of the workspace.
+*  Buffers allocated before a failure are kept, they have the right size. */
+static int hmmp_workspace_alloc ( hmmp_Workspace *ws, int buffers )
+{
+	size_t size = (size_t) ws->max_states * ws->max_length;
+	if ( ( buffers & HMMP_WS_FORWARD ) && !ws->alfa ){
+		ws->alfa = (dbl_matrix*) hmmp_create_large_buffer ( size * sizeof ( dbl_matrix ) );
+		ws->scales = hmmp_create_dbl_array ( ws->max_length );
+		if ( !ws->alfa || !ws->scales ){
+			if ( ws->alfa ) hmmp_delete_large_buffer ( ws->alfa );
+			if ( ws->scales ) hmmp_delete_dbl_array ( ws->scales );
+			ws->alfa = 0;
+			ws->scales = 0;
+			return E_ALLOCATION;
+		}
+		// first touch by the owning thread places the pages on its NUMA node
+		memset ( ws->alfa, 0, size * sizeof ( dbl_matrix ) );
+		memset ( ws->scales, 0, ws->max_length * sizeof ( dbl_array ) );
+	}
+	if ( ( buffers & HMMP_WS_VITERBI ) && !ws->backtrack ){
+		ws->backtrack = (int_matrix*) hmmp_create_large_buffer ( size * sizeof ( int_matrix ) );
+		if ( !ws->backtrack )
+			return E_ALLOCATION;
+		memset ( ws->backtrack, 0, size * sizeof ( int_matrix ) );
+	}
+	if ( ( buffers & ( HMMP_WS_VITERBI | HMMP_WS_LIKELIHOOD ) ) && !ws->mu ){
+		ws->mu = hmmp_create_dbl_matrix ( 2 * (size_t) ws->max_states );
+		if ( !ws->mu )
+			return E_ALLOCATION;
+		memset ( ws->mu, 0, 2 * (size_t) ws->max_states * sizeof ( dbl_matrix ) );
+	}
+	return E_SUCCESS;
+}
+
+int hmmp_workspace_release ( hmmp_Workspace *ws )
+{
+	if ( !ws )
+		return E_PARAMETER;
+	#pragma omp critical ( hmmp_workspace_pool )
+	ws->in_use = 0;
+	return E_SUCCESS;
+}
+
+hmmp_Workspace *hmmp_workspace_acquire ( int num_states, int length, int buffers )
+{
+	hmmp_Workspace *ws = 0, *p, grown;
+	int node = hmmp_numa_node ( ), score, best = -1;
+
+	if ( num_states < 1 )
+		num_states = 1;
+	if ( length < 1 )
+		length = 1;
+	// any free workspace will do, so the number of workspaces stays at the largest number
+	// of concurrent callers; one on the node of the thread and large enough is preferred
+	#pragma omp critical ( hmmp_workspace_pool )
+	{
+		for ( p = hmmp_ws_pool ; p && best < 3 ; p = p->next ){
+			if ( p->in_use )
+				continue;
+			score = 2 * ( p->node == node ) +
+					( p->max_states >= num_states && p->max_length >= length );
+			if ( score > best ){
+				best = score;
+				ws = p;
+			}
+		}
+		if ( ws )
+			ws->in_use = 1;
+	}
+	if ( !ws ){
+		ws = (hmmp_Workspace*) calloc ( 1, sizeof ( hmmp_Workspace ) );
+		if ( !ws )
+			return 0;
+		ws->node = node;
+		ws->in_use = 1;
+		#pragma omp critical ( hmmp_workspace_pool )
+		{
+			ws->next = hmmp_ws_pool;
+			hmmp_ws_pool = ws;
+		}
+	}
+	// grow to the running maximum of both dimensions, so alternating shapes do not
+	// reallocate on every call
+	if ( num_states > ws->max_states || length > ws->max_length ){
+		if ( num_states < ws->max_states )
+			num_states = ws->max_states;
+		if ( length < ws->max_length )
+			length = ws->max_length;
+		if ( hmmp_memop_overflow ( num_states, length ) == E_MEM_OVERFLOW_L1 ){
+			hmmp_workspace_release ( ws );
+			return 0;
+		}
+		// the new buffers are allocated first, the old ones are kept if that fails
+		memset ( &grown, 0, sizeof ( grown ) );
+		grown.max_states = num_states;
+		grown.max_length = length;
+		grown.node = node;
+		if ( hmmp_workspace_alloc ( &grown, buffers ) ){
+			hmmp_workspace_free_buffers ( &grown );
+			hmmp_workspace_release ( ws );
+			return 0;
+		}
+		hmmp_workspace_free_buffers ( ws );
+		grown.next = ws->next;
+		grown.in_use = 1;
+		*ws = grown;
+		return ws;
+	}
+	if ( hmmp_workspace_alloc ( ws, buffers ) ){
+		hmmp_workspace_release ( ws );
+		return 0;
+	}
+	return ws;
+}
+
+int hmmp_workspace_trim ( void )
+{
+	hmmp_Workspace *ws;
+	#pragma omp critical ( hmmp_workspace_pool )
+	{
+		for ( ws = hmmp_ws_pool ; ws ; ws = ws->next ){
+			hmmp_workspace_free_buffers ( ws );
+			ws->max_states = ws->max_length = 0;
+		}
+	}
+	return E_SUCCESS;
+}
+
+size_t hmmp_workspace_size ( void )
+{
+	hmmp_Workspace *ws;
+	size_t size = 0, n_times_t;
+	#pragma omp critical ( hmmp_workspace_pool )
+	{
+		for ( ws = hmmp_ws_pool ; ws ; ws = ws->next ){
+			n_times_t = (size_t) ws->max_states * ws->max_length;
+			if ( ws->alfa )
+				size += n_times_t * sizeof ( dbl_matrix ) + (size_t) ws->max_length * sizeof ( dbl_array );
+			if ( ws->backtrack )
+				size += n_times_t * sizeof ( int_matrix );
+			if ( ws->mu )
+				size += 2 * (size_t) ws->max_states * sizeof ( dbl_matrix );
+		}
+	}
+	return size;
+}
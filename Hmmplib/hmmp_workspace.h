@@ -0,0 +1,90 @@
+/*  This file is part of Hmmplib.
+*	Description: Hmmplib is a powerful multy-core library solution of Hidden Markov model in C.
+*   Copyright (C) 2017  Iskren Tarkalanov
+*
+*   Hmmplib is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   any later version.
+*
+*   Hmmplib is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Hmmplib.  If not, see <http://www.gnu.org/licenses/>.
+*
+*	Contact: isktark@yahoo.com Iskren Tarkalanov
+*/
+#ifndef HMMP_WORKSPACE_H
+#define HMMP_WORKSPACE_H
+/** @file
+*	This file contains the pool of per-thread workspaces used by the inference entry
+*	points hmmp_decode(), hmmp_evaluate_models() and hmmp_evaluate_sequences().
+*
+*	Each OpenMP thread of these functions claims a free workspace from the pool at the
+*	start of the call and returns it at the end. The buffers grow to the running maximum
+*	of the number of states and the sequence length requested so far and are never shrunk
+*	automatically, so repeated calls with small batches do not allocate at all. The number
+*	of workspaces stays at the largest number of threads which used the pool at the same
+*	time, also when nested parallel regions create new threads for every region. Claiming
+*	and returning a workspace take a short lock once per thread and call.
+*
+*	The memory can be released with hmmp_workspace_trim(), for example after a large
+*	batch or before the program exits.
+*
+*	The buffers are allocated and first touched by the thread which grows them, so on NUMA
+*	machines they are placed on the node of that thread, see hmmp_numa.h.
+*/
+#include "hmmp_datatypes.h"
+#include <stddef.h>
+
+/// Buffers needed by the forward algorithm: 'alfa' and 'scales'.
+#define HMMP_WS_FORWARD 1
+/// Buffers needed by the Viterbi algorithm: 'backtrack' and 'mu'.
+#define HMMP_WS_VITERBI 2
+/// Buffer needed by hmmp_forward_likelihood_alg(): 'mu' only.
+#define HMMP_WS_LIKELIHOOD 4
+
+/// Claim a free workspace of the pool with buffers of at least the requested size.
+/**
+*	A free workspace which already has the size is preferred. The buffers of the selected
+*	kinds are grown, if needed, to hold the running maximum of the number of states and the
+*	sequence length over all requests. The content of the buffers is not preserved when
+*	they grow. The workspace belongs to the caller until hmmp_workspace_release().
+*
+*	@param[in] num_states	Number of states ( N )
+*	@param[in] length		Sequence length ( T )
+*	@param[in] buffers		HMMP_WS_FORWARD, HMMP_WS_VITERBI, HMMP_WS_LIKELIHOOD or several
+*							combined with '|'
+*	@return Address of the claimed workspace. Zero 0 ( NULL ) on failure, nothing stays
+*			claimed and the workspaces keep their previous buffers in this case.
+*/
+hmmp_Workspace *hmmp_workspace_acquire ( int num_states, int length, int buffers );
+
+/// Return a workspace claimed with hmmp_workspace_acquire() to the pool.
+/**
+*	The buffers are kept for the next caller.
+*
+*	@param[in] ws	The claimed workspace
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_workspace_release ( hmmp_Workspace *ws );
+
+/// Release the buffers of all the workspaces in the pool.
+/**
+*	The workspaces stay registered and grow again on the next use.
+*	**Must not be called while any thread executes a function using the pool.**
+*
+*	@return @ref hmmp_Error Error code.
+*/
+int hmmp_workspace_trim ( void );
+
+/// Total size in bytes of the buffers held by the pool.
+/**
+*	@return Number of bytes allocated for the buffers of all workspaces.
+*/
+size_t hmmp_workspace_size ( void );
+
+#endif